@@ -0,0 +1,217 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef POSIX_DRIVERS_BYTE_BLOCK_POOL_H_
+#define POSIX_DRIVERS_BYTE_BLOCK_POOL_H_
+
+#include <cstdint>
+#include <cstddef>
+
+// ----------------------------------------------------------------------------
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    // A pool of fixed size blocks, shared by the PooledByteCircularBuffer
+    // objects of several devices, so the memory is reserved for the
+    // ports busy at a time, not for all of them.
+    //
+    // The free blocks are kept in a list, linked via the links array,
+    // which is also used to chain the blocks in the buffers; allocate()
+    // and release() are O(1).
+    //
+    // They are not protected; the buffers call them inside their
+    // critical sections, so all the devices sharing the pool must use
+    // critical sections that exclude all their ISRs, for example by
+    // disabling the interrupts; a critical section masking only the
+    // interrupt of its own device is not enough. Buffered_serial_device
+    // checks this at compile time, its critical section type must
+    // have a static constexpr bool isGlobal = true member.
+
+    class ByteBlockPool
+    {
+    public:
+
+      using index_t = uint16_t;
+
+      // Returned by allocate() when no more blocks, and used to
+      // terminate the chains.
+      static constexpr index_t none = static_cast<index_t> (-1);
+
+      // The storage must have count * blockSize bytes, the links
+      // count elements.
+      ByteBlockPool (uint8_t* storage, std::size_t blockSize,
+                     std::size_t count, index_t* links);
+
+      // Prevent copy, move, assign; the buffers point to the pool.
+      ByteBlockPool (const ByteBlockPool&) = delete;
+
+      ByteBlockPool&
+      operator= (const ByteBlockPool&) = delete;
+
+      // ----------------------------------------------------------------------
+
+      // Return a block, with the link cleared, or none.
+      index_t
+      allocate (void);
+
+      void
+      release (index_t block);
+
+      uint8_t*
+      block (index_t block) const;
+
+      index_t
+      next (index_t block) const;
+
+      void
+      link (index_t block, index_t next);
+
+      std::size_t
+      blockSize (void) const;
+
+      std::size_t
+      count (void) const;
+
+      std::size_t
+      getFreeCount (void) const;
+
+      // The minimum number of free blocks since construction or
+      // resetMinFreeCount(), to help right-size the pool.
+      std::size_t
+      getMinFreeCount (void) const;
+
+      void
+      resetMinFreeCount (void);
+
+      void
+      dump (void);
+
+      // ----------------------------------------------------------------------
+
+    private:
+
+      uint8_t* const fStorage;
+      std::size_t const fBlockSize;
+      std::size_t const fCount;
+      index_t* const fLinks;
+
+      // The first free block.
+      index_t volatile fFree;
+
+      std::size_t volatile fFreeCount;
+      std::size_t volatile fMinFreeCount;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // Pool with the storage owned inline.
+
+    template<std::size_t BlockSize_N, std::size_t Count_N>
+      class TByteBlockPool : public ByteBlockPool
+      {
+        static_assert(BlockSize_N > 0, "The block size cannot be 0.");
+        static_assert((Count_N > 0) && (Count_N < ByteBlockPool::none),
+            "Too many blocks.");
+
+      public:
+
+        TByteBlockPool ();
+
+      private:
+
+        uint8_t fData[BlockSize_N * Count_N];
+        index_t fLinkData[Count_N];
+      };
+
+    // ------------------------------------------------------------------------
+
+    inline uint8_t*
+    ByteBlockPool::block (index_t block) const
+    {
+      return fStorage + static_cast<std::size_t> (block) * fBlockSize;
+    }
+
+    inline ByteBlockPool::index_t
+    ByteBlockPool::next (index_t block) const
+    {
+      return fLinks[block];
+    }
+
+    inline void
+    ByteBlockPool::link (index_t block, index_t next)
+    {
+      fLinks[block] = next;
+    }
+
+    inline std::size_t
+    ByteBlockPool::blockSize (void) const
+    {
+      return fBlockSize;
+    }
+
+    inline std::size_t
+    ByteBlockPool::count (void) const
+    {
+      return fCount;
+    }
+
+    inline std::size_t
+    ByteBlockPool::getFreeCount (void) const
+    {
+      return fFreeCount;
+    }
+
+    inline std::size_t
+    ByteBlockPool::getMinFreeCount (void) const
+    {
+      return fMinFreeCount;
+    }
+
+    inline void
+    ByteBlockPool::resetMinFreeCount (void)
+    {
+      fMinFreeCount = fFreeCount;
+    }
+
+    // ------------------------------------------------------------------------
+
+    template<std::size_t BlockSize_N, std::size_t Count_N>
+      TByteBlockPool<BlockSize_N, Count_N>::TByteBlockPool () :
+          ByteBlockPool (fData, BlockSize_N, Count_N, fLinkData)
+      {
+        ;
+      }
+
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* POSIX_DRIVERS_BYTE_BLOCK_POOL_H_ */
@@ -30,6 +30,9 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
+
+#include "posix-drivers/byte-scan.h"
 
 // ----------------------------------------------------------------------------
 
@@ -37,12 +40,25 @@ namespace os
 {
   namespace dev
   {
+    class Checksum;
+
     // ------------------------------------------------------------------------
 
     class ByteCircularBuffer
     {
     public:
 
+      // Accesses from the ISR and from the thread must be protected
+      // by critical sections; for a lock-free version, use
+      // SpscByteCircularBuffer.
+      static constexpr bool isLockFree = false;
+
+      // The storage is a single ring, peekFront() returns all the bytes.
+      static constexpr bool isChained = false;
+
+      // Returned by find() when not found.
+      static constexpr std::size_t npos = static_cast<std::size_t> (-1);
+
       ByteCircularBuffer (const uint8_t* buf, std::size_t size,
                           std::size_t highWaterMark, std::size_t lowWaterMark =
                               0);
@@ -64,6 +80,10 @@ namespace os
       std::size_t
       pushBack (const uint8_t* buf, std::size_t count);
 
+      // Also update the checksum with the bytes copied.
+      std::size_t
+      pushBack (const uint8_t* buf, std::size_t count, Checksum& sum);
+
       std::size_t
       advanceBack (std::size_t count);
 
@@ -77,6 +97,10 @@ namespace os
       std::size_t
       popFront (uint8_t* buf, std::size_t size);
 
+      // Also update the checksum with the bytes copied.
+      std::size_t
+      popFront (uint8_t* buf, std::size_t size, Checksum& sum);
+
       std::size_t
       advanceFront (std::size_t count);
 
@@ -90,6 +114,46 @@ namespace os
       std::size_t
       getBackContiguousBuffer (uint8_t** ppbuf);
 
+      // Zero-copy access to the bytes in the front, as two contiguous
+      // segments; the second is not empty only if the data wraps.
+      // Return the total length; release the bytes with advanceFront().
+      std::size_t
+      peekFront (uint8_t** ppbuf1, std::size_t* plen1, uint8_t** ppbuf2,
+                 std::size_t* plen2);
+
+      // Zero-copy access to the free space in the back, as two contiguous
+      // segments; the second is not empty only if the space wraps.
+      // Return the total length; commit the bytes with advanceBack().
+      std::size_t
+      reserveBack (uint8_t** ppbuf1, std::size_t* plen1, uint8_t** ppbuf2,
+                   std::size_t* plen2);
+
+      // Return the offset, from the front, of the first occurrence of
+      // the byte at or after the given offset, or npos; the two
+      // segments are scanned a word at a time.
+      std::size_t
+      find (uint8_t c, std::size_t offset = 0) const;
+
+      // Return the number of occurrences of the byte.
+      std::size_t
+      count (uint8_t c) const;
+
+      // Copy up to count bytes of the stream that ended at the back,
+      // beginning at the given distance before the back (at most the
+      // size); the bytes already released from the front are still in
+      // the storage, until overwritten. Return the number of bytes
+      // copied. For a second reader, like a diagnostic tap.
+      std::size_t
+      copyBeforeBack (std::size_t distance, uint8_t* buf,
+                      std::size_t count) const;
+
+      // Same bytes, without copying, as two contiguous segments;
+      // they remain valid only until the back passes over them.
+      std::size_t
+      peekBeforeBack (std::size_t distance, std::size_t count,
+                      const uint8_t** ppbuf1, std::size_t* plen1,
+                      const uint8_t** ppbuf2, std::size_t* plen2) const;
+
       bool
       isEmpty (void) const;
 
@@ -114,12 +178,33 @@ namespace os
       std::size_t
       size (void) const;
 
+      // The maximum length reached since clear() or resetMaxLength(),
+      // to help right-size the buffer.
+      std::size_t
+      getMaxLength (void) const;
+
+      void
+      resetMaxLength (void);
+
       void
       dump (void);
 
       // ----------------------------------------------------------------------
 
-    private:
+    protected:
+
+      uint8_t*
+      data (void) const;
+
+      void
+      updateMaxLength (void);
+
+      // Same, with the new length already known, to avoid reading
+      // the volatile length back.
+      void
+      updateMaxLength (std::size_t len);
+
+      // ----------------------------------------------------------------------
 
       const uint8_t* const fBuf;
       std::size_t const fSize;
@@ -132,15 +217,138 @@ namespace os
       // Actual length: [0 - size].
       std::size_t volatile fLen;
 
-      // Next free position to push, at the back.
-      uint8_t* volatile fBack;
+      // Index of the next free position to push, at the back.
+      std::size_t volatile fBack;
+
+      // Index of the first used position to pop, at the front.
+      std::size_t volatile fFront;
 
-      // First used position to pop, at the front.
-      uint8_t* volatile fFront;
+      std::size_t volatile fMaxLen;
     };
 
     // ------------------------------------------------------------------------
 
+    // Circular buffer with the storage owned inline and a size known
+    // at compile time, which must be a power of 2; wrapping is done
+    // with a mask and the water marks are constants.
+    //
+    // Being derived from ByteCircularBuffer, it can be used anywhere
+    // a ByteCircularBuffer* is expected; the faster inline functions
+    // are used only when called via the template type, via the base
+    // type the generic functions are used, on the same state. For the
+    // fast path in a device, use the template type as its buffer type,
+    // like Buffered_serial_device<Cs, TByteCircularBuffer<256>>.
+
+    template<std::size_t N, std::size_t HighWaterMark_N = N,
+        std::size_t LowWaterMark_N = 0>
+      class TByteCircularBuffer : public ByteCircularBuffer
+      {
+        static_assert((N > 0) && ((N & (N - 1)) == 0),
+            "The size must be a power of 2.");
+        static_assert(HighWaterMark_N <= N,
+            "The high water mark cannot exceed the size.");
+        static_assert(LowWaterMark_N <= HighWaterMark_N,
+            "The low water mark cannot exceed the high water mark.");
+
+      public:
+
+        // The checksum variants of the base.
+        using ByteCircularBuffer::pushBack;
+        using ByteCircularBuffer::popFront;
+
+        static constexpr std::size_t bufferSize = N;
+        static constexpr std::size_t highWaterMark = HighWaterMark_N;
+        static constexpr std::size_t lowWaterMark = LowWaterMark_N;
+
+        TByteCircularBuffer ();
+
+        // Prevent copy, move, assign; the base points to the storage.
+        TByteCircularBuffer (const TByteCircularBuffer&) = delete;
+
+        TByteCircularBuffer (TByteCircularBuffer&&) = delete;
+
+        TByteCircularBuffer&
+        operator= (const TByteCircularBuffer&) = delete;
+
+        TByteCircularBuffer&
+        operator= (TByteCircularBuffer&&) = delete;
+
+        // --------------------------------------------------------------------
+
+        std::size_t
+        pushBack (uint8_t c);
+
+        std::size_t
+        pushBack (const uint8_t* buf, std::size_t count);
+
+        std::size_t
+        advanceBack (std::size_t count);
+
+        std::size_t
+        popFront (uint8_t* buf);
+
+        std::size_t
+        popFront (uint8_t* buf, std::size_t size);
+
+        std::size_t
+        advanceFront (std::size_t count);
+
+        bool
+        isEmpty (void) const;
+
+        bool
+        isFull (void) const;
+
+        bool
+        isAboveHighWaterMark (void) const;
+
+        bool
+        isBelowHighWaterMark (void) const;
+
+        bool
+        isAboveLowWaterMark (void) const;
+
+        bool
+        isBelowLowWaterMark (void) const;
+
+        static constexpr std::size_t
+        size (void);
+
+        // --------------------------------------------------------------------
+
+      private:
+
+        static constexpr std::size_t mask = N - 1;
+
+        uint8_t fStorage[N];
+      };
+
+    // ------------------------------------------------------------------------
+
+    inline uint8_t*
+    ByteCircularBuffer::data (void) const
+    {
+      return const_cast<uint8_t*> (fBuf);
+    }
+
+    inline void
+    ByteCircularBuffer::updateMaxLength (void)
+    {
+      if (fLen > fMaxLen)
+        {
+          fMaxLen = fLen;
+        }
+    }
+
+    inline void
+    ByteCircularBuffer::updateMaxLength (std::size_t len)
+    {
+      if (len > fMaxLen)
+        {
+          fMaxLen = len;
+        }
+    }
+
     inline const uint8_t&
     ByteCircularBuffer::operator[] (std::size_t idx) const
     {
@@ -197,6 +405,246 @@ namespace os
       return fSize;
     }
 
+    inline std::size_t
+    ByteCircularBuffer::getMaxLength (void) const
+    {
+      return fMaxLen;
+    }
+
+    inline void
+    ByteCircularBuffer::resetMaxLength (void)
+    {
+      fMaxLen = fLen;
+    }
+
+    // ------------------------------------------------------------------------
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      constexpr std::size_t TByteCircularBuffer<N, HighWaterMark_N,
+          LowWaterMark_N>::bufferSize;
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      constexpr std::size_t TByteCircularBuffer<N, HighWaterMark_N,
+          LowWaterMark_N>::highWaterMark;
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      constexpr std::size_t TByteCircularBuffer<N, HighWaterMark_N,
+          LowWaterMark_N>::lowWaterMark;
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      constexpr std::size_t TByteCircularBuffer<N, HighWaterMark_N,
+          LowWaterMark_N>::mask;
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::TByteCircularBuffer () :
+          ByteCircularBuffer (fStorage, N, HighWaterMark_N, LowWaterMark_N)
+      {
+        ;
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline std::size_t
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::pushBack (
+          uint8_t c)
+      {
+        std::size_t len = fLen;
+        if (len >= N)
+          {
+            return 0;
+          }
+
+        std::size_t back = fBack;
+        fStorage[back] = c;
+        fBack = (back + 1) & mask;
+        fLen = len + 1;
+        updateMaxLength (len + 1);
+        return 1;
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline std::size_t
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::pushBack (
+          const uint8_t* buf, std::size_t count)
+      {
+        std::size_t len = fLen;
+        if (count > (N - len))
+          {
+            count = N - len;
+          }
+
+        std::size_t back = fBack & mask;
+        std::size_t sizeToEnd = N - back;
+        if (count <= sizeToEnd)
+          {
+            copy_bytes (&fStorage[back], buf, count);
+          }
+        else
+          {
+            // The wrapped length with the mask, not the difference,
+            // so the compiler sees it in range.
+            std::size_t wrapped = (back + count) & mask;
+            copy_bytes (&fStorage[back], buf, sizeToEnd);
+            copy_bytes (&fStorage[0], buf + sizeToEnd, wrapped);
+          }
+        fBack = (back + count) & mask;
+        fLen = len + count;
+        updateMaxLength (len + count);
+        return count;
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline std::size_t
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::advanceBack (
+          std::size_t count)
+      {
+        std::size_t len = fLen;
+        if (count > (N - len))
+          {
+            count = N - len;
+          }
+
+        fBack = (fBack + count) & mask;
+        fLen = len + count;
+        updateMaxLength (len + count);
+        return count;
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline std::size_t
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::popFront (
+          uint8_t* buf)
+      {
+        std::size_t len = fLen;
+        if (len == 0)
+          {
+            return 0;
+          }
+
+        std::size_t front = fFront;
+        *buf = fStorage[front];
+        fFront = (front + 1) & mask;
+        fLen = len - 1;
+        return 1;
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline std::size_t
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::popFront (
+          uint8_t* buf, std::size_t siz)
+      {
+        std::size_t len = fLen;
+        if (siz > len)
+          {
+            siz = len;
+          }
+
+        std::size_t front = fFront & mask;
+        std::size_t sizeToEnd = N - front;
+        if (siz <= sizeToEnd)
+          {
+            copy_bytes (buf, &fStorage[front], siz);
+          }
+        else
+          {
+            // As for pushBack().
+            std::size_t wrapped = (front + siz) & mask;
+            copy_bytes (buf, &fStorage[front], sizeToEnd);
+            copy_bytes (buf + sizeToEnd, &fStorage[0], wrapped);
+          }
+        fFront = (front + siz) & mask;
+        fLen = len - siz;
+        return siz;
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline std::size_t
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::advanceFront (
+          std::size_t count)
+      {
+        std::size_t len = fLen;
+        if (count > len)
+          {
+            count = len;
+          }
+
+        fFront = (fFront + count) & mask;
+        fLen = len - count;
+        return count;
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline bool
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::isEmpty (
+          void) const
+      {
+        return (fLen == 0);
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline bool
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::isFull (
+          void) const
+      {
+        return (fLen >= N);
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline bool
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::isAboveHighWaterMark (
+          void) const
+      {
+        return (fLen >= HighWaterMark_N);
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline bool
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::isBelowHighWaterMark (
+          void) const
+      {
+        return (fLen < HighWaterMark_N);
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline bool
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::isBelowLowWaterMark (
+          void) const
+      {
+        return (fLen <= LowWaterMark_N);
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      inline bool
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::isAboveLowWaterMark (
+          void) const
+      {
+        return (fLen > LowWaterMark_N);
+      }
+
+    template<std::size_t N, std::size_t HighWaterMark_N,
+        std::size_t LowWaterMark_N>
+      constexpr std::size_t
+      TByteCircularBuffer<N, HighWaterMark_N, LowWaterMark_N>::size (void)
+      {
+        return N;
+      }
+
   } /* namespace dev */
 } /* namespace os */
 
@@ -0,0 +1,353 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef POSIX_DRIVERS_POOLED_BYTE_CIRCULAR_BUFFER_H_
+#define POSIX_DRIVERS_POOLED_BYTE_CIRCULAR_BUFFER_H_
+
+#include <posix-drivers/ByteBlockPool.h>
+
+#include <cstdint>
+#include <cstddef>
+
+// ----------------------------------------------------------------------------
+
+namespace os
+{
+  namespace dev
+  {
+    class Checksum;
+
+    // ------------------------------------------------------------------------
+
+    // Variant of ByteCircularBuffer, with the same API, that stores the
+    // bytes in a chain of blocks taken from a ByteBlockPool, shared with
+    // other buffers. The buffer grows, a block at a time, up to the
+    // given number of blocks, as long as the pool has free blocks, and
+    // returns the blocks to the pool as soon as they are consumed.
+    //
+    // The last block is kept even when the buffer is empty, since the
+    // driver may be receiving into it; trim() releases it, when nobody
+    // refers to it, and clear() releases all blocks. A receive buffer
+    // of an open Buffered_serial_device always has a receive armed,
+    // so it keeps one block; the transmit buffer releases its last
+    // block when the transmission completes.
+    //
+    // Differences from the rings:
+    // - the contiguous buffers, peekFront() and reserveBack() span at
+    //   most two blocks, so the total they return may be less than
+    //   the length or the free space;
+    // - the framed receive modes of Buffered_serial_device are not
+    //   supported, a frame may span more than two blocks;
+    // - isFull() is true when no more blocks can be added, so the
+    //   capacity depends on the other users of the pool.
+    //
+    // Accesses from the ISR and from the thread must be protected
+    // by critical sections, which must exclude the ISRs of all the
+    // users of the pool (see ByteBlockPool).
+
+    class PooledByteCircularBuffer
+    {
+    public:
+
+      static constexpr bool isLockFree = false;
+
+      // The storage is not a single ring.
+      static constexpr bool isChained = true;
+
+      // Returned by find() when not found.
+      static constexpr std::size_t npos = static_cast<std::size_t> (-1);
+
+      PooledByteCircularBuffer (ByteBlockPool& pool, std::size_t maxBlocks,
+                                std::size_t highWaterMark,
+                                std::size_t lowWaterMark = 0);
+
+      PooledByteCircularBuffer (ByteBlockPool& pool, std::size_t maxBlocks);
+
+      // Prevent copy, move, assign; the blocks belong to this buffer.
+      PooledByteCircularBuffer (const PooledByteCircularBuffer&) = delete;
+
+      PooledByteCircularBuffer&
+      operator= (const PooledByteCircularBuffer&) = delete;
+
+      ~PooledByteCircularBuffer ();
+
+      // ----------------------------------------------------------------------
+
+      // Also release all blocks to the pool.
+      void
+      clear (void);
+
+      // When empty, also release the last block; only when the driver
+      // does not refer to it.
+      void
+      trim (void);
+
+      // Insert bytes to the back of the buffer.
+      std::size_t
+      pushBack (uint8_t c);
+
+      std::size_t
+      pushBack (const uint8_t* buf, std::size_t count);
+
+      // Also update the checksum with the bytes copied.
+      std::size_t
+      pushBack (const uint8_t* buf, std::size_t count, Checksum& sum);
+
+      // Only inside the last block, as returned by
+      // getBackContiguousBuffer().
+      std::size_t
+      advanceBack (std::size_t count);
+
+      void
+      retreatBack (void);
+
+      // Retrieve bytes from the front of the buffer.
+      std::size_t
+      popFront (uint8_t* buf);
+
+      std::size_t
+      popFront (uint8_t* buf, std::size_t size);
+
+      // Also update the checksum with the bytes copied.
+      std::size_t
+      popFront (uint8_t* buf, std::size_t size, Checksum& sum);
+
+      std::size_t
+      advanceFront (std::size_t count);
+
+      // Get the address of the bytes in the first block, and length.
+      std::size_t
+      getFrontContiguousBuffer (uint8_t** ppbuf);
+
+      // Get the address of the free space in the last block, and length;
+      // when the last block is full, add a new one, if possible.
+      std::size_t
+      getBackContiguousBuffer (uint8_t** ppbuf);
+
+      // Zero-copy access to the bytes in the first two blocks.
+      // Return the total length of the two segments; release the
+      // bytes with advanceFront().
+      std::size_t
+      peekFront (uint8_t** ppbuf1, std::size_t* plen1, uint8_t** ppbuf2,
+                 std::size_t* plen2);
+
+      // Zero-copy access to the free space in the last block, the
+      // second segment is always empty. Return the total length;
+      // commit the bytes with advanceBack().
+      std::size_t
+      reserveBack (uint8_t** ppbuf1, std::size_t* plen1, uint8_t** ppbuf2,
+                   std::size_t* plen2);
+
+      // Return the offset, from the front, of the first occurrence of
+      // the byte at or after the given offset, or npos; the blocks
+      // are scanned a word at a time.
+      std::size_t
+      find (uint8_t c, std::size_t offset = 0) const;
+
+      // Return the number of occurrences of the byte.
+      std::size_t
+      count (uint8_t c) const;
+
+      // The released blocks return to the pool, there is no history
+      // before the front; always 0.
+      std::size_t
+      copyBeforeBack (std::size_t distance, uint8_t* buf,
+                      std::size_t count) const;
+
+      // Same bytes, without copying, as two contiguous segments;
+      // they remain valid only until the back passes over them.
+      std::size_t
+      peekBeforeBack (std::size_t distance, std::size_t count,
+                      const uint8_t** ppbuf1, std::size_t* plen1,
+                      const uint8_t** ppbuf2, std::size_t* plen2) const;
+
+      bool
+      isEmpty (void) const;
+
+      bool
+      isFull (void) const;
+
+      bool
+      isAboveHighWaterMark (void) const;
+
+      bool
+      isBelowHighWaterMark (void) const;
+
+      bool
+      isAboveLowWaterMark (void) const;
+
+      bool
+      isBelowLowWaterMark (void) const;
+
+      std::size_t
+      length (void) const;
+
+      // The maximum size, if the pool has enough free blocks.
+      std::size_t
+      size (void) const;
+
+      // The number of blocks taken from the pool.
+      std::size_t
+      getBlockCount (void) const;
+
+      // The maximum length reached since clear() or resetMaxLength(),
+      // to help right-size the buffer.
+      std::size_t
+      getMaxLength (void) const;
+
+      void
+      resetMaxLength (void);
+
+      void
+      dump (void);
+
+      // ----------------------------------------------------------------------
+
+    private:
+
+      // The number of bytes in the first block.
+      std::size_t
+      frontLength (void) const;
+
+      // Remove bytes from the first block; when consumed, release it,
+      // unless it is also the last one.
+      void
+      consumeFront (std::size_t count);
+
+      // Return the free space in the last block; when full, reuse it
+      // if empty, or add a new one, if possible.
+      std::size_t
+      prepareBack (void);
+
+      void
+      updateMaxLength (void);
+
+      // ----------------------------------------------------------------------
+
+      ByteBlockPool& fPool;
+      std::size_t const fBlockSize;
+      std::size_t const fMaxBlocks;
+      std::size_t const fSize;
+      std::size_t const fHighWaterMark;
+      std::size_t const fLowWaterMark;
+
+      // The following are volatile because they can be updated on
+      // different threads or even on interrupts.
+
+      // The chain, from the first to the last block.
+      ByteBlockPool::index_t volatile fHead;
+      ByteBlockPool::index_t volatile fTail;
+
+      // Index of the first used position to pop, in the first block.
+      std::size_t volatile fFront;
+
+      // Index of the next free position to push, in the last block.
+      std::size_t volatile fBack;
+
+      std::size_t volatile fLen;
+      std::size_t volatile fBlocks;
+      std::size_t volatile fMaxLen;
+    };
+
+    // ------------------------------------------------------------------------
+
+    inline std::size_t
+    PooledByteCircularBuffer::length (void) const
+    {
+      return fLen;
+    }
+
+    inline std::size_t
+    PooledByteCircularBuffer::size (void) const
+    {
+      return fSize;
+    }
+
+    inline std::size_t
+    PooledByteCircularBuffer::getBlockCount (void) const
+    {
+      return fBlocks;
+    }
+
+    inline std::size_t
+    PooledByteCircularBuffer::getMaxLength (void) const
+    {
+      return fMaxLen;
+    }
+
+    inline void
+    PooledByteCircularBuffer::resetMaxLength (void)
+    {
+      fMaxLen = fLen;
+    }
+
+    inline void
+    PooledByteCircularBuffer::updateMaxLength (void)
+    {
+      if (fLen > fMaxLen)
+        {
+          fMaxLen = fLen;
+        }
+    }
+
+    inline bool
+    PooledByteCircularBuffer::isEmpty (void) const
+    {
+      return (fLen == 0);
+    }
+
+    inline bool
+    PooledByteCircularBuffer::isAboveHighWaterMark (void) const
+    {
+      // Allow for water mark to be size.
+      return (fLen >= fHighWaterMark);
+    }
+
+    inline bool
+    PooledByteCircularBuffer::isBelowLowWaterMark (void) const
+    {
+      // Allow for water mark to be 0.
+      return (fLen <= fLowWaterMark);
+    }
+
+    inline bool
+    PooledByteCircularBuffer::isBelowHighWaterMark (void) const
+    {
+      return !isAboveHighWaterMark ();
+    }
+
+    inline bool
+    PooledByteCircularBuffer::isAboveLowWaterMark (void) const
+    {
+      return !isBelowLowWaterMark ();
+    }
+
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* POSIX_DRIVERS_POOLED_BYTE_CIRCULAR_BUFFER_H_ */
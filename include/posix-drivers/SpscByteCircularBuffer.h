@@ -0,0 +1,351 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef POSIX_DRIVERS_SPSC_BYTE_CIRCULAR_BUFFER_H_
+#define POSIX_DRIVERS_SPSC_BYTE_CIRCULAR_BUFFER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+// ----------------------------------------------------------------------------
+
+namespace os
+{
+  namespace dev
+  {
+    class Checksum;
+
+    // ------------------------------------------------------------------------
+
+    // Single producer, single consumer variant of ByteCircularBuffer,
+    // with the same API.
+    //
+    // There is no shared length; the producer owns the back index and
+    // the consumer owns the front index, and each side only reads the
+    // index of the other side (acquire) and publishes its own (release).
+    // Only atomic loads and stores are used, no read-modify-write, so
+    // it is lock-free on all Cortex-M cores, including M0.
+    //
+    // Producer side: pushBack(), advanceBack(),
+    // getBackContiguousBuffer(), reserveBack(). The back index only
+    // moves forwards; there is no retreatBack(), a consumer might
+    // have already released the byte.
+    // Consumer side: popFront(), advanceFront(), getFrontContiguousBuffer(),
+    // peekFront(), find(), count().
+    //
+    // clear() must not be called while the other side is active.
+    //
+    // The indices run over [0, 2*size), so a full buffer can be
+    // distinguished from an empty one without wasting a byte.
+
+    class SpscByteCircularBuffer
+    {
+    public:
+
+      // No critical sections required between producer and consumer.
+      static constexpr bool isLockFree = true;
+
+      // The storage is a single ring, peekFront() returns all the bytes.
+      static constexpr bool isChained = false;
+
+      // Returned by find() when not found.
+      static constexpr std::size_t npos = static_cast<std::size_t> (-1);
+
+      SpscByteCircularBuffer (uint8_t* buf, std::size_t size,
+                              std::size_t highWaterMark,
+                              std::size_t lowWaterMark = 0);
+
+      SpscByteCircularBuffer (uint8_t* buf, std::size_t size);
+
+      // ----------------------------------------------------------------------
+
+      void
+      clear (void);
+
+      const uint8_t&
+      operator[] (std::size_t idx) const;
+
+      // Insert bytes to the back of the buffer.
+      std::size_t
+      pushBack (uint8_t c);
+
+      std::size_t
+      pushBack (const uint8_t* buf, std::size_t count);
+
+      // Also update the checksum with the bytes copied.
+      std::size_t
+      pushBack (const uint8_t* buf, std::size_t count, Checksum& sum);
+
+      std::size_t
+      advanceBack (std::size_t count);
+
+      // Retrieve bytes from the front of the buffer.
+      std::size_t
+      popFront (uint8_t* buf);
+
+      std::size_t
+      popFront (uint8_t* buf, std::size_t size);
+
+      // Also update the checksum with the bytes copied.
+      std::size_t
+      popFront (uint8_t* buf, std::size_t size, Checksum& sum);
+
+      std::size_t
+      advanceFront (std::size_t count);
+
+      // Get the address of the largest contiguous buffer in the front, and
+      // length; might be only partial, if buffer wraps.
+      std::size_t
+      getFrontContiguousBuffer (uint8_t** ppbuf);
+
+      // Get the address of the largest contiguous buffer in the back, and
+      // length; might be only partial, if buffer wraps.
+      std::size_t
+      getBackContiguousBuffer (uint8_t** ppbuf);
+
+      // Zero-copy access to the bytes in the front, as two contiguous
+      // segments; the second is not empty only if the data wraps.
+      // Return the total length; release the bytes with advanceFront().
+      std::size_t
+      peekFront (uint8_t** ppbuf1, std::size_t* plen1, uint8_t** ppbuf2,
+                 std::size_t* plen2);
+
+      // Zero-copy access to the free space in the back, as two contiguous
+      // segments; the second is not empty only if the space wraps.
+      // Return the total length; commit the bytes with advanceBack().
+      std::size_t
+      reserveBack (uint8_t** ppbuf1, std::size_t* plen1, uint8_t** ppbuf2,
+                   std::size_t* plen2);
+
+      // Return the offset, from the front, of the first occurrence of
+      // the byte at or after the given offset, or npos; the two
+      // segments are scanned a word at a time.
+      std::size_t
+      find (uint8_t c, std::size_t offset = 0) const;
+
+      // Return the number of occurrences of the byte.
+      std::size_t
+      count (uint8_t c) const;
+
+      // Copy up to count bytes of the stream that ended at the back,
+      // beginning at the given distance before the back (at most the
+      // size); the bytes already released from the front are still in
+      // the storage, until overwritten. Return the number of bytes
+      // copied. For a second reader, like a diagnostic tap.
+      std::size_t
+      copyBeforeBack (std::size_t distance, uint8_t* buf,
+                      std::size_t count) const;
+
+      // Same bytes, without copying, as two contiguous segments;
+      // they remain valid only until the back passes over them.
+      std::size_t
+      peekBeforeBack (std::size_t distance, std::size_t count,
+                      const uint8_t** ppbuf1, std::size_t* plen1,
+                      const uint8_t** ppbuf2, std::size_t* plen2) const;
+
+      bool
+      isEmpty (void) const;
+
+      bool
+      isFull (void) const;
+
+      bool
+      isAboveHighWaterMark (void) const;
+
+      bool
+      isBelowHighWaterMark (void) const;
+
+      bool
+      isAboveLowWaterMark (void) const;
+
+      bool
+      isBelowLowWaterMark (void) const;
+
+      std::size_t
+      length (void) const;
+
+      std::size_t
+      size (void) const;
+
+      // The maximum length reached since clear() or resetMaxLength(),
+      // as seen by the producer; to help right-size the buffer.
+      std::size_t
+      getMaxLength (void) const;
+
+      // Producer side.
+      void
+      resetMaxLength (void);
+
+      void
+      dump (void);
+
+      // ----------------------------------------------------------------------
+
+    private:
+
+      // Advance an index, modulo 2*size.
+      std::size_t
+      next (std::size_t idx, std::size_t count) const;
+
+      // Convert an index to a position in the buffer.
+      std::size_t
+      position (std::size_t idx) const;
+
+      // Number of bytes between the two indices.
+      std::size_t
+      distance (std::size_t back, std::size_t front) const;
+
+      void
+      updateMaxLength (std::size_t len);
+
+      // ----------------------------------------------------------------------
+
+      uint8_t* const fBuf;
+      std::size_t const fSize;
+      std::size_t const fHighWaterMark;
+      std::size_t const fLowWaterMark;
+
+      // Next free index to push, at the back. Written only by the producer.
+      std::atomic<std::size_t> fBack;
+
+      // First used index to pop, at the front. Written only by the consumer.
+      std::atomic<std::size_t> fFront;
+
+      // Written only by the producer.
+      std::atomic<std::size_t> fMaxLen;
+    };
+
+    // ------------------------------------------------------------------------
+
+    inline std::size_t
+    SpscByteCircularBuffer::next (std::size_t idx, std::size_t count) const
+    {
+      idx += count;
+      if (idx >= 2 * fSize)
+        {
+          // Wrap.
+          idx -= 2 * fSize;
+        }
+      return idx;
+    }
+
+    inline std::size_t
+    SpscByteCircularBuffer::position (std::size_t idx) const
+    {
+      return (idx < fSize) ? idx : (idx - fSize);
+    }
+
+    inline std::size_t
+    SpscByteCircularBuffer::distance (std::size_t back,
+                                      std::size_t front) const
+    {
+      return (back >= front) ? (back - front) : (back + 2 * fSize - front);
+    }
+
+    inline void
+    SpscByteCircularBuffer::updateMaxLength (std::size_t len)
+    {
+      if (len > fMaxLen.load (std::memory_order_relaxed))
+        {
+          fMaxLen.store (len, std::memory_order_relaxed);
+        }
+    }
+
+    inline std::size_t
+    SpscByteCircularBuffer::getMaxLength (void) const
+    {
+      return fMaxLen.load (std::memory_order_relaxed);
+    }
+
+    inline void
+    SpscByteCircularBuffer::resetMaxLength (void)
+    {
+      fMaxLen.store (length (), std::memory_order_relaxed);
+    }
+
+    inline const uint8_t&
+    SpscByteCircularBuffer::operator[] (std::size_t idx) const
+    {
+      return fBuf[idx];
+    }
+
+    inline std::size_t
+    SpscByteCircularBuffer::length (void) const
+    {
+      return distance (fBack.load (std::memory_order_acquire),
+                       fFront.load (std::memory_order_acquire));
+    }
+
+    inline std::size_t
+    SpscByteCircularBuffer::size (void) const
+    {
+      return fSize;
+    }
+
+    inline bool
+    SpscByteCircularBuffer::isEmpty (void) const
+    {
+      return (length () == 0);
+    }
+
+    inline bool
+    SpscByteCircularBuffer::isFull (void) const
+    {
+      return (length () >= fSize);
+    }
+
+    inline bool
+    SpscByteCircularBuffer::isAboveHighWaterMark (void) const
+    {
+      // Allow for water mark to be size.
+      return (length () >= fHighWaterMark);
+    }
+
+    inline bool
+    SpscByteCircularBuffer::isBelowLowWaterMark (void) const
+    {
+      // Allow for water mark to be 0.
+      return (length () <= fLowWaterMark);
+    }
+
+    inline bool
+    SpscByteCircularBuffer::isBelowHighWaterMark (void) const
+    {
+      return !isAboveHighWaterMark ();
+    }
+
+    inline bool
+    SpscByteCircularBuffer::isAboveLowWaterMark (void) const
+    {
+      return !isBelowLowWaterMark ();
+    }
+
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* POSIX_DRIVERS_SPSC_BYTE_CIRCULAR_BUFFER_H_ */
@@ -34,12 +34,49 @@
 
 #include <cmsis-plus/posix-io/CharDevice.h>
 #include <posix-drivers/ByteCircularBuffer.h>
+#include <posix-drivers/SpscByteCircularBuffer.h>
+#include <posix-drivers/PooledByteCircularBuffer.h>
+#include <posix-drivers/byte-scan.h>
+#include <posix-drivers/crc.h>
+#include <posix-drivers/serial-frame.h>
+#include <posix-drivers/serial-ioctl.h>
+#include <posix-drivers/serial-bridge.h>
+#include <posix-drivers/serial-event.h>
+#include <posix-drivers/serial-poll.h>
+#include <posix-drivers/serial-trace.h>
 #include <cmsis-plus/drivers/serial.h>
 
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+
+// ----------------------------------------------------------------------------
+
+// Define OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS to maintain the
+// serial_ioctl::Statistics counters; the ISR duration is measured with
+// OS_POSIX_DRIVERS_SERIAL_CYCLES(), see serial-trace.h.
+//
+// Define OS_INCLUDE_POSIX_DRIVERS_SERIAL_TRACE to record the events,
+// with timestamps, in the serial_trace ring.
+
+// The time source for the receive stamps; redefine it for a higher
+// resolution, for example to use a timer or the cycle counter.
+#if !defined(OS_POSIX_DRIVERS_SERIAL_RX_TIMESTAMP)
+#define OS_POSIX_DRIVERS_SERIAL_RX_TIMESTAMP() \
+  (os::rtos::systick_clock.now ())
+#endif
+
+// The maximum number of received frames pending, in the framed
+// receive modes; must be a power of 2.
+#if !defined(OS_INTEGER_POSIX_DRIVERS_SERIAL_RX_FRAMES)
+#define OS_INTEGER_POSIX_DRIVERS_SERIAL_RX_FRAMES (8)
+#endif
+
 // ----------------------------------------------------------------------------
 
 // TODO: (multiline)
-// - add flow control on both send & receive
+// - return 0 at end of file (a disconnect is reported as EIO)
 // - cancel pending reads/writes at close (partly done)
 // - add error processing
 
@@ -49,20 +86,264 @@ namespace os
   {
     // ------------------------------------------------------------------------
 
+    // The reception of the bytes that came with one driver event.
+    struct Serial_rx_stamp
+    {
+      // The stream position after the last byte of the chunk, as the
+      // number of bytes received since open(); the chunk begins at the
+      // end of the previous one.
+      uint32_t end;
+
+      // The os::driver::serial::Event bits of the chunk; rx_timeout
+      // marks an idle line after the chunk (a silence boundary),
+      // the rx_*_error, rx_break and rx_overflow bits the errors.
+      uint32_t flags;
+
+      // When the driver reported the chunk, as returned by
+      // OS_POSIX_DRIVERS_SERIAL_RX_TIMESTAMP().
+      os::rtos::clock::timestamp_t timestamp;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // Used instead of the user critical section when the buffers
+    // are lock-free.
+    class Null_critical_section
+    {
+    public:
+
+      inline
+      Null_critical_section ()
+      {
+        ;
+      }
+
+      inline
+      ~Null_critical_section ()
+      {
+        ;
+      }
+    };
+
+    // ------------------------------------------------------------------------
+
+    // Besides the os::driver::Serial functions, the driver types
+    // implement the scatter-gather send, used by the controllers with
+    // linked-list DMA:
+    //
+    //   std::size_t
+    //   get_send_segments_max (void);
+    //
+    //   os::driver::return_t
+    //   send_chain (const struct iovec* iov, int iovcnt);
+    //
+    // send_chain() sends all the segments (some may be empty) as one
+    // transfer, with a single tx_complete at the end, get_tx_count()
+    // counting the bytes of all the segments; the array must not be
+    // used after the call returns. The device calls it only for up to
+    // get_send_segments_max() segments, read at open(); with 0 or 1,
+    // the segments are sent one at a time. The device sends both
+    // segments of a wrapped transmit buffer, or all the writev()
+    // segments, as a single transfer.
+    //
+    // os::driver::Serial, the µOS++ interface, has no scatter-gather
+    // send; its drivers get a chained send by being used directly, as
+    // the driver type.
+
+    template<typename Driver_T>
+      struct Serial_send_chain
+      {
+        static std::size_t
+        get_segments_max (Driver_T& driver)
+        {
+          return driver.get_send_segments_max ();
+        }
+
+        static os::driver::return_t
+        send (Driver_T& driver, const struct iovec* iov, int iovcnt)
+        {
+          return driver.send_chain (iov, iovcnt);
+        }
+      };
+
+    template<>
+      struct Serial_send_chain<os::driver::Serial>
+      {
+        static std::size_t
+        get_segments_max (os::driver::Serial& driver __attribute__((unused)))
+        {
+          return 0;
+        }
+
+        static os::driver::return_t
+        send (os::driver::Serial& driver __attribute__((unused)),
+              const struct iovec* iov __attribute__((unused)),
+              int iovcnt __attribute__((unused)))
+        {
+          return os::driver::ERROR_UNSUPPORTED;
+        }
+      };
+
+    // Release the storage of an empty chained buffer, which takes
+    // blocks from a shared pool; the rings keep their storage.
+    template<bool Is_chained_T>
+      struct Buffer_trim
+      {
+        template<typename Buffer_T>
+          static void
+          trim (Buffer_T& buffer __attribute__((unused)))
+          {
+            ;
+          }
+      };
+
+    template<>
+      struct Buffer_trim<true>
+      {
+        template<typename Buffer_T>
+          static void
+          trim (Buffer_T& buffer)
+          {
+            buffer.trim ();
+          }
+      };
+
+    // The pool of a chained buffer is shared with other devices and
+    // is not protected; the critical section must exclude the ISRs of
+    // all of them, for example by disabling the interrupts, and must
+    // say so with a static constexpr bool isGlobal = true member.
+    template<bool Is_chained_T>
+      struct Buffer_pool_lock
+      {
+        template<typename Cs_T>
+          static constexpr bool
+          is_global (void)
+          {
+            return true;
+          }
+      };
+
+    template<>
+      struct Buffer_pool_lock<true>
+      {
+        template<typename Cs_T>
+          static constexpr bool
+          is_global (void)
+          {
+            return Cs_T::isGlobal;
+          }
+      };
+
+    // ------------------------------------------------------------------------
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpadded"
 
-    template<typename Cs_T>
-      class Buffered_serial_device : public os::posix::CharDevice
+    // The buffer type can be ByteCircularBuffer, which requires the
+    // buffer accesses to be protected by critical sections, or
+    // SpscByteCircularBuffer, which allows the ISR and the thread to
+    // access the buffers without disabling interrupts, or
+    // PooledByteCircularBuffer, which takes blocks from a pool shared
+    // with other devices, as needed; it does not support the framed
+    // receive modes, and the critical section must exclude the ISRs
+    // of all the devices sharing the pool (see Buffer_pool_lock). An
+    // open device keeps one block in the receive buffer, where the
+    // receive is armed, even when it is empty.
+    //
+    // The buffer type can also be TByteCircularBuffer<N>, with the
+    // storage inline and the size a power of 2; the device then calls
+    // its inline functions, which wrap with a mask, not the generic
+    // ones of the base. The receive and the transmit buffers are of
+    // the same type, so of the same size.
+    //
+    // The critical section is still used for the driver accesses.
+    //
+    // The driver type can be os::driver::Serial, for any driver, via
+    // virtual functions, or a concrete type with the same API and the
+    // scatter-gather send (see Serial_send_chain), like Serial_loopback
+    // or os::cmsis::driver::Usart_direct_wrapper, which gets direct
+    // calls, also from signal_event().
+
+    template<typename Cs_T, typename Buffer_T = ByteCircularBuffer,
+        typename Driver_T = os::driver::Serial>
+      class Buffered_serial_device : public os::posix::CharDevice,
+                                     public Serial_pollable,
+                                     public Serial_bridgeable
       {
         using Critical_section = Cs_T;
 
+        static_assert(
+            Buffer_pool_lock<Buffer_T::isChained>::template is_global<Cs_T> (),
+            "A pooled buffer needs a critical section that excludes all "
+            "the ISRs (Cs_T::isGlobal)");
+
+        // Critical section used only around buffer accesses.
+        using Buffer_critical_section = typename std::conditional<
+        Buffer_T::isLockFree, Null_critical_section, Cs_T>::type;
+
       public:
 
+        using Buffer = Buffer_T;
+        using Driver = Driver_T;
+
+        // How the driver receive is armed.
+        enum class Rx_mode
+          : uint8_t
+            {
+              // Receive into all the contiguous free space; when the
+              // buffer is full, overwrite the last byte. With a
+              // lock-free buffer, where only the consumer may release
+              // bytes, discard the incoming bytes, as for ping_pong.
+              continuous,
+
+              // Receive into at most half of the buffer, so the ISR
+              // re-arms the driver, and wakes up the reader, at least
+              // twice per buffer; the next half is armed from the ISR,
+              // not chained in advance. When the buffer is full, discard
+              // the incoming bytes and count them as overruns, until
+              // the reader frees some space.
+              ping_pong
+        };
+
+        // What happens when the receive tap is too slow.
+        enum class Rx_tap_policy
+          : uint8_t
+            {
+              // No tap.
+              none,
+
+              // The oldest bytes the tap did not see are overwritten
+              // and counted as tap drops; the device is not affected.
+              drop,
+
+              // The bytes the tap did not see are kept; when there is
+              // no other space, the incoming bytes are discarded and
+              // counted as overruns, as for a slow reader.
+              stall
+        };
+
+        // How the driver events are processed.
+        enum class Event_dispatch
+          : uint8_t
+            {
+              // In the ISR, as they come; the lowest latency.
+              isr,
+
+              // The ISR only records the event bits, and the events
+              // are processed in batches by dispatch_events(), with
+              // the interrupts disabled for the receive, the transmit
+              // and the modem line events in turn; the driver counts
+              // are read once per batch. The events in the immediate mask are
+              // still processed in the ISR, with the pending ones.
+              deferred
+        };
+
+        // Called from the ISR, to schedule a deferred handler.
+        using Event_notify = void (*) (void* arg);
+
         Buffered_serial_device (const char* device_name,
-                                os::driver::Serial* driver,
-                                os::dev::ByteCircularBuffer* rx_buf,
-                                os::dev::ByteCircularBuffer* tx_buf);
+                                Driver_T* driver, Buffer_T* rx_buf,
+                                Buffer_T* tx_buf);
 
         // Prevent copy, move, assign
         Buffered_serial_device (const Buffered_serial_device&) = delete;
@@ -86,6 +367,167 @@ namespace os
         static void
         signal_event (Buffered_serial_device* object, uint32_t event);
 
+        // Process the events recorded by the ISR, if any, as the ISR
+        // would have done. With deferred dispatch, called by the
+        // handler scheduled by the notify function; the device calls
+        // it too, from read(), write() and the other blocking calls,
+        // before checking the buffers.
+        void
+        dispatch_events (void);
+
+        // --------------------------------------------------------------------
+
+        // Zero-copy receive. Block until bytes are available, then
+        // return them as two contiguous segments in the receive buffer
+        // (the second is not empty only if the data wraps), and the
+        // total length. The bytes remain in the buffer until released
+        // with rx_consume(). With XON/XOFF flow control, the received
+        // XON/XOFF characters are not removed.
+        ssize_t
+        rx_peek (uint8_t** ppbuf1, std::size_t* plen1, uint8_t** ppbuf2,
+                 std::size_t* plen2);
+
+        std::size_t
+        rx_consume (std::size_t nbyte);
+
+        // Zero-copy framed receive. Block until a frame is received,
+        // then return its raw (not decoded) bytes, including the end
+        // delimiter, if any, as two contiguous segments, and the total
+        // length. The frame remains in the buffer until released with
+        // rx_consume_frame(). Requires a framing mode.
+        ssize_t
+        rx_peek_frame (uint8_t** ppbuf1, std::size_t* plen1,
+                       uint8_t** ppbuf2, std::size_t* plen2);
+
+        void
+        rx_consume_frame (void);
+
+        // Like read(), and also return the stamps of the chunks the
+        // bytes came with, up to the number given in *pcount; a chunk is
+        // returned if any of its bytes were read. Return in *pcount the
+        // number of stamps. Requires set_rx_stamps().
+        ssize_t
+        readmsg (void* buf, std::size_t nbyte, Serial_rx_stamp* stamps,
+                 std::size_t* pcount);
+
+        // Like read() and write(), and also update the checksum with
+        // the bytes transferred, while they are copied out of or into
+        // the buffers; the caller gets the running value from the
+        // checksum. Partial transfers update it only with the bytes
+        // actually transferred.
+        ssize_t
+        read_checksum (void* buf, std::size_t nbyte, Checksum& sum);
+
+        ssize_t
+        write_checksum (const void* buf, std::size_t nbyte, Checksum& sum);
+
+        // Zero-copy transmit. Block until there is free space in the
+        // transmit buffer, then return it as two contiguous segments
+        // and the total length. Fill them and call tx_commit() to
+        // start the transmission.
+        ssize_t
+        tx_reserve (uint8_t** ppbuf1, std::size_t* plen1, uint8_t** ppbuf2,
+                    std::size_t* plen2);
+
+        ssize_t
+        tx_commit (std::size_t nbyte);
+
+        // Send the bytes held in the transmit buffer, and wait for
+        // the transmission to complete; like tcdrain().
+        int
+        drain (void);
+
+        // --------------------------------------------------------------------
+
+        // Must be called before open(). Keep the stamps of the last
+        // received chunks in the array, for readmsg(); when full, the
+        // oldest are overwritten. nullptr disables the stamps.
+        void
+        set_rx_stamps (Serial_rx_stamp* stamps, std::size_t count);
+
+        // Must be called before open().
+        void
+        set_rx_mode (Rx_mode mode);
+
+        // Must be called before open(), not with pooled buffers. Enable
+        // a second reader of the received bytes, for diagnostics (a
+        // logger or a sniffer), with its own position in the stream;
+        // it reads the bytes still in the receive buffer, also those
+        // already read, without copies in the read() path and without
+        // delaying it.
+        void
+        set_rx_tap (Rx_tap_policy policy);
+
+        // Copy the received bytes the tap did not see yet; does not
+        // block, return 0 if there are none, or -1 and errno. The
+        // bytes are raw, with the XON/XOFF characters and not decoded
+        // in the framing modes.
+        ssize_t
+        rx_tap_read (void* buf, std::size_t nbyte);
+
+        // Number of received bytes the tap lost, since open().
+        std::size_t
+        get_rx_tap_drop_count (void) const;
+
+        // Must be called before open(). With deferred dispatch, the
+        // notify function is called from the ISR when the first event
+        // of a batch is recorded; without one, the threads waiting in
+        // the device (read, write, poll) are woken up, and dispatch
+        // the events themselves, as do the device timers. Since there
+        // may be no such thread, without a notify function the events
+        // that would stall the transfers if deferred are always
+        // processed in the ISR: receive_complete (re-arm the receive),
+        // tx_complete (send the next bytes) and cts (resume); the
+        // others, like rx_timeout, only move the bytes received so far
+        // and wait for the next reader. Keep Event::receive_complete
+        // in the immediate mask if the receive must be re-armed at once.
+        // At low power, the first event is processed in the ISR, to
+        // restore the full power.
+        void
+        set_event_dispatch (Event_dispatch mode, uint32_t immediate_events =
+                                0,
+                            Event_notify notify = nullptr,
+                            void* notify_arg = nullptr);
+
+        Rx_mode
+        get_rx_mode (void) const;
+
+        // Number of received bytes lost because the buffer was full,
+        // since open() or serial_ioctl::reset_statistics.
+        std::size_t
+        get_rx_overrun_count (void) const;
+
+        // --------------------------------------------------------------------
+
+        // The event is posted when the receive buffer reaches the
+        // receive threshold, when the transmit buffer goes below the
+        // low water mark, and on connect/disconnect.
+        virtual void
+        set_poll_event (Serial_poll_event* event) override;
+
+        // serial_poll::in when read() would not block (the receive
+        // threshold is reached or the line is idle), serial_poll::out
+        // when write() would not block.
+        virtual unsigned int
+        get_poll_events (void) override;
+
+        // --------------------------------------------------------------------
+
+        // See serial-bridge.h; close() stops the bridges of the device.
+        // While forwarding, the readers are not woken up; the received
+        // XON/XOFF characters are forwarded too.
+        virtual int
+        set_bridge_sink (Serial_bridgeable* sink) override;
+
+        virtual int
+        set_bridge_source (Serial_bridgeable* source) override;
+
+        virtual std::size_t
+        bridge_push (const uint8_t* buf, std::size_t nbyte) override;
+
+        virtual void
+        bridge_pull (void) override;
+
         // --------------------------------------------------------------------
 
       protected:
@@ -102,16 +544,15 @@ namespace os
         virtual ssize_t
         do_write (const void* buf, std::size_t nbyte) override;
 
-#if 0
         virtual ssize_t
         do_writev (const struct iovec* iov, int iovcnt) override;
 
         virtual int
         do_vioctl (int request, std::va_list args) override;
 
+        // F_GETFL and F_SETFL, to change O_NONBLOCK.
         virtual int
-        do_vfcntl (int cmd, va_list args) override;
-#endif
+        do_vfcntl (int cmd, std::va_list args) override;
 
         virtual bool
         do_is_opened (void) override;
@@ -123,34 +564,362 @@ namespace os
 
       private:
 
+        // Called by the thread after adding bytes to the transmit
+        // buffer; start the transmission only if the chain is idle,
+        // otherwise the ISR continues it. Unless flushing, with
+        // coalescing, hold the bytes until enough are in the buffer.
+        os::driver::return_t
+        start_send (bool flush = false);
+
+        // The implementations of read() and write(); the checksum
+        // is optional.
+        ssize_t
+        rx_read (void* buf, std::size_t nbyte, Checksum* sum);
+
+        ssize_t
+        tx_write (const void* buf, std::size_t nbyte, Checksum* sum);
+
+        std::size_t
+        tx_push (const uint8_t* buf, std::size_t nbyte, Checksum* sum);
+
+        // Called when the coalescing timer expires.
+        static void
+        tx_flush_timer_cb (os::rtos::timer::func_args_t args);
+
+        // The processing of the driver events, in the ISR or, with
+        // deferred dispatch, in dispatch_events().
+        static void
+        handle_event (Buffered_serial_device* object, uint32_t event);
+
+        // The parts of handle_event(), for the received bytes, the
+        // transmit completion and the modem lines; dispatch_events()
+        // disables the interrupts for one part at a time.
+        static void
+        handle_rx_event (Buffered_serial_device* object, uint32_t event);
+
+        static void
+        handle_tx_event (Buffered_serial_device* object, uint32_t event);
+
+        static void
+        handle_line_event (Buffered_serial_device* object, uint32_t event);
+
+        // Called periodically with an idle power policy; lower the
+        // power if there was no activity since the previous call.
+        static void
+        power_timer_cb (os::rtos::timer::func_args_t args);
+
+        // Called by the thread and by the ISR before using the driver;
+        // mark the activity and restore the full power, if low.
+        void
+        power_wake (void);
+
+        // The driver refused a transfer and there is no write() to
+        // return EIO; count it and wake up the writers, to retry.
+        void
+        tx_error (void);
+
+        // The driver refused to receive into the buffer; count it and
+        // keep a receive armed, into the discard buffer, so that the
+        // next event or the reader retries.
+        void
+        rx_error (void);
+
+        // Wait for the semaphore, according to O_NONBLOCK and the
+        // timeout; return 0, EAGAIN or ETIMEDOUT. Without is_stoppable,
+        // for a transfer from the user buffer, O_NONBLOCK is ignored.
+        int
+        wait_sem (os::rtos::semaphore_binary& sem,
+                  os::rtos::clock::duration_t timeout,
+                  bool is_stoppable = true);
+
+        // Stop the transfer from the user buffers, and the chain of
+        // the writev() segments, before returning early.
+        void
+        tx_abort_direct (void);
+
+        // Arm the driver to receive into the back of the receive buffer,
+        // according to the receive mode.
+        os::driver::return_t
+        start_receive (void);
+
+        // The space at the back of the receive buffer start_receive()
+        // arms the driver on, according to the receive mode and the
+        // tap policy; 0 if it must discard.
+        std::size_t
+        rx_arm_space (uint8_t** pbuf);
+
+        // With no space in the receive buffer, in continuous mode,
+        // overwrite its last byte and return the space at the back;
+        // 0 if it must discard. The lock-free buffers, whose back
+        // index only moves forwards, are never overwritten; selected
+        // at compile time, retreatBack() is not even required.
+        std::size_t
+        rx_overwrite_last (uint8_t** pbuf, std::true_type);
+
+        std::size_t
+        rx_overwrite_last (uint8_t** pbuf, std::false_type);
+
+        // Called after space was freed in the receive buffer; if the
+        // driver receives into the discard buffer, re-arm it on the
+        // receive buffer.
+        void
+        rx_check_rearm (void);
+
+        // The number of bytes before the back of the receive buffer
+        // the tap can still read; the ones after are being overwritten
+        // by the driver receive. With the critical section taken.
+        std::size_t
+        rx_tap_valid (void) const;
+
+        // Process the bytes received up to the driver count; return
+        // the number of bytes added to the receive buffer.
+        std::size_t
+        rx_account (std::size_t rx_count);
+
+        bool
+        is_valid_flow_control (int flow) const;
+
+        // Called from the ISR; record the chunk.
+        void
+        rx_stamp (std::size_t count, uint32_t event);
+
+        // Called from the ISR; record the ends of the frames in the
+        // new bytes, or, at idle line, after them.
+        void
+        rx_frame_scan (const uint8_t* buf, std::size_t count, bool is_idle);
+
+        // Called from the ISR; the frame ends at the stream position.
+        void
+        rx_frame_push (uint32_t end);
+
+        // Block until a frame is received, return 0 and the stream
+        // position where it ends, or an errno value.
+        int
+        rx_frame_wait (uint32_t* pend);
+
+        // The read() in a framing mode; return one decoded frame.
+        ssize_t
+        rx_read_frame (void* buf, std::size_t nbyte);
+
+        int
+        set_flow_control (int flow);
+
+        // Apply a new configuration to an open device, without losing
+        // the received bytes.
+        int
+        reconfigure (const serial_ioctl::Line_config* config);
+
+        // Called with interrupts disabled and the transmitter idle;
+        // send the pending XON/XOFF, or, if not paused, the front of
+        // the transmit buffer. Mark the chain idle if nothing to send.
+        os::driver::return_t
+        send_next (void);
+
+        // Call the driver send_chain(), for up to tx_segments_max_
+        // segments.
+        os::driver::return_t
+        send_chain (const struct iovec* iov, int iovcnt);
+
+        // Called with interrupts disabled, after a pause condition
+        // changed; stop or restart the transmission.
+        void
+        update_tx_pause (void);
+
+        bool
+        is_tx_paused (void) const;
+
+        // Called from the ISR; ask the peer to stop sending when the
+        // receive buffer goes above the high water mark.
+        void
+        rx_check_throttle (void);
+
+        // Called after bytes were removed from the receive buffer; ask
+        // the peer to resume when below the low water mark.
+        void
+        rx_check_unthrottle (void);
+
+        // Send the XON/XOFF before the bytes in the transmit buffer.
+        void
+        tx_send_flow_char (uint8_t c);
+
+        // Called from the ISR; process the XON/XOFF received.
+        void
+        rx_scan_flow_chars (const uint8_t* buf, std::size_t count);
+
+        // Remove the XON/XOFF characters, return the new count.
+        static std::size_t
+        rx_strip_flow_chars (uint8_t* buf, std::size_t count);
+
+        void
+        post_poll_event (void);
+
+        // Size of the buffer receiving the bytes discarded
+        // in ping-pong mode.
+        static constexpr std::size_t rx_discard_size = 8;
+
         // Pointer to actual CMSIS-like serial driver (usart or usb cdc acm)
-        os::driver::Serial* driver_ = nullptr;
+        Driver_T* driver_ = nullptr;
 
         os::rtos::semaphore_binary open_sem_ { "open", 0 };
         os::rtos::semaphore_binary rx_sem_  { "rx", 0 };
         os::rtos::semaphore_binary tx_sem_ { "tx", 0 };
 
-        os::dev::ByteCircularBuffer* rx_buf_ = nullptr;
-        os::dev::ByteCircularBuffer* tx_buf_ = nullptr;
+        Buffer_T* rx_buf_ = nullptr;
+        Buffer_T* tx_buf_ = nullptr;
 
         std::size_t rx_count_ = 0; //
+        std::size_t volatile rx_overrun_count_ = 0;
+
+        uint8_t rx_discard_[rx_discard_size];
+        bool volatile rx_discarding_ = false;
+
+        // Receive wake-up conditions, see serial_ioctl::Rx_threshold.
+        std::size_t volatile rx_threshold_ = 1;
+        os::rtos::clock::duration_t volatile rx_gap_timeout_ = 0;
+        // Number of bytes the current reader waits for.
+        std::size_t volatile rx_wakeup_count_ = 1;
+        // Set by the rx_timeout event, cleared by read().
+        bool volatile rx_idle_ = false;
+        Rx_mode rx_mode_ = Rx_mode::continuous;
+        // The length of the driver receive, 0 when discarding.
+        std::size_t volatile rx_window_ = 0;
+
+        // See set_rx_tap(); the stream position of the next byte of
+        // the tap.
+        Rx_tap_policy rx_tap_ = Rx_tap_policy::none;
+        uint32_t volatile rx_tap_pos_ = 0;
+        std::size_t volatile rx_tap_drops_ = 0;
+
+        // The stream positions, as the number of bytes added to and
+        // removed from the receive buffer since open().
+        uint32_t volatile rx_total_ = 0;
+        uint32_t volatile rx_read_total_ = 0;
+
+        // The receive stamps ring, written by the ISR; the indices are
+        // free running, the oldest stamp is at front.
+        Serial_rx_stamp* rx_stamps_ = nullptr;
+        std::size_t rx_stamps_size_ = 0;
+        uint32_t volatile rx_stamps_front_ = 0;
+        uint32_t volatile rx_stamps_back_ = 0;
+
+        static constexpr std::size_t rx_frames_size =
+            OS_INTEGER_POSIX_DRIVERS_SERIAL_RX_FRAMES;
+        static_assert((rx_frames_size & (rx_frames_size - 1)) == 0,
+            "OS_INTEGER_POSIX_DRIVERS_SERIAL_RX_FRAMES must be a power of 2");
+
+        // See serial_ioctl::Rx_framing.
+        int rx_framing_ = serial_ioctl::framing_none;
+        uint8_t rx_delimiter_ = '\n';
+        // The end of frame byte, according to the mode.
+        uint8_t rx_frame_end_char_ = '\n';
+
+        // The stream positions where the pending frames end, written
+        // by the ISR; the indices are free running.
+        uint32_t rx_frame_ends_[rx_frames_size];
+        uint32_t volatile rx_frames_front_ = 0;
+        uint32_t volatile rx_frames_back_ = 0;
+        // The end of the last frame, to not record empty frames at idle.
+        uint32_t rx_frame_last_end_ = 0;
+        std::size_t volatile rx_frame_overruns_ = 0;
+        std::size_t rx_frame_errors_ = 0;
+
+        // The writev() segments not yet sent, when there is no transmit
+        // buffer; they are chained from the ISR.
+        const struct iovec* volatile tx_iov_ = nullptr;
+        int volatile tx_iovcnt_ = 0;
+        std::size_t volatile tx_chain_count_ = 0;
+        bool volatile tx_chain_failed_ = false;
+
+        // The line configuration, see serial_ioctl::Line_config.
+        uint32_t baud_rate_ = 115200;
+        os::driver::serial::config_t line_mode_ =
+            os::driver::serial::MODE_ASYNCHRONOUS
+                | os::driver::serial::DATA_BITS_8
+                | os::driver::serial::PARITY_NONE
+                | os::driver::serial::STOP_BITS_1
+                | os::driver::serial::FLOW_CONTROL_NONE;
+
+        // Flow control, a combination of serial_ioctl::Flow_control bits.
+        int volatile flow_control_ = serial_ioctl::flow_none;
+        // The peer was asked to stop sending.
+        bool volatile rx_throttled_ = false;
+        // The transmission is paused by CTS inactive or by XOFF.
+        bool volatile tx_cts_paused_ = false;
+        bool volatile tx_xoff_paused_ = false;
+        // The XON/XOFF to be sent ahead of the buffer, 0 if none.
+        uint8_t volatile tx_flow_char_ = 0;
+        bool volatile tx_flow_sending_ = false;
+        uint8_t tx_flow_buf_[1];
+
+        // The segments of the wrapped transmit buffer, sent with
+        // send_chain().
+        struct iovec tx_segments_[2];
+        // The driver get_send_segments_max(), read at open().
+        std::size_t tx_segments_max_ = 0;
+
+        // See serial_ioctl::Timeouts.
+        os::rtos::clock::duration_t rx_timeout_ = 0;
+        os::rtos::clock::duration_t tx_timeout_ = 0;
+
+        Serial_poll_event* volatile poll_event_ = nullptr;
+
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+        serial_ioctl::Statistics stats_ { };
+#endif
+
+        // The open() file status flags, see fcntl().
+        int status_flags_ = 0;
+        bool volatile is_nonblocking_ = false;
+
+        // See serial_ioctl::Tx_coalesce.
+        std::size_t tx_coalesce_count_ = 0;
+        os::rtos::clock::duration_t tx_flush_timeout_ = 0;
+        os::rtos::timer tx_timer_ { "tx", tx_flush_timer_cb, this };
+        bool volatile tx_timer_armed_ = false;
+
+        // See serial_ioctl::Power_policy.
+        os::rtos::clock::duration_t power_idle_timeout_ = 0;
+        os::rtos::timer power_timer_
+          { "pwr", power_timer_cb, this,
+              os::rtos::timer::periodic_initializer };
+        // Set by the activity, cleared by the timer.
+        bool volatile power_activity_ = false;
+        bool volatile power_low_ = false;
+
+        // See set_event_dispatch(); the events recorded by the ISR
+        // and not yet processed.
+        Event_dispatch event_dispatch_ = Event_dispatch::isr;
+        uint32_t immediate_events_ = 0;
+        Event_notify event_notify_ = nullptr;
+        void* event_notify_arg_ = nullptr;
+        uint32_t volatile pending_events_ = 0;
+
+        // Set while the transmission from the buffer is in progress;
+        // the thread starts the chain only when clear, otherwise the
+        // ISR continues it.
         bool volatile tx_busy_ = false;
         bool volatile is_connected_ = false;
         bool volatile is_opened_ = false;
         // Padding!
 
+        // See serial-bridge.h; where the received bytes go, and where
+        // the transmitted ones come from.
+        Serial_bridgeable* volatile bridge_sink_ = nullptr;
+        Serial_bridgeable* volatile bridge_source_ = nullptr;
+        // Set while bridge_pull() forwards, and when it is called again
+        // meanwhile.
+        bool volatile bridge_pulling_ = false;
+        bool volatile bridge_pull_again_ = false;
       };
 
 #pragma GCC diagnostic pop
 
     // ------------------------------------------------------------------------
 
-    template<typename Cs_T>
-      Buffered_serial_device<Cs_T>::Buffered_serial_device (
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::Buffered_serial_device (
           const char* deviceName, //
-          os::driver::Serial* driver,
-          os::dev::ByteCircularBuffer* rx_buf,
-          os::dev::ByteCircularBuffer* tx_buf) :
+          Driver_T* driver, Buffer_T* rx_buf, Buffer_T* tx_buf) :
           //
           CharDevice (deviceName), // Construct parent.
           driver_ (driver), //
@@ -166,8 +935,8 @@ namespace os
             this);
       }
 
-    template<typename Cs_T>
-      Buffered_serial_device<Cs_T>::~Buffered_serial_device ()
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::~Buffered_serial_device ()
       {
         driver_ = nullptr;
         is_connected_ = false;
@@ -179,9 +948,9 @@ namespace os
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 
-    template<typename Cs_T>
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
       int
-      Buffered_serial_device<Cs_T>::do_vopen (const char* path, int oflag,
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::do_vopen (const char* path, int oflag,
                                               std::va_list args)
       {
         if (is_opened_)
@@ -190,6 +959,24 @@ namespace os
             return -1;
           }
 
+        if (oflag & serial_ioctl::oflag_line_config)
+          {
+            const serial_ioctl::Line_config* p =
+                va_arg(args, const serial_ioctl::Line_config*);
+            if ((p == nullptr) || !is_valid_flow_control (p->flow_control))
+              {
+                errno = EINVAL;
+                return -1;
+              }
+
+            baud_rate_ = p->baud_rate;
+            line_mode_ = p->mode;
+            flow_control_ = p->flow_control;
+          }
+
+        status_flags_ = oflag & ~serial_ioctl::oflag_line_config;
+        is_nonblocking_ = ((oflag & O_NONBLOCK) != 0);
+
         int32_t result;
 
         do
@@ -204,21 +991,43 @@ namespace os
             // Clear buffers.
             rx_buf_->clear ();
             rx_count_ = 0;
+            rx_overrun_count_ = 0;
+            rx_idle_ = false;
+            rx_throttled_ = false;
+            rx_total_ = 0;
+            rx_read_total_ = 0;
+            rx_window_ = 0;
+            rx_tap_pos_ = 0;
+            rx_tap_drops_ = 0;
+            rx_stamps_front_ = 0;
+            rx_stamps_back_ = 0;
+            rx_frames_front_ = 0;
+            rx_frames_back_ = 0;
+            rx_frame_last_end_ = 0;
+            rx_frame_overruns_ = 0;
+            rx_frame_errors_ = 0;
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+            stats_ = serial_ioctl::Statistics ();
+#endif
 
             if (tx_buf_ != nullptr)
               {
                 tx_buf_->clear ();
               }
+            tx_busy_ = false;
+            tx_cts_paused_ = false;
+            tx_xoff_paused_ = false;
+            tx_flow_char_ = 0;
+            tx_flow_sending_ = false;
+            tx_segments_max_ = Serial_send_chain<Driver_T>::get_segments_max (
+                *driver_);
+            power_activity_ = false;
+            power_low_ = false;
+            pending_events_ = 0;
 
-            // Default configuration: 8 bits, no parity, 1 stop bit,
+            // By default 8 bits, no parity, 1 stop bit,
             // no flow control, 115200 bps.
-            result = driver_->configure (
-                os::driver::serial::MODE_ASYNCHRONOUS
-                    | os::driver::serial::DATA_BITS_8
-                    | os::driver::serial::PARITY_NONE
-                    | os::driver::serial::STOP_BITS_1
-                    | os::driver::serial::FLOW_CONTROL_NONE,
-                115200);
+            result = driver_->configure (line_mode_, baud_rate_);
             // assert(result == os::driver::RETURN_OK);
             if (result != os::driver::RETURN_OK)
               break;
@@ -235,6 +1044,21 @@ namespace os
             if (result != os::driver::RETURN_OK)
               break;
 
+            if (flow_control_ & serial_ioctl::flow_rts)
+              {
+                // Allow the peer to send.
+                result = driver_->control_modem_line (
+                    os::driver::serial::Modem_control::activate_rts);
+                if (result != os::driver::RETURN_OK)
+                  break;
+              }
+
+            if (flow_control_ & serial_ioctl::flow_cts)
+              {
+                os::driver::serial::Modem_status status;
+                status = driver_->get_modem_status ();
+                tx_cts_paused_ = !status.is_cts_active ();
+              }
           }
         while (false); // Actually NOT a loop, just a sequence of ifs!
 
@@ -244,6 +1068,7 @@ namespace os
             return -1;
           }
 
+        bool is_dcd_active = true;
         os::driver::serial::Capabilities capa;
         capa = driver_->get_capabilities ();
         if (capa.dcd)
@@ -256,66 +1081,78 @@ namespace os
 
                     status = driver_->get_modem_status ();
                   }
-                if (status.is_dcd_active ())
+                is_dcd_active = status.is_dcd_active ();
+                if (is_dcd_active || is_nonblocking_)
                   {
+                    // With O_NONBLOCK, do not wait for the carrier.
                     break;
                   }
                 open_sem_.wait();
               }
           }
 
-        uint8_t* pbuf;
-        std::size_t nbyte = rx_buf_->getBackContiguousBuffer (&pbuf);
-
-        result = driver_->receive (pbuf, nbyte);
+        result = start_receive ();
         if (result != os::driver::RETURN_OK)
           {
             errno = EIO;
             return -1;
           }
 
-        is_connected_ = true;
+        is_connected_ = is_dcd_active;
+
+        if (power_idle_timeout_ > 0)
+          {
+            power_timer_.start (power_idle_timeout_);
+          }
 
         // Return POSIX idea of OK.
         return 0;
       }
 
-    template<typename Cs_T>
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
       bool
-      Buffered_serial_device<Cs_T>::do_is_opened (void)
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::do_is_opened (void)
       {
         return is_opened_;
       }
 
-    template<typename Cs_T>
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
       bool
-      Buffered_serial_device<Cs_T>::do_is_connected (void)
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::do_is_connected (void)
       {
         return is_connected_;
       }
 
-    template<typename Cs_T>
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
       int
-      Buffered_serial_device<Cs_T>::do_close (void)
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::do_close (void)
       {
+        // Drain and stop at full power.
+        power_timer_.stop ();
+        power_wake ();
+
+        // Stop the bridges first, nothing must come in while draining.
+        if (bridge_sink_ != nullptr)
+          {
+            set_bridge_sink (nullptr);
+          }
+        Serial_bridgeable* source = bridge_source_;
+        if (source != nullptr)
+          {
+            source->set_bridge_sink (nullptr);
+          }
 
         if (is_connected_)
           {
-            // Wait for write to complete.
-            // TODO: what if flow control prevents this?
-            if (tx_buf_ != nullptr)
-              {
-                for (;;)
-                  {
-                    if (tx_buf_->isEmpty ())
-                      {
-                        break;
-                      }
-                    tx_sem_.wait();
-                  }
-              }
+            // Wait for write to complete, including the bytes held
+            // for coalescing; at most the transmit timeout at a time,
+            // if flow control holds them, and not with O_NONBLOCK.
+            drain ();
           }
 
+        tx_timer_.stop ();
+        tx_timer_armed_ = false;
+
         // Abort pending reads.
         os::driver::return_t ret;
         ret = driver_->control (
@@ -339,26 +1176,119 @@ namespace os
         is_opened_ = false;
         is_connected_ = false;
 
+          {
+            Buffer_critical_section cs; // -----
+
+            // The ISR ignores the events now; with pooled buffers,
+            // this returns the blocks to the pool.
+            rx_buf_->clear ();
+            if (tx_buf_ != nullptr)
+              {
+                tx_buf_->clear ();
+              }
+          }
+
         // Return POSIX idea of OK.
         return 0;
       }
 
-    template<typename Cs_T>
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::do_read (void* buf, std::size_t nbyte)
+      {
+        return rx_read (buf, nbyte, nullptr);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::read_checksum (void* buf,
+                                                             std::size_t nbyte,
+                                                             Checksum& sum)
+      {
+        return rx_read (buf, nbyte, &sum);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
       ssize_t
-      Buffered_serial_device<Cs_T>::do_read (void* buf, std::size_t nbyte)
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_read (void* buf,
+                                                       std::size_t nbyte,
+                                                       Checksum* sum)
       {
-        // TODO: implement cases when 0 must be returned
-        // (disconnects, timeouts).
+        if (rx_framing_ != serial_ioctl::framing_none)
+          {
+            ssize_t ret = rx_read_frame (buf, nbyte);
+            if ((ret > 0) && (sum != nullptr))
+              {
+                // Decoded into the user buffer, not copied.
+                sum->update (static_cast<uint8_t*> (buf), ret);
+              }
+            return ret;
+          }
+
+        // Do not wait for more bytes than requested.
+        std::size_t min_count = rx_threshold_;
+        if (min_count > nbyte)
+          {
+            min_count = nbyte;
+          }
+        rx_wakeup_count_ = min_count;
+
+        bool is_gap = false;
         while (true)
           {
-            std::size_t count;
+            dispatch_events ();
+
+            std::size_t available;
               {
-                Critical_section cs; // -----
+                Buffer_critical_section cs; // -----
 
-                count = rx_buf_->popFront (static_cast<uint8_t*> (buf), nbyte);
+                available = rx_buf_->length ();
               }
-            if (count > 0)
+            if ((available > 0)
+                && ((available >= min_count) || is_gap || rx_idle_
+                    || !is_connected_ || is_nonblocking_))
               {
+                // With XON/XOFF, the checksum is computed after the
+                // flow characters are removed.
+                bool is_xon_xoff = ((flow_control_
+                    & serial_ioctl::flow_xon_xoff) != 0);
+                std::size_t count;
+                  {
+                    Buffer_critical_section cs; // -----
+
+                    if ((sum != nullptr) && !is_xon_xoff)
+                      {
+                        count = rx_buf_->popFront (
+                            static_cast<uint8_t*> (buf), nbyte, *sum);
+                      }
+                    else
+                      {
+                        count = rx_buf_->popFront (
+                            static_cast<uint8_t*> (buf), nbyte);
+                      }
+                  }
+                rx_read_total_ = rx_read_total_ + count;
+                rx_idle_ = false;
+                rx_check_unthrottle ();
+                rx_check_rearm ();
+
+                if (is_xon_xoff)
+                  {
+                    count = rx_strip_flow_chars (static_cast<uint8_t*> (buf),
+                                                 count);
+                    if (count == 0)
+                      {
+                        // Only XON/XOFF, do not return 0 (EOF).
+                        continue;
+                      }
+                    if (sum != nullptr)
+                      {
+                        sum->update (static_cast<uint8_t*> (buf), count);
+                      }
+                  }
+
+                OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::read_return, count);
+
                 // Actual number of chars received in buffer.
                 return count;
               }
@@ -367,61 +1297,98 @@ namespace os
                 errno = EIO;
                 return -1;
               }
-            // Block and wait for bytes to arrive.
-            rx_sem_.wait();
-          }
-      }
 
-    template<typename Cs_T>
-      ssize_t
-      Buffered_serial_device<Cs_T>::do_write (const void* buf,
-                                              std::size_t nbyte)
-      {
-        std::size_t count;
+            if ((available > 0) && (rx_gap_timeout_ > 0))
+              {
+                // Some bytes already arrived; wait for more, but
+                // not longer than the gap timeout, nor than the read
+                // timeout, which returns the bytes already received.
+                bool is_rx_timeout = (rx_timeout_ > 0)
+                    && (rx_timeout_ < rx_gap_timeout_);
+                int err = wait_sem (
+                    rx_sem_, is_rx_timeout ? rx_timeout_ : rx_gap_timeout_);
+                if (err == ETIMEDOUT)
+                  {
+                    Buffer_critical_section cs; // -----
+
+                    // No new bytes in the meantime, the gap expired.
+                    is_gap = is_rx_timeout
+                        || (rx_buf_->length () == available);
+                  }
+              }
+            else
+              {
+                // Block and wait for bytes to arrive.
+                int err = wait_sem (rx_sem_, rx_timeout_);
+                if (err != 0)
+                  {
+                    errno = err;
+                    return -1;
+                  }
+              }
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::do_write (const void* buf,
+                                              std::size_t nbyte)
+      {
+        return tx_write (buf, nbyte, nullptr);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::write_checksum (
+          const void* buf, std::size_t nbyte, Checksum& sum)
+      {
+        return tx_write (buf, nbyte, &sum);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      inline std::size_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::tx_push (const uint8_t* buf,
+                                                       std::size_t nbyte,
+                                                       Checksum* sum)
+      {
+        if (sum != nullptr)
+          {
+            return tx_buf_->pushBack (buf, nbyte, *sum);
+          }
+        return tx_buf_->pushBack (buf, nbyte);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::tx_write (const void* buf,
+                                                        std::size_t nbyte,
+                                                        Checksum* sum)
+      {
+        power_wake ();
+
+        std::size_t count;
 
         if (tx_buf_ != nullptr)
           {
             count = 0;
               {
-                Critical_section cs; // -----
+                Buffer_critical_section cs; // -----
 
                 if (tx_buf_->isBelowHighWaterMark ())
                   {
                     // If there is more space in the buffer, try to fill it.
-                    count = tx_buf_->pushBack (
-                        static_cast<const uint8_t*> (buf), nbyte);
+                    count = tx_push (static_cast<const uint8_t*> (buf), nbyte,
+                                     sum);
                   }
               }
             while (true)
               {
-                os::driver::serial::Status status;
-                  {
-                    Critical_section cs; // -----
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Waggregate-return"
-                    status = driver_->get_status ();
-#pragma GCC diagnostic pop
+                dispatch_events ();
 
-                  }
-                if (!status.tx_busy)
+                if (start_send () != os::driver::RETURN_OK)
                   {
-                    uint8_t* pbuf;
-                    std::size_t nb;
-                      {
-                        Critical_section cs; // -----
-
-                        nb = tx_buf_->getFrontContiguousBuffer (&pbuf);
-                      }
-                    if (nb > 0)
-                      {
-                        if (driver_->send (pbuf, nb)
-                            != os::driver::RETURN_OK)
-                          {
-                            errno = EIO;
-                            return -1;
-                          }
-                      }
+                    errno = EIO;
+                    return -1;
                   }
 
 //                bool isBelowHWM;
@@ -447,17 +1414,26 @@ namespace os
                   }
 
                 // Block and wait for buffer to be freed.
-                tx_sem_.wait();
+                int err = wait_sem (tx_sem_, tx_timeout_);
+                if (err != 0)
+                  {
+                    if (count > 0)
+                      {
+                        return count;
+                      }
+
+                    errno = err;
+                    return -1;
+                  }
 
                 if (count < nbyte)
                   {
-                    Critical_section cs;  // -----
+                    Buffer_critical_section cs;  // -----
 
                     std::size_t n;
                     // If there is more space in the buffer, try to fill it.
-                    n = tx_buf_->pushBack (
-                        static_cast<const uint8_t*> (buf) + count,
-                        nbyte - count);
+                    n = tx_push (static_cast<const uint8_t*> (buf) + count,
+                                 nbyte - count, sum);
                     count += n;
                   }
               }
@@ -469,6 +1445,8 @@ namespace os
             os::driver::serial::Status status;
             for (;;)
               {
+                dispatch_events ();
+
                 if (!is_connected_)
                   {
                     errno = EIO;
@@ -480,15 +1458,27 @@ namespace os
                   {
                     break;
                   }
-                tx_sem_.wait();
+                int err = wait_sem (tx_sem_, tx_timeout_);
+                if (err != 0)
+                  {
+                    errno = err;
+                    return -1;
+                  }
               }
 
+            // Once started, always wait for the transmission to
+            // complete, the user buffer is in use.
+
+            OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::send, nbyte);
             if ((driver_->send (buf, nbyte)) == os::driver::RETURN_OK)
               {
                 for (;;)
                   {
+                    dispatch_events ();
+
                     if (!is_connected_)
                       {
+                        tx_abort_direct ();
                         errno = EIO;
                         return -1;
                       }
@@ -498,9 +1488,25 @@ namespace os
                       {
                         break;
                       }
-                     tx_sem_.wait();
+                    int err = wait_sem (tx_sem_, tx_timeout_, false);
+                    if (err != 0)
+                      {
+                        // Timeout; return the bytes sent until now.
+                        tx_abort_direct ();
+                        if (driver_->get_tx_count () == 0)
+                          {
+                            errno = err;
+                            return -1;
+                          }
+                        break;
+                      }
                   }
                 count = driver_->get_tx_count ();
+                if (sum != nullptr)
+                  {
+                    // Sent from the user buffer, not copied.
+                    sum->update (static_cast<const uint8_t*> (buf), count);
+                  }
               }
             else
               {
@@ -513,146 +1519,2623 @@ namespace os
         return count;
       }
 
-#if 0
-    template<typename Cs_T>
-    ssize_t
-    Buffered_serial_device<Cs_T>::do_writev (const struct iovec* iov, int iovcnt)
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      os::driver::return_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::start_send (bool flush)
       {
-        errno = ENOSYS; // Not implemented
-        return -1;
+        power_wake ();
+
+        if (tx_busy_)
+          {
+            // The ISR owns the transmission; the bytes already in the
+            // buffer are sent when the current transfer completes.
+            return os::driver::RETURN_OK;
+          }
+
+        if (!flush && (tx_coalesce_count_ > 1) && (tx_flow_char_ == 0))
+          {
+            bool is_enough;
+              {
+                Buffer_critical_section cs; // -----
+
+                is_enough = (tx_buf_->length () >= tx_coalesce_count_)
+                    || tx_buf_->isAboveHighWaterMark ();
+              }
+            if (!is_enough)
+              {
+                // Hold the bytes, until more are written or
+                // the timer expires.
+                if (!tx_timer_armed_ && (tx_flush_timeout_ > 0))
+                  {
+                    tx_timer_armed_ = true;
+                    tx_timer_.start (tx_flush_timeout_);
+                  }
+                return os::driver::RETURN_OK;
+              }
+          }
+
+        Critical_section cs; // -----
+
+        if (tx_busy_)
+          {
+            // Restarted by the ISR in the meantime.
+            return os::driver::RETURN_OK;
+          }
+        return send_next ();
       }
 
-    template<typename Cs_T>
-    int
-    Buffered_serial_device<Cs_T>::do_vioctl (int request, std::va_list args)
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::tx_flush_timer_cb (
+          os::rtos::timer::func_args_t args)
       {
-        errno = ENOSYS; // Not implemented
-        return -1;
+        Buffered_serial_device* object =
+            static_cast<Buffered_serial_device*> (args);
+
+        object->dispatch_events ();
+
+        object->tx_timer_armed_ = false;
+        if (object->is_opened_
+            && (object->start_send (true) != os::driver::RETURN_OK))
+          {
+            object->tx_error ();
+          }
       }
 
-    template<typename Cs_T>
-    int
-    Buffered_serial_device<Cs_T>::do_vfcntl (int cmd, std::va_list args)
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::power_timer_cb (
+          os::rtos::timer::func_args_t args)
       {
-        errno = ENOSYS; // Not implemented
-        return -1;
-      }
-#endif
+        Buffered_serial_device* object =
+            static_cast<Buffered_serial_device*> (args);
 
-    // ------------------------------------------------------------------------
+        object->dispatch_events ();
+
+        Critical_section cs; // -----
+
+        if (!object->is_opened_ || object->power_low_)
+          {
+            return;
+          }
+        if (object->power_activity_)
+          {
+            // Wait for a full quiet period.
+            object->power_activity_ = false;
+            return;
+          }
+        if (object->tx_busy_ || object->driver_->get_status ().is_tx_busy ()
+            || ((object->tx_buf_ != nullptr) && !object->tx_buf_->isEmpty ()))
+          {
+            // Still sending, or holding bytes for coalescing.
+            return;
+          }
 
-    template<typename Cs_T>
+        // The receive stays armed; the driver wakes up on the start bit.
+        if (object->driver_->power (os::driver::Power::low)
+            == os::driver::RETURN_OK)
+          {
+            object->power_low_ = true;
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+            ++object->stats_.power_low_entries;
+#endif
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
       void
-      Buffered_serial_device<Cs_T>::signal_event (
-          Buffered_serial_device* object, uint32_t event)
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::power_wake (void)
       {
-        if (!object->is_opened_)
+        power_activity_ = true;
+        if (!power_low_)
           {
-            // After close(), ignore interrupts.
             return;
           }
-        if ((event
-            & (os::driver::serial::Event::receive_complete
-                | os::driver::serial::Event::rx_framing_error
-                | os::driver::serial::Event::rx_timeout)))
+
+        Critical_section cs; // -----
+
+        if (!power_low_)
+          {
+            // Woken up by the ISR in the meantime.
+            return;
+          }
+
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+        uint32_t begin_cycles = OS_POSIX_DRIVERS_SERIAL_CYCLES ();
+#endif
+        if (driver_->power (os::driver::Power::full) != os::driver::RETURN_OK)
+          {
+            // Still at low power, the next access retries.
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+            ++stats_.power_wake_errors;
+#endif
+            return;
+          }
+        power_low_ = false;
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+        uint32_t cycles = OS_POSIX_DRIVERS_SERIAL_CYCLES () - begin_cycles;
+        ++stats_.power_wakeups;
+        if (cycles > stats_.power_wake_max_cycles)
           {
-            // TODO: process errors and timeouts
-            std::size_t tmpCount = object->driver_->get_rx_count ();
-            std::size_t count = tmpCount - object->rx_count_;
-            object->rx_count_ = tmpCount;
-            std::size_t adjust = object->rx_buf_->advanceBack (count);
-            assert(count == adjust);
+            stats_.power_wake_max_cycles = cycles;
+          }
+#endif
+      }
 
-            if (event & os::driver::serial::Event::receive_complete)
-              {
-                uint8_t* pbuf;
-                std::size_t nbyte = object->rx_buf_->getBackContiguousBuffer (
-                    &pbuf);
-                if (nbyte == 0)
-                  {
-                    // Overwrite the last byte, but keep the driver in
-                    // receive mode continuously.
-                    object->rx_buf_->retreatBack ();
-                    nbyte = object->rx_buf_->getBackContiguousBuffer (&pbuf);
-                  }
-                assert(nbyte > 0);
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      std::size_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_account (
+          std::size_t rx_count)
+      {
+        std::size_t count = rx_count - rx_count_;
+        rx_count_ = rx_count;
+        if (rx_discarding_)
+          {
+            // The bytes went to the discard buffer, they are lost.
+            rx_overrun_count_ = rx_overrun_count_ + count;
+            return 0;
+          }
 
-                // Read as much as we can.
-                int32_t status;
-                status = object->driver_->receive (pbuf, nbyte);
-                // TODO: implement error processing.
-                assert(status == os::driver::RETURN_OK);
+        if (flow_control_ & serial_ioctl::flow_xon_xoff)
+          {
+            // The new bytes start at the back.
+            uint8_t* pbuf;
+            rx_buf_->getBackContiguousBuffer (&pbuf);
+            rx_scan_flow_chars (pbuf, count);
+          }
+        if ((rx_framing_ != serial_ioctl::framing_none)
+            && (rx_framing_ != serial_ioctl::framing_idle))
+          {
+            uint8_t* pbuf;
+            rx_buf_->getBackContiguousBuffer (&pbuf);
+            rx_frame_scan (pbuf, count, false);
+          }
 
-                object->rx_count_ = 0;
-              }
-            if (count > 0)
-              {
-                // Immediately wake up, do not wait to reach any water mark.
-                object->rx_sem_.post();
-              }
+        std::size_t adjust = rx_buf_->advanceBack (count);
+        assert(count == adjust);
+        rx_total_ = rx_total_ + count;
+
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+        stats_.rx_bytes += count;
+#endif
+
+        if ((rx_framing_ != serial_ioctl::framing_none)
+            && (rx_frames_front_ == rx_frames_back_) && rx_buf_->isFull ())
+          {
+            // No end of frame in the entire buffer; pass it as a frame,
+            // otherwise the reader would never make progress.
+            rx_frame_push (rx_total_);
           }
-        if (event & os::driver::serial::Event::tx_complete)
+
+        if (flow_control_
+            & (serial_ioctl::flow_rts | serial_ioctl::flow_xon_xoff))
           {
-            if (object->tx_buf_ != nullptr)
-              {
-                std::size_t count = object->driver_->get_tx_count ();
-                std::size_t adjust = object->tx_buf_->advanceFront (count);
-                assert(count == adjust);
+            rx_check_throttle ();
+          }
+        return count;
+      }
 
-                uint8_t* pbuf;
-                std::size_t nbyte = object->tx_buf_->getFrontContiguousBuffer (
-                    &pbuf);
-                if (nbyte > 0)
-                  {
-                    int32_t status;
-                    status = object->driver_->send (pbuf, nbyte);
-                    // TODO: implement error processing
-                    assert(status == os::driver::RETURN_OK);
-                  }
-                else
-                  {
-                    object->tx_busy_ = false;
-                  }
-                if (object->tx_buf_->isBelowLowWaterMark ())
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      os::driver::return_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::send_next (void)
+      {
+        uint8_t* pbuf = nullptr;
+        std::size_t nbyte = 0;
+        if (tx_flow_char_ != 0)
+          {
+            // XON/XOFF go first, even if paused.
+            tx_flow_buf_[0] = tx_flow_char_;
+            tx_flow_char_ = 0;
+            tx_flow_sending_ = true;
+            pbuf = tx_flow_buf_;
+            nbyte = 1;
+          }
+        else if (!is_tx_paused ())
+          {
+            if (tx_segments_max_ >= 2)
+              {
+                uint8_t* pbuf2;
+                std::size_t nbyte2;
+                tx_buf_->peekFront (&pbuf, &nbyte, &pbuf2, &nbyte2);
+                if (nbyte2 > 0)
                   {
-                    // Wake up thread, to come and send more bytes.
-                    object->tx_sem_.post();
+                    // Both segments in one transfer.
+                    tx_segments_[0].iov_base = pbuf;
+                    tx_segments_[0].iov_len = nbyte;
+                    tx_segments_[1].iov_base = pbuf2;
+                    tx_segments_[1].iov_len = nbyte2;
+
+                    tx_busy_ = true;
+                    OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::send,
+                                                  nbyte + nbyte2);
+                    if (send_chain (tx_segments_, 2) == os::driver::RETURN_OK)
+                      {
+                        return os::driver::RETURN_OK;
+                      }
+                    // Not this time, send the first segment.
                   }
               }
             else
               {
-                // No buffer, wake up the thread to return from write().
-                object->tx_sem_.post();
+                nbyte = tx_buf_->getFrontContiguousBuffer (&pbuf);
               }
           }
-        if (event & os::driver::serial::Event::dcd)
-          {
-            os::driver::serial::Modem_status status;
-            status = object->driver_->get_modem_status ();
 
-            bool is_dcd_active = status.is_dcd_active ();
-            object->is_connected_ = is_dcd_active;
-            if (is_dcd_active)
+        if (nbyte == 0)
+          {
+            // The chain is idle, the next write() restarts it.
+            tx_busy_ = false;
+            if (tx_buf_->isEmpty ())
               {
-                // Connected, wake-up open().
-                object->open_sem_.post();
+                // Nothing is sent from the buffer, return its storage.
+                Buffer_trim<Buffer_T::isChained>::trim (*tx_buf_);
               }
-            else
-              {
-                // Disconnected, cancel read.
-                object->rx_sem_.post();
+            return os::driver::RETURN_OK;
+          }
 
-                // Cancel write.
-                object->tx_sem_.post();
+        tx_busy_ = true;
+        OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::send, nbyte);
+        os::driver::return_t status = driver_->send (pbuf, nbyte);
+        if (status != os::driver::RETURN_OK)
+          {
+            tx_busy_ = false;
+          }
+        return status;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      inline os::driver::return_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::send_chain (
+          const struct iovec* iov, int iovcnt)
+      {
+        if ((iovcnt < 2)
+            || (static_cast<std::size_t> (iovcnt) > tx_segments_max_))
+          {
+            return os::driver::ERROR_UNSUPPORTED;
+          }
+        return Serial_send_chain<Driver_T>::send (*driver_, iov, iovcnt);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::update_tx_pause (void)
+      {
+        if (is_tx_paused ())
+          {
+            if (tx_busy_ && !tx_flow_sending_)
+              {
+                // Do not wait for the current transfer to complete,
+                // stop it and keep the unsent bytes in the buffer.
+                driver_->control (os::driver::serial::Control::abort_send);
+                tx_buf_->advanceFront (driver_->get_tx_count ());
+                tx_busy_ = false;
               }
           }
-        if (event & os::driver::serial::Event::cts)
+        else if (!tx_busy_)
+          {
+            // Resume.
+            send_next ();
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::tx_send_flow_char (
+          uint8_t c)
+      {
+        tx_flow_char_ = c;
+        if (tx_busy_ && !tx_flow_sending_ && (tx_buf_ != nullptr)
+            && driver_->get_status ().is_tx_busy ())
+          {
+            // Do not wait for a long transfer from the buffer, the
+            // peer would overrun; stop it, keep the unsent bytes,
+            // they follow the XON/XOFF. If the driver is done, the
+            // pending tx_complete sends it.
+            driver_->control (os::driver::serial::Control::abort_send);
+            tx_buf_->advanceFront (driver_->get_tx_count ());
+            tx_busy_ = false;
+          }
+        if (!tx_busy_)
+          {
+            send_next ();
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      inline bool
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::is_tx_paused (void) const
+      {
+        return tx_cts_paused_ || tx_xoff_paused_;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_check_throttle (void)
+      {
+        if (rx_throttled_ || !rx_buf_->isAboveHighWaterMark ())
+          {
+            return;
+          }
+
+        rx_throttled_ = true;
+        if (flow_control_ & serial_ioctl::flow_rts)
+          {
+            driver_->control_modem_line (
+                os::driver::serial::Modem_control::deactivate_rts);
+          }
+        if (flow_control_ & serial_ioctl::flow_xon_xoff)
+          {
+            tx_send_flow_char (serial_ioctl::xoff);
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_check_unthrottle (void)
+      {
+        if (!rx_throttled_)
+          {
+            return;
+          }
+
+        Critical_section cs; // -----
+
+        if (!rx_throttled_ || !rx_buf_->isBelowLowWaterMark ())
+          {
+            return;
+          }
+
+        rx_throttled_ = false;
+        if (flow_control_ & serial_ioctl::flow_rts)
+          {
+            driver_->control_modem_line (
+                os::driver::serial::Modem_control::activate_rts);
+          }
+        if (flow_control_ & serial_ioctl::flow_xon_xoff)
           {
-            // TODO: add flow control
+            tx_send_flow_char (serial_ioctl::xon);
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_scan_flow_chars (
+          const uint8_t* buf, std::size_t count)
+      {
+        bool paused = tx_xoff_paused_;
+        for (std::size_t i = 0; i < count; ++i)
+          {
+            if (buf[i] == serial_ioctl::xoff)
+              {
+                paused = true;
+              }
+            else if (buf[i] == serial_ioctl::xon)
+              {
+                paused = false;
+              }
+          }
+
+        if (paused != tx_xoff_paused_)
+          {
+            tx_xoff_paused_ = paused;
+            update_tx_pause ();
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      std::size_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_strip_flow_chars (
+          uint8_t* buf, std::size_t count)
+      {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < count; ++i)
+          {
+            if ((buf[i] != serial_ioctl::xon) && (buf[i] != serial_ioctl::xoff))
+              {
+                buf[n++] = buf[i];
+              }
+          }
+        return n;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      std::size_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_arm_space (
+          uint8_t** pbuf)
+      {
+        std::size_t nbyte = rx_buf_->getBackContiguousBuffer (pbuf);
+
+        if (rx_mode_ == Rx_mode::ping_pong)
+          {
+            std::size_t half = rx_buf_->size () / 2;
+            if ((half > 0) && (nbyte > half))
+              {
+                nbyte = half;
+              }
+          }
+        if (rx_tap_ == Rx_tap_policy::stall)
+          {
+            // Do not overwrite the bytes the tap did not see.
+            std::size_t space = rx_buf_->size ()
+                - static_cast<uint32_t> (rx_total_ - rx_tap_pos_);
+            if (nbyte > space)
+              {
+                nbyte = space;
+              }
+          }
+        return nbyte;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_check_rearm (void)
+      {
+        if (!rx_discarding_)
+          {
+            return;
+          }
+
+        Critical_section cs; // -----
+
+        uint8_t* pbuf;
+        if (!rx_discarding_ || !is_opened_ || (rx_arm_space (&pbuf) == 0))
+          {
+            return;
+          }
+
+        // The bytes already in the discard buffer are counted as
+        // overruns; those arriving during the re-arm may be lost.
+        // A driver receives into a single buffer, so the running
+        // receive must be stopped before the new one is started.
+        driver_->control (os::driver::serial::Control::abort_receive);
+        rx_account (driver_->get_rx_count ());
+        rx_count_ = 0;
+        if (start_receive () != os::driver::RETURN_OK)
+          {
+            rx_error ();
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      std::size_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_tap_valid (
+          void) const
+      {
+        std::size_t pending = rx_discarding_ ? 0 : (rx_window_ - rx_count_);
+        return rx_buf_->size () - pending;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_error (void)
+      {
+        rx_discarding_ = true;
+        rx_window_ = 0;
+        rx_count_ = 0;
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+        ++stats_.rx_errors;
+#endif
+        OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::receive,
+                                      sizeof(rx_discard_));
+        // If this fails too, nothing is armed until the reader
+        // retries, via rx_check_rearm().
+        driver_->receive (rx_discard_, sizeof(rx_discard_));
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      os::driver::return_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::start_receive (void)
+      {
+        uint8_t* pbuf;
+        std::size_t nbyte = rx_arm_space (&pbuf);
+        if (nbyte == 0)
+          {
+            nbyte = rx_overwrite_last (
+                &pbuf, std::integral_constant<bool, !Buffer_T::isLockFree> ());
+          }
+
+        if (nbyte == 0)
+          {
+            // No space, do not overwrite; receive into the discard
+            // buffer, those bytes will be counted as overruns.
+            rx_discarding_ = true;
+            rx_window_ = 0;
+            OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::receive,
+                                          sizeof(rx_discard_));
+            return driver_->receive (rx_discard_, sizeof(rx_discard_));
+          }
+
+        rx_discarding_ = false;
+        rx_window_ = nbyte;
+        OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::receive, nbyte);
+        return driver_->receive (pbuf, nbyte);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      std::size_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_overwrite_last (
+          uint8_t** pbuf, std::true_type)
+      {
+        if ((rx_mode_ == Rx_mode::ping_pong)
+            || (rx_tap_ == Rx_tap_policy::stall))
+          {
+            return 0;
+          }
+
+        // Overwrite the last byte, but keep the driver in
+        // receive mode continuously.
+        rx_buf_->retreatBack ();
+        if ((rx_frames_front_ != rx_frames_back_)
+            && (rx_frame_ends_[(rx_frames_back_ - 1) % rx_frames_size]
+                == rx_total_))
+          {
+            // Keep the last frame inside the buffer.
+            rx_frame_ends_[(rx_frames_back_ - 1) % rx_frames_size] =
+                rx_total_ - 1;
+            rx_frame_last_end_ = rx_total_ - 1;
+          }
+        rx_total_ = rx_total_ - 1;
+        rx_overrun_count_ = rx_overrun_count_ + 1;
+        return rx_buf_->getBackContiguousBuffer (pbuf);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      std::size_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_overwrite_last (
+          uint8_t** pbuf __attribute__((unused)), std::false_type)
+      {
+        return 0;
+      }
+
+    // ------------------------------------------------------------------------
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::set_rx_stamps (
+          Serial_rx_stamp* stamps, std::size_t count)
+      {
+        assert(!is_opened_);
+        assert((stamps == nullptr) || (count > 0));
+
+        rx_stamps_ = stamps;
+        rx_stamps_size_ = (stamps != nullptr) ? count : 0;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_stamp (std::size_t count,
+                                                        uint32_t event)
+      {
+        uint32_t flags = event
+            & (os::driver::serial::Event::rx_framing_error
+                | os::driver::serial::Event::rx_parity_error
+                | os::driver::serial::Event::rx_break
+                | os::driver::serial::Event::rx_overflow
+                | os::driver::serial::Event::rx_timeout);
+        if ((count == 0) && (flags == 0))
+          {
+            return;
+          }
+
+        uint32_t back = rx_stamps_back_;
+        Serial_rx_stamp& stamp = rx_stamps_[back % rx_stamps_size_];
+        stamp.end = rx_total_;
+        stamp.flags = flags;
+        stamp.timestamp = OS_POSIX_DRIVERS_SERIAL_RX_TIMESTAMP ();
+
+        rx_stamps_back_ = back + 1;
+        if ((back + 1 - rx_stamps_front_) > rx_stamps_size_)
+          {
+            // Full, the oldest stamp was overwritten.
+            rx_stamps_front_ = back + 1 - rx_stamps_size_;
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::set_rx_mode (Rx_mode mode)
+      {
+        assert(!is_opened_);
+
+        rx_mode_ = mode;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      typename Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::Rx_mode
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::get_rx_mode (void) const
+      {
+        return rx_mode_;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      std::size_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::get_rx_overrun_count (
+          void) const
+      {
+        return rx_overrun_count_;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::set_event_dispatch (
+          Event_dispatch mode, uint32_t immediate_events, Event_notify notify,
+          void* notify_arg)
+      {
+        assert(!is_opened_);
+
+        event_dispatch_ = mode;
+        immediate_events_ = immediate_events;
+        if ((mode == Event_dispatch::deferred) && (notify == nullptr))
+          {
+            // Nobody may dispatch them, do not stall the transfers.
+            immediate_events_ |= os::driver::serial::Event::receive_complete
+                | os::driver::serial::Event::tx_complete
+                | os::driver::serial::Event::cts;
+          }
+        event_notify_ = notify;
+        event_notify_arg_ = notify_arg;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::set_rx_tap (
+          Rx_tap_policy policy)
+      {
+        assert(!is_opened_);
+        // The pooled buffers keep no history.
+        assert(!Buffer_T::isChained || (policy == Rx_tap_policy::none));
+
+        rx_tap_ = policy;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_tap_read (
+          void* buf, std::size_t nbyte)
+      {
+        if (rx_tap_ == Rx_tap_policy::none)
+          {
+            errno = EINVAL;
+            return -1;
+          }
+        if (!is_opened_)
+          {
+            errno = EBADF;
+            return -1;
+          }
+
+        uint32_t pos;
+        const uint8_t* pbuf1;
+        std::size_t len1;
+        const uint8_t* pbuf2;
+        std::size_t len2;
+          {
+            Critical_section cs; // -----
+
+            pos = rx_tap_pos_;
+            if (static_cast<int32_t> (rx_total_ - pos) < 0)
+              {
+                // The buffer was full, the last byte was overwritten.
+                pos = rx_total_;
+              }
+            std::size_t distance = rx_total_ - pos;
+            std::size_t valid = rx_tap_valid ();
+            if (distance > valid)
+              {
+                rx_tap_drops_ = rx_tap_drops_ + (distance - valid);
+                pos += static_cast<uint32_t> (distance - valid);
+                distance = valid;
+              }
+
+            rx_buf_->peekBeforeBack (distance, nbyte, &pbuf1, &len1, &pbuf2,
+                                     &len2);
+          }
+
+        // Copy with the interrupts enabled; the driver may overwrite
+        // the oldest bytes meanwhile, they are checked below.
+        uint8_t* p = static_cast<uint8_t*> (buf);
+        std::memcpy (p, pbuf1, len1);
+        std::memcpy (p + len1, pbuf2, len2);
+        std::size_t count = len1 + len2;
+
+        std::size_t lost;
+          {
+            Critical_section cs; // -----
+
+            // The stream position of the oldest byte still valid.
+            uint32_t low = rx_total_ - static_cast<uint32_t> (rx_tap_valid ());
+            int32_t behind = static_cast<int32_t> (low - pos);
+            lost = (behind > 0) ? static_cast<std::size_t> (behind) : 0;
+            if (lost > count)
+              {
+                lost = count;
+              }
+            rx_tap_drops_ = rx_tap_drops_ + lost;
+            rx_tap_pos_ = pos + static_cast<uint32_t> (count);
+          }
+        if (lost > 0)
+          {
+            std::memmove (p, p + lost, count - lost);
+            count -= lost;
+          }
+
+        if (rx_tap_ == Rx_tap_policy::stall)
+          {
+            // The reception may have been held for the tap.
+            rx_check_rearm ();
+          }
+        return static_cast<ssize_t> (count);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      std::size_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::get_rx_tap_drop_count (
+          void) const
+      {
+        return rx_tap_drops_;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::set_poll_event (
+          Serial_poll_event* event)
+      {
+        Critical_section cs; // -----
+
+        poll_event_ = event;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      int
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::set_bridge_sink (
+          Serial_bridgeable* sink)
+      {
+        if (sink == bridge_sink_)
+          {
+            return 0;
+          }
+        if (sink != nullptr)
+          {
+            if (!is_opened_)
+              {
+                errno = EBADF;
+                return -1;
+              }
+            if ((sink == this) || (rx_framing_ != serial_ioctl::framing_none))
+              {
+                errno = EINVAL;
+                return -1;
+              }
+          }
+
+        Serial_bridgeable* old = bridge_sink_;
+        if (old != nullptr)
+          {
+              {
+                Critical_section cs; // -----
+
+                bridge_sink_ = nullptr;
+              }
+            old->set_bridge_source (nullptr);
+          }
+        if (sink == nullptr)
+          {
+            return 0;
+          }
+
+        if (sink->set_bridge_source (this) != 0)
+          {
+            return -1;
+          }
+          {
+            Critical_section cs; // -----
+
+            bridge_sink_ = sink;
+          }
+
+        // Forward the bytes already received.
+        bridge_pull ();
+        return 0;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      int
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::set_bridge_source (
+          Serial_bridgeable* source)
+      {
+        if (source != nullptr)
+          {
+            if (!is_opened_)
+              {
+                errno = EBADF;
+                return -1;
+              }
+            if ((tx_buf_ == nullptr) || (bridge_source_ != nullptr))
+              {
+                errno = EINVAL;
+                return -1;
+              }
+          }
+
+        Critical_section cs; // -----
+
+        bridge_source_ = source;
+        return 0;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::tx_error (void)
+      {
+          {
+            Critical_section cs; // -----
+
+            tx_busy_ = false;
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+            ++stats_.tx_errors;
+#endif
+          }
+
+        OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::tx_post, 0);
+        tx_sem_.post();
+        post_poll_event ();
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      std::size_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::bridge_push (
+          const uint8_t* buf, std::size_t nbyte)
+      {
+        if (!is_opened_ || (tx_buf_ == nullptr))
+          {
+            return 0;
+          }
+
+        std::size_t count;
+          {
+            Buffer_critical_section cs; // -----
+
+            count = tx_buf_->pushBack (buf, nbyte);
+          }
+        // Not held for coalescing, the source does not wait; also
+        // when full, to retry a transfer refused by the driver, the
+        // bytes stayed queued.
+        if (start_send (true) != os::driver::RETURN_OK)
+          {
+            tx_error ();
+          }
+        return count;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::bridge_pull (void)
+      {
+        // Also called from the ISR of the sink, possibly at a different
+        // priority; for the order, only one call forwards at a time,
+        // and a call that finds it busy asks it to look again before
+        // it ends. The interrupts are disabled only to claim it and for
+        // the buffer accesses, not while the sink starts sending.
+          {
+            Critical_section cs; // -----
+
+            if (bridge_pulling_)
+              {
+                bridge_pull_again_ = true;
+                return;
+              }
+            bridge_pulling_ = true;
+            bridge_pull_again_ = false;
+          }
+
+        for (;;)
+          {
+            Serial_bridgeable* sink = bridge_sink_;
+            uint8_t* pbuf = nullptr;
+            std::size_t nbyte = 0;
+            if ((sink != nullptr) && is_opened_)
+              {
+                Buffer_critical_section bcs; // -----
+
+                nbyte = rx_buf_->getFrontContiguousBuffer (&pbuf);
+              }
+
+            std::size_t count = 0;
+            if (nbyte > 0)
+              {
+                count = sink->bridge_push (pbuf, nbyte);
+                if (count > 0)
+                  {
+                    // Also releases the flow control.
+                    rx_consume (count);
+                  }
+              }
+            if ((nbyte > 0) && (count == nbyte))
+              {
+                // The rest, if wrapped.
+                continue;
+              }
+
+            // Nothing left, or the sink is full and pulls the rest
+            // later; unless asked meanwhile to look again.
+            Critical_section cs; // -----
+
+            if (!bridge_pull_again_)
+              {
+                bridge_pulling_ = false;
+                return;
+              }
+            bridge_pull_again_ = false;
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      unsigned int
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::get_poll_events (void)
+      {
+        if (!is_opened_)
+          {
+            return 0;
+          }
+        dispatch_events ();
+        if (!is_connected_)
+          {
+            return serial_poll::hangup;
+          }
+
+        unsigned int events = 0;
+          {
+            Buffer_critical_section cs; // -----
+
+            std::size_t len = rx_buf_->length ();
+            if (rx_framing_ != serial_ioctl::framing_none)
+              {
+                if (rx_frames_front_ != rx_frames_back_)
+                  {
+                    events |= serial_poll::in;
+                  }
+              }
+            else if ((len >= rx_threshold_) || ((len > 0) && rx_idle_))
+              {
+                events |= serial_poll::in;
+              }
+            if (tx_buf_ != nullptr)
+              {
+                if (tx_buf_->isBelowHighWaterMark ())
+                  {
+                    events |= serial_poll::out;
+                  }
+              }
+          }
+        if (tx_buf_ == nullptr)
+          {
+            os::driver::serial::Status status;
+              {
+                Critical_section cs; // -----
+
+                status = driver_->get_status ();
+              }
+            if (!status.is_tx_busy ())
+              {
+                events |= serial_poll::out;
+              }
+          }
+        return events;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      inline void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::post_poll_event (void)
+      {
+        Serial_poll_event* event = poll_event_;
+        if (event != nullptr)
+          {
+            event->post ();
+          }
+      }
+
+    // ------------------------------------------------------------------------
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_peek (uint8_t** ppbuf1,
+                                                       std::size_t* plen1,
+                                                       uint8_t** ppbuf2,
+                                                       std::size_t* plen2)
+      {
+        // Any number of bytes is fine.
+        rx_wakeup_count_ = 1;
+
+        while (true)
+          {
+            dispatch_events ();
+
+            std::size_t count;
+              {
+                Buffer_critical_section cs; // -----
+
+                count = rx_buf_->peekFront (ppbuf1, plen1, ppbuf2, plen2);
+              }
+            if (count > 0)
+              {
+                return count;
+              }
+            if (!is_connected_)
+              {
+                errno = EIO;
+                return -1;
+              }
+            // Block and wait for bytes to arrive.
+            int err = wait_sem (rx_sem_, rx_timeout_);
+            if (err != 0)
+              {
+                errno = err;
+                return -1;
+              }
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      std::size_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_consume (std::size_t nbyte)
+      {
+        std::size_t count;
+          {
+            Buffer_critical_section cs; // -----
+
+            count = rx_buf_->advanceFront (nbyte);
+          }
+        rx_read_total_ = rx_read_total_ + count;
+        rx_check_unthrottle ();
+        rx_check_rearm ();
+
+        return count;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_frame_scan (
+          const uint8_t* buf, std::size_t count, bool is_idle)
+      {
+        if (is_idle)
+          {
+            if (rx_total_ != rx_frame_last_end_)
+              {
+                rx_frame_push (rx_total_);
+              }
+            return;
+          }
+
+        // The new bytes begin at the current stream position.
+        const uint8_t* p = buf;
+        const uint8_t* end = buf + count;
+        while (p < end)
+          {
+            const uint8_t* q = find_byte (
+                p, static_cast<std::size_t> (end - p), rx_frame_end_char_);
+            if (q == nullptr)
+              {
+                break;
+              }
+            rx_frame_push (
+                rx_total_ + static_cast<uint32_t> (q - buf) + 1);
+            p = q + 1;
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_frame_push (uint32_t end)
+      {
+        uint32_t back = rx_frames_back_;
+        if ((back - rx_frames_front_) >= rx_frames_size)
+          {
+            // Full, this frame merges with the next one.
+            rx_frame_overruns_ = rx_frame_overruns_ + 1;
+            return;
+          }
+        rx_frame_ends_[back % rx_frames_size] = end;
+        rx_frames_back_ = back + 1;
+        rx_frame_last_end_ = end;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      int
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_frame_wait (uint32_t* pend)
+      {
+        while (true)
+          {
+            dispatch_events ();
+
+              {
+                Critical_section cs; // -----
+
+                while (rx_frames_front_ != rx_frames_back_)
+                  {
+                    uint32_t end = rx_frame_ends_[rx_frames_front_
+                        % rx_frames_size];
+                    if (static_cast<int32_t> (end - rx_read_total_) > 0)
+                      {
+                        *pend = end;
+                        return 0;
+                      }
+                    // Already consumed with rx_consume().
+                    rx_frames_front_ = rx_frames_front_ + 1;
+                  }
+              }
+            if (!is_connected_)
+              {
+                return EIO;
+              }
+
+            // Block and wait for a frame.
+            int err = wait_sem (rx_sem_, rx_timeout_);
+            if (err != 0)
+              {
+                return err;
+              }
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_read_frame (void* buf,
+                                                             std::size_t nbyte)
+      {
+        while (true)
+          {
+            uint32_t end;
+            int err = rx_frame_wait (&end);
+            if (err != 0)
+              {
+                errno = err;
+                return -1;
+              }
+
+            std::size_t len = end - rx_read_total_;
+
+            uint8_t* pbuf1;
+            std::size_t len1;
+            uint8_t* pbuf2;
+            std::size_t len2;
+              {
+                Buffer_critical_section cs; // -----
+
+                rx_buf_->peekFront (&pbuf1, &len1, &pbuf2, &len2);
+              }
+            if (len1 > len)
+              {
+                len1 = len;
+              }
+
+            // Decode directly from the receive buffer, with the
+            // interrupts enabled; the ISR only adds bytes at the back,
+            // the frame stays in place until released.
+            Serial_frame_decoder decoder
+              { rx_framing_, rx_delimiter_, static_cast<uint8_t*> (buf), nbyte };
+            decoder.decode (pbuf1, len1);
+            decoder.decode (pbuf2, len - len1);
+
+            // Release the bytes.
+            rx_consume_frame ();
+
+            if (decoder.is_malformed ())
+              {
+                // Discard it.
+                rx_frame_errors_ = rx_frame_errors_ + 1;
+                continue;
+              }
+            if (decoder.length () == 0)
+              {
+                // Empty frame, for example a SLIP END before the frame,
+                // do not return 0 (EOF).
+                continue;
+              }
+
+            OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::read_return,
+                                          decoder.length ());
+
+            // If longer than the buffer, the rest of the frame is lost,
+            // like for datagrams.
+            return decoder.length ();
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_peek_frame (
+          uint8_t** ppbuf1, std::size_t* plen1, uint8_t** ppbuf2,
+          std::size_t* plen2)
+      {
+        assert(plen1 != nullptr);
+        assert(plen2 != nullptr);
+        if (rx_framing_ == serial_ioctl::framing_none)
+          {
+            errno = EINVAL; // Needs a framing mode.
+            return -1;
+          }
+
+        uint32_t end;
+        int err = rx_frame_wait (&end);
+        if (err != 0)
+          {
+            errno = err;
+            return -1;
+          }
+
+        std::size_t len = end - rx_read_total_;
+          {
+            Buffer_critical_section cs; // -----
+
+            rx_buf_->peekFront (ppbuf1, plen1, ppbuf2, plen2);
+          }
+        if (*plen1 >= len)
+          {
+            *plen1 = len;
+            *plen2 = 0;
+          }
+        else
+          {
+            *plen2 = len - *plen1;
+          }
+        return len;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::rx_consume_frame (void)
+      {
+        uint32_t end;
+          {
+            Critical_section cs; // -----
+
+            if (rx_frames_front_ == rx_frames_back_)
+              {
+                return;
+              }
+            end = rx_frame_ends_[rx_frames_front_ % rx_frames_size];
+            rx_frames_front_ = rx_frames_front_ + 1;
+          }
+
+        int32_t len = static_cast<int32_t> (end - rx_read_total_);
+        if (len > 0)
+          {
+            // Not already released with rx_consume().
+            rx_consume (static_cast<std::size_t> (len));
+          }
+        else
+          {
+            rx_check_unthrottle ();
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::readmsg (void* buf,
+                                                       std::size_t nbyte,
+                                                       Serial_rx_stamp* stamps,
+                                                       std::size_t* pcount)
+      {
+        assert(pcount != nullptr);
+        if (rx_stamps_ == nullptr)
+          {
+            errno = EINVAL; // Needs set_rx_stamps().
+            return -1;
+          }
+
+        uint32_t begin = rx_read_total_;
+        ssize_t ret = do_read (buf, nbyte);
+        if (ret < 0)
+          {
+            *pcount = 0;
+            return ret;
+          }
+        uint32_t end = rx_read_total_;
+
+        std::size_t n = 0;
+          {
+            Critical_section cs; // -----
+
+            uint32_t front = rx_stamps_front_;
+            uint32_t back = rx_stamps_back_;
+            for (; front != back; ++front)
+              {
+                const Serial_rx_stamp& stamp =
+                    rx_stamps_[front % rx_stamps_size_];
+                if (static_cast<int32_t> (stamp.end - begin) <= 0)
+                  {
+                    // Older chunk, already read.
+                    continue;
+                  }
+                if (n < *pcount)
+                  {
+                    stamps[n++] = stamp;
+                  }
+                if (static_cast<int32_t> (stamp.end - end) >= 0)
+                  {
+                    // The last chunk read, partially or entirely;
+                    // if partially, keep it for the next read.
+                    if (stamp.end == end)
+                      {
+                        ++front;
+                      }
+                    break;
+                  }
+              }
+            rx_stamps_front_ = front;
+          }
+
+        *pcount = n;
+        return ret;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::tx_reserve (uint8_t** ppbuf1,
+                                                          std::size_t* plen1,
+                                                          uint8_t** ppbuf2,
+                                                          std::size_t* plen2)
+      {
+        if (tx_buf_ == nullptr)
+          {
+            errno = EINVAL; // Needs a transmit buffer.
+            return -1;
+          }
+
+        while (true)
+          {
+            dispatch_events ();
+
+            std::size_t count;
+              {
+                Buffer_critical_section cs; // -----
+
+                count = tx_buf_->reserveBack (ppbuf1, plen1, ppbuf2, plen2);
+              }
+            if (count > 0)
+              {
+                return count;
+              }
+            if (!is_connected_)
+              {
+                errno = EIO;
+                return -1;
+              }
+            // Block and wait for buffer to be freed.
+            int err = wait_sem (tx_sem_, tx_timeout_);
+            if (err != 0)
+              {
+                errno = err;
+                return -1;
+              }
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::tx_commit (std::size_t nbyte)
+      {
+        if (tx_buf_ == nullptr)
+          {
+            errno = EINVAL; // Needs a transmit buffer.
+            return -1;
+          }
+
+        std::size_t count;
+          {
+            Buffer_critical_section cs; // -----
+
+            count = tx_buf_->advanceBack (nbyte);
+          }
+
+        if (start_send () != os::driver::RETURN_OK)
+          {
+            errno = EIO;
+            return -1;
+          }
+        return count;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      int
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::drain (void)
+      {
+        if (tx_buf_ == nullptr)
+          {
+            // Without a buffer, write() returns after the transmission.
+            return 0;
+          }
+
+        if (start_send (true) != os::driver::RETURN_OK)
+          {
+            errno = EIO;
+            return -1;
+          }
+
+        for (;;)
+          {
+            dispatch_events ();
+
+            bool is_done;
+              {
+                Critical_section cs; // -----
+
+                is_done = tx_buf_->isEmpty () && !tx_busy_;
+              }
+            if (is_done)
+              {
+                return 0;
+              }
+            if (!is_connected_)
+              {
+                errno = EIO;
+                return -1;
+              }
+            int err = wait_sem (tx_sem_, tx_timeout_);
+            if (err != 0)
+              {
+                errno = err;
+                return -1;
+              }
+          }
+      }
+
+    // ------------------------------------------------------------------------
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      ssize_t
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::do_writev (
+          const struct iovec* iov, int iovcnt)
+      {
+        if (iovcnt <= 0)
+          {
+            errno = EINVAL;
+            return -1;
+          }
+
+        std::size_t total = 0;
+        for (int i = 0; i < iovcnt; ++i)
+          {
+            total += iov[i].iov_len;
+          }
+        if (total == 0)
+          {
+            return 0;
+          }
+
+        power_wake ();
+
+        if (tx_buf_ != nullptr)
+          {
+            // Current segment and offset in it.
+            int i = 0;
+            std::size_t offset = 0;
+
+            std::size_t count = 0;
+            // As for write(), the first time only if below the high
+            // water mark, then after each wait.
+            bool is_waited = false;
+            while (true)
+              {
+                dispatch_events ();
+
+                  {
+                    Buffer_critical_section cs; // -----
+
+                    // Push as many segments as fit in the buffer.
+                    bool is_push = is_waited
+                        || tx_buf_->isBelowHighWaterMark ();
+                    for (; is_push && (i < iovcnt); ++i, offset = 0)
+                      {
+                        std::size_t len = iov[i].iov_len - offset;
+                        if (len == 0)
+                          {
+                            continue;
+                          }
+                        std::size_t n = tx_buf_->pushBack (
+                            static_cast<const uint8_t*> (iov[i].iov_base)
+                                + offset,
+                            len);
+                        count += n;
+                        if (n < len)
+                          {
+                            offset += n;
+                            break;
+                          }
+                      }
+                  }
+
+                // Start a single transmission for all segments.
+                if (start_send () != os::driver::RETURN_OK)
+                  {
+                    errno = EIO;
+                    return -1;
+                  }
+
+                if (count == total)
+                  {
+                    return total;
+                  }
+
+                if (!is_connected_)
+                  {
+                    if (count > 0)
+                      {
+                        return count;
+                      }
+
+                    errno = EIO;
+                    return -1;
+                  }
+
+                // Block and wait for buffer to be freed.
+                int err = wait_sem (tx_sem_, tx_timeout_);
+                if (err != 0)
+                  {
+                    if (count > 0)
+                      {
+                        return count;
+                      }
+
+                    errno = err;
+                    return -1;
+                  }
+                is_waited = true;
+              }
+          }
+        else
+          {
+            // Do not use a transmit buffer, send directly from the user
+            // buffers; the segments are sent as one transfer, if the
+            // driver can, otherwise they are chained in the ISR, without
+            // waking up the thread in between.
+
+            // Skip empty segments; there is at least one non empty.
+            while (iov->iov_len == 0)
+              {
+                ++iov;
+                --iovcnt;
+              }
+
+            // Wait while transmitting.
+            os::driver::serial::Status status;
+            for (;;)
+              {
+                dispatch_events ();
+
+                if (!is_connected_)
+                  {
+                    errno = EIO;
+                    return -1;
+                  }
+
+                status = driver_->get_status ();
+                if (!status.is_tx_busy ())
+                  {
+                    break;
+                  }
+                int err = wait_sem (tx_sem_, tx_timeout_);
+                if (err != 0)
+                  {
+                    errno = err;
+                    return -1;
+                  }
+              }
+
+            bool is_chained = false;
+            if ((iovcnt > 1)
+                && (static_cast<std::size_t> (iovcnt) <= tx_segments_max_))
+              {
+                  {
+                    Critical_section cs; // -----
+
+                    tx_chain_count_ = 0;
+                    tx_chain_failed_ = false;
+                    tx_iovcnt_ = 0;
+                  }
+
+                OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::send,
+                                               total);
+                is_chained = (send_chain (iov, iovcnt)
+                    == os::driver::RETURN_OK);
+              }
+
+            if (!is_chained)
+              {
+                  {
+                    Critical_section cs; // -----
+
+                    tx_chain_count_ = 0;
+                    tx_chain_failed_ = false;
+                    tx_iov_ = iov + 1;
+                    tx_iovcnt_ = iovcnt - 1;
+                  }
+
+                OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::send,
+                                               iov->iov_len);
+                if ((driver_->send (iov->iov_base, iov->iov_len))
+                    != os::driver::RETURN_OK)
+                  {
+                    tx_abort_direct ();
+                    errno = EIO;
+                    return -1;
+                  }
+              }
+
+            std::size_t count;
+            for (;;)
+              {
+                dispatch_events ();
+
+                if (!is_connected_)
+                  {
+                    tx_abort_direct ();
+                    errno = EIO;
+                    return -1;
+                  }
+
+                status = driver_->get_status ();
+                if (!status.is_tx_busy () && (tx_iovcnt_ == 0))
+                  {
+                    break;
+                  }
+                int err = wait_sem (tx_sem_, tx_timeout_, false);
+                if (err != 0)
+                  {
+                    // Timeout; return the bytes sent until now.
+                    tx_abort_direct ();
+                    count = tx_chain_count_ + driver_->get_tx_count ();
+                    if (count == 0)
+                      {
+                        errno = err;
+                        return -1;
+                      }
+                    return count;
+                  }
+              }
+
+              {
+                Critical_section cs; // -----
+
+                // The driver count is not that of the last segment
+                // if the ISR failed to chain it.
+                count = tx_chain_count_;
+                if (!tx_chain_failed_)
+                  {
+                    count += driver_->get_tx_count ();
+                  }
+                tx_iov_ = nullptr;
+                tx_iovcnt_ = 0;
+              }
+
+            // Actual number of bytes transmitted from all segments.
+            return count;
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      int
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::do_vioctl (int request,
+                                                         std::va_list args)
+      {
+        switch (request)
+          {
+          case serial_ioctl::set_rx_threshold:
+            {
+              const serial_ioctl::Rx_threshold* p =
+                  va_arg(args, const serial_ioctl::Rx_threshold*);
+              if ((p == nullptr) || (p->min_count == 0))
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              Critical_section cs; // -----
+
+              rx_threshold_ = p->min_count;
+              rx_gap_timeout_ = p->gap_timeout;
+              return 0;
+            }
+
+          case serial_ioctl::get_rx_threshold:
+            {
+              serial_ioctl::Rx_threshold* p =
+                  va_arg(args, serial_ioctl::Rx_threshold*);
+              if (p == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              p->min_count = rx_threshold_;
+              p->gap_timeout = rx_gap_timeout_;
+              return 0;
+            }
+
+          case serial_ioctl::set_flow_control:
+            {
+              int flow = va_arg(args, int);
+              return set_flow_control (flow);
+            }
+
+          case serial_ioctl::get_flow_control:
+            {
+              int* p = va_arg(args, int*);
+              if (p == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              *p = flow_control_;
+              return 0;
+            }
+
+          case serial_ioctl::set_line_config:
+            {
+              const serial_ioctl::Line_config* p =
+                  va_arg(args, const serial_ioctl::Line_config*);
+              if ((p == nullptr) || !is_valid_flow_control (p->flow_control))
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              return reconfigure (p);
+            }
+
+          case serial_ioctl::get_line_config:
+            {
+              serial_ioctl::Line_config* p =
+                  va_arg(args, serial_ioctl::Line_config*);
+              if (p == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              p->baud_rate = baud_rate_;
+              p->mode = line_mode_;
+              p->flow_control = flow_control_;
+              return 0;
+            }
+
+          case serial_ioctl::set_timeouts:
+            {
+              const serial_ioctl::Timeouts* p =
+                  va_arg(args, const serial_ioctl::Timeouts*);
+              if (p == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              rx_timeout_ = p->rx_timeout;
+              tx_timeout_ = p->tx_timeout;
+              return 0;
+            }
+
+          case serial_ioctl::get_timeouts:
+            {
+              serial_ioctl::Timeouts* p =
+                  va_arg(args, serial_ioctl::Timeouts*);
+              if (p == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              p->rx_timeout = rx_timeout_;
+              p->tx_timeout = tx_timeout_;
+              return 0;
+            }
+
+          case serial_ioctl::set_tx_coalesce:
+            {
+              const serial_ioctl::Tx_coalesce* p =
+                  va_arg(args, const serial_ioctl::Tx_coalesce*);
+              if (p == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+              if ((p->min_count > 1) && (tx_buf_ == nullptr))
+                {
+                  errno = EINVAL; // Needs a transmit buffer.
+                  return -1;
+                }
+
+              tx_coalesce_count_ = p->min_count;
+              tx_flush_timeout_ = p->flush_timeout;
+              if ((tx_buf_ != nullptr) && is_opened_)
+                {
+                  // Do not hold the bytes already in the buffer.
+                  start_send (true);
+                }
+              return 0;
+            }
+
+          case serial_ioctl::get_tx_coalesce:
+            {
+              serial_ioctl::Tx_coalesce* p =
+                  va_arg(args, serial_ioctl::Tx_coalesce*);
+              if (p == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              p->min_count = tx_coalesce_count_;
+              p->flush_timeout = tx_flush_timeout_;
+              return 0;
+            }
+
+          case serial_ioctl::set_power_policy:
+            {
+              const serial_ioctl::Power_policy* p =
+                  va_arg(args, const serial_ioctl::Power_policy*);
+              if (p == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              power_idle_timeout_ = p->idle_timeout;
+              if (is_opened_)
+                {
+                  power_timer_.stop ();
+                  power_wake ();
+                  if (power_idle_timeout_ > 0)
+                    {
+                      power_timer_.start (power_idle_timeout_);
+                    }
+                }
+              return 0;
+            }
+
+          case serial_ioctl::get_power_policy:
+            {
+              serial_ioctl::Power_policy* p =
+                  va_arg(args, serial_ioctl::Power_policy*);
+              if (p == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              p->idle_timeout = power_idle_timeout_;
+              return 0;
+            }
+
+          case serial_ioctl::drain:
+            return drain ();
+
+          case serial_ioctl::get_statistics:
+            {
+              serial_ioctl::Statistics* p =
+                  va_arg(args, serial_ioctl::Statistics*);
+              if (p == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+              Critical_section cs; // -----
+
+              *p = stats_;
+              p->rx_overruns = rx_overrun_count_;
+              p->rx_max_length = rx_buf_->getMaxLength ();
+              p->tx_max_length =
+                  (tx_buf_ != nullptr) ? tx_buf_->getMaxLength () : 0;
+              p->rx_frame_errors = rx_frame_errors_;
+              p->rx_frame_overruns = rx_frame_overruns_;
+              return 0;
+#else
+              errno = ENOSYS; // Not enabled.
+              return -1;
+#endif
+            }
+
+          case serial_ioctl::reset_statistics:
+            {
+              Critical_section cs; // -----
+
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+              stats_ = serial_ioctl::Statistics ();
+#endif
+              rx_overrun_count_ = 0;
+              rx_frame_errors_ = 0;
+              rx_frame_overruns_ = 0;
+              rx_buf_->resetMaxLength ();
+              if (tx_buf_ != nullptr)
+                {
+                  tx_buf_->resetMaxLength ();
+                }
+              return 0;
+            }
+
+          case serial_ioctl::set_rx_framing:
+            {
+              const serial_ioctl::Rx_framing* p =
+                  va_arg(args, const serial_ioctl::Rx_framing*);
+              if ((p == nullptr) || (p->mode < serial_ioctl::framing_none)
+                  || (p->mode > serial_ioctl::framing_cobs))
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+              if ((p->mode != serial_ioctl::framing_none)
+                  && (flow_control_ & serial_ioctl::flow_xon_xoff))
+                {
+                  errno = EINVAL; // XON/XOFF would break the frames.
+                  return -1;
+                }
+              if ((p->mode != serial_ioctl::framing_none)
+                  && Buffer_T::isChained)
+                {
+                  errno = EINVAL; // A frame may span more than two blocks.
+                  return -1;
+                }
+              if (is_opened_)
+                {
+                  errno = EBUSY;
+                  return -1;
+                }
+
+              rx_framing_ = p->mode;
+              rx_delimiter_ = p->delimiter;
+              rx_frame_end_char_ = serial_frame::get_end_delimiter (
+                  p->mode, p->delimiter);
+              return 0;
+            }
+
+          case serial_ioctl::get_rx_framing:
+            {
+              serial_ioctl::Rx_framing* p =
+                  va_arg(args, serial_ioctl::Rx_framing*);
+              if (p == nullptr)
+                {
+                  errno = EINVAL;
+                  return -1;
+                }
+
+              p->mode = rx_framing_;
+              p->delimiter = rx_delimiter_;
+              return 0;
+            }
+
+          default:
+            break;
+          }
+
+        errno = ENOTTY; // Not a request for this device.
+        return -1;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      bool
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::is_valid_flow_control (
+          int flow) const
+      {
+        if ((flow
+            & ~(serial_ioctl::flow_rts | serial_ioctl::flow_cts
+                | serial_ioctl::flow_xon_xoff)) != 0)
+          {
+            return false;
+          }
+
+        // XON/XOFF cannot be mixed with the frames.
+        if ((flow & serial_ioctl::flow_xon_xoff)
+            && (rx_framing_ != serial_ioctl::framing_none))
+          {
+            return false;
+          }
+
+        // Pausing the transmission needs a transmit buffer.
+        return !((flow & (serial_ioctl::flow_cts | serial_ioctl::flow_xon_xoff))
+            && (tx_buf_ == nullptr));
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      int
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::set_flow_control (int flow)
+      {
+        if (!is_valid_flow_control (flow))
+          {
+            errno = EINVAL;
+            return -1;
+          }
+
+        Critical_section cs; // -----
+
+        int old = flow_control_;
+        flow_control_ = flow;
+        if (!is_opened_)
+          {
+            // Applied by open().
+            return 0;
+          }
+
+        os::driver::return_t ret = os::driver::RETURN_OK;
+        if ((flow & serial_ioctl::flow_rts) != (old & serial_ioctl::flow_rts))
+          {
+            // When no longer used, leave RTS active.
+            ret = driver_->control_modem_line (
+                ((flow & serial_ioctl::flow_rts) && rx_throttled_) ?
+                    os::driver::serial::Modem_control::deactivate_rts :
+                    os::driver::serial::Modem_control::activate_rts);
+          }
+        if (!(flow & (serial_ioctl::flow_rts | serial_ioctl::flow_xon_xoff)))
+          {
+            rx_throttled_ = false;
+          }
+
+        if (flow & serial_ioctl::flow_cts)
+          {
+            os::driver::serial::Modem_status status;
+            status = driver_->get_modem_status ();
+            tx_cts_paused_ = !status.is_cts_active ();
+          }
+        else
+          {
+            tx_cts_paused_ = false;
+          }
+        if (!(flow & serial_ioctl::flow_xon_xoff))
+          {
+            tx_xoff_paused_ = false;
+          }
+        if (tx_buf_ != nullptr)
+          {
+            update_tx_pause ();
+          }
+
+        if (ret != os::driver::RETURN_OK)
+          {
+            errno = EIO;
+            return -1;
+          }
+        return 0;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      int
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::reconfigure (
+          const serial_ioctl::Line_config* config)
+      {
+        if (!is_opened_)
+          {
+            // Applied by open().
+            baud_rate_ = config->baud_rate;
+            line_mode_ = config->mode;
+            return set_flow_control (config->flow_control);
+          }
+
+        power_wake ();
+
+        // Send the buffered bytes with the old configuration;
+        // if disconnected, reconfigure anyway. With O_NONBLOCK and
+        // bytes still to send, or after the timeout, keep the old one.
+        if ((drain () < 0) && (errno != EIO))
+          {
+            return -1;
+          }
+
+        os::driver::return_t ret;
+          {
+            Critical_section cs; // -----
+
+            // Stop receiving, but keep the bytes already received.
+            ret = driver_->control (
+                os::driver::serial::Control::abort_receive);
+            if (ret == os::driver::RETURN_OK)
+              {
+                if (rx_account (driver_->get_rx_count ()) > 0)
+                  {
+                    // The reader may be waiting for them.
+                    rx_sem_.post ();
+                    post_poll_event ();
+                  }
+
+                ret = driver_->configure (config->mode, config->baud_rate);
+              }
+            if (ret == os::driver::RETURN_OK)
+              {
+                baud_rate_ = config->baud_rate;
+                line_mode_ = config->mode;
+              }
+
+            // Receive again, even if the configuration failed.
+            rx_count_ = 0;
+            os::driver::return_t r = start_receive ();
+            if (ret == os::driver::RETURN_OK)
+              {
+                ret = r;
+              }
+          }
+        if (ret != os::driver::RETURN_OK)
+          {
+            errno = EIO;
+            return -1;
+          }
+
+        return set_flow_control (config->flow_control);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      int
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::do_vfcntl (int cmd,
+                                                         std::va_list args)
+      {
+        switch (cmd)
+          {
+          case F_GETFL:
+            return status_flags_;
+
+          case F_SETFL:
+            {
+              // Only O_NONBLOCK can be changed.
+              int flags = va_arg(args, int);
+              status_flags_ = (status_flags_ & ~O_NONBLOCK)
+                  | (flags & O_NONBLOCK);
+              is_nonblocking_ = ((flags & O_NONBLOCK) != 0);
+              return 0;
+            }
+
+          default:
+            break;
+          }
+
+        errno = EINVAL;
+        return -1;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::tx_abort_direct (
+          void)
+      {
+        Critical_section cs; // -----
+
+        driver_->control (os::driver::serial::Control::abort_send);
+        tx_iov_ = nullptr;
+        tx_iovcnt_ = 0;
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      int
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::wait_sem (
+          os::rtos::semaphore_binary& sem,
+          os::rtos::clock::duration_t timeout, bool is_stoppable)
+      {
+        if (is_nonblocking_ && is_stoppable)
+          {
+            return EAGAIN;
+          }
+
+        bool is_rx = (&sem == &rx_sem_);
+        OS_POSIX_DRIVERS_SERIAL_TRACE (
+            this, is_rx ? serial_trace::rx_wait : serial_trace::tx_wait,
+            timeout);
+
+        int err = 0;
+        if (timeout == 0)
+          {
+            sem.wait();
+          }
+        else if (sem.timed_wait (timeout) == ETIMEDOUT)
+          {
+            err = ETIMEDOUT;
+          }
+
+        OS_POSIX_DRIVERS_SERIAL_TRACE (
+            this, is_rx ? serial_trace::rx_wakeup : serial_trace::tx_wakeup,
+            err);
+        return err;
+      }
+
+    // ------------------------------------------------------------------------
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::signal_event (
+          Buffered_serial_device* object, uint32_t event)
+      {
+        if (!object->is_opened_)
+          {
+            // After close(), ignore interrupts.
+            return;
+          }
+
+        if (object->event_dispatch_ == Event_dispatch::isr)
+          {
+            handle_event (object, event);
+            return;
+          }
+
+        uint32_t pending = object->pending_events_;
+        if ((event & object->immediate_events_) || object->power_low_)
+          {
+            // Process now, together with the pending ones; at low
+            // power, also restore the full power.
+            object->pending_events_ = 0;
+            handle_event (object, pending | event);
+            return;
+          }
+
+        // Only record; all the events are merged, the processing is
+        // driven by the driver counts, not by the number of events.
+        object->pending_events_ = pending | event;
+        object->power_activity_ = true;
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+        ++object->stats_.isr_deferred;
+#endif
+        if (pending != 0)
+          {
+            // The batch is already scheduled.
+            return;
+          }
+
+        if (object->event_notify_ != nullptr)
+          {
+            object->event_notify_ (object->event_notify_arg_);
+          }
+        else
+          {
+            // Let the waiting threads dispatch the events.
+            object->rx_sem_.post ();
+            object->tx_sem_.post ();
+            object->post_poll_event ();
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::dispatch_events (void)
+      {
+        if (pending_events_ == 0)
+          {
+            return;
+          }
+
+        uint32_t events;
+          {
+            Critical_section cs; // -----
+
+            events = pending_events_;
+            pending_events_ = 0;
+          }
+        if ((events == 0) || !is_opened_)
+          {
+            return;
+          }
+
+        // Not as a single block, the interrupts are disabled only as
+        // long as the ISR would have run for each kind of event; the
+        // ISR may process new events in between, the processing is
+        // driven by the driver counts, not by the events.
+        power_wake ();
+        OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::isr_enter, events);
+          {
+            Critical_section cs; // -----
+
+            handle_rx_event (this, events);
+          }
+          {
+            Critical_section cs; // -----
+
+            handle_tx_event (this, events);
+          }
+          {
+            Critical_section cs; // -----
+
+            handle_line_event (this, events);
+          }
+        OS_POSIX_DRIVERS_SERIAL_TRACE (this, serial_trace::isr_exit, events);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::handle_event (
+          Buffered_serial_device* object, uint32_t event)
+      {
+        // Any event, usually the first received bytes, restores the
+        // full power.
+        object->power_wake ();
+
+        OS_POSIX_DRIVERS_SERIAL_TRACE (object, serial_trace::isr_enter, event);
+
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+        uint32_t begin_cycles = OS_POSIX_DRIVERS_SERIAL_CYCLES ();
+#endif
+
+        handle_rx_event (object, event);
+        handle_tx_event (object, event);
+        handle_line_event (object, event);
+
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+        uint32_t cycles = OS_POSIX_DRIVERS_SERIAL_CYCLES () - begin_cycles;
+        if (cycles > object->stats_.isr_max_cycles)
+          {
+            object->stats_.isr_max_cycles = cycles;
+          }
+#endif
+
+        OS_POSIX_DRIVERS_SERIAL_TRACE (object, serial_trace::isr_exit, event);
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::handle_rx_event (
+          Buffered_serial_device* object, uint32_t event)
+      {
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+        serial_ioctl::Statistics& stats = object->stats_;
+        // Once per ISR or per batch; the first part.
+        ++stats.isr_count;
+        if (event & os::driver::serial::Event::rx_overflow)
+          {
+            ++stats.rx_hw_overflows;
+          }
+        if (event & os::driver::serial::Event::rx_framing_error)
+          {
+            ++stats.rx_framing_errors;
+          }
+        if (event & os::driver::serial::Event::rx_parity_error)
+          {
+            ++stats.rx_parity_errors;
+          }
+        if (event & os::driver::serial::Event::rx_break)
+          {
+            ++stats.rx_breaks;
+          }
+#endif
+
+        // The rx_progress event (see serial-event.h) only moves the
+        // bytes received so far to the buffer, the receive goes on.
+        if ((event
+            & (os::driver::serial::Event::receive_complete
+                | serial_event::rx_progress
+                | os::driver::serial::Event::rx_framing_error
+                | os::driver::serial::Event::rx_parity_error
+                | os::driver::serial::Event::rx_break
+                | os::driver::serial::Event::rx_overflow
+                | os::driver::serial::Event::rx_timeout)))
+          {
+            // The error events are counted above and stamped below;
+            // the bytes received so far are kept.
+            uint32_t frames = object->rx_frames_back_;
+            std::size_t count = object->rx_account (
+                object->driver_->get_rx_count ());
+            if (object->rx_stamps_ != nullptr)
+              {
+                object->rx_stamp (count, event);
+              }
+            if ((object->rx_framing_ == serial_ioctl::framing_idle)
+                && (event & os::driver::serial::Event::rx_timeout))
+              {
+                object->rx_frame_scan (nullptr, 0, true);
+              }
+            if ((count > 0) && (object->bridge_sink_ != nullptr))
+              {
+                // Bridged, forward before the receive is restarted,
+                // there is no reader to wake up.
+                object->bridge_pull ();
+              }
+
+            bool is_framed = (object->rx_framing_
+                != serial_ioctl::framing_none);
+            if (is_framed && (frames != object->rx_frames_back_))
+              {
+                // Wake up the reader only for complete frames.
+                OS_POSIX_DRIVERS_SERIAL_TRACE (object, serial_trace::rx_post,
+                                              object->rx_frames_back_ - frames);
+                object->rx_sem_.post();
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+                ++stats.rx_wakeups;
+#endif
+                object->post_poll_event ();
+              }
+
+            if (event & os::driver::serial::Event::receive_complete)
+              {
+                // Read as much as we can.
+                object->rx_count_ = 0;
+                if (object->start_receive () != os::driver::RETURN_OK)
+                  {
+                    object->rx_error ();
+                  }
+              }
+            else if (event & os::driver::serial::Event::rx_timeout)
+              {
+                // Idle in the middle of the discard buffer; continue
+                // in the space freed by the reader, if any.
+                object->rx_check_rearm ();
+              }
+            if ((count > 0) && !is_framed
+                && (object->bridge_sink_ == nullptr))
+              {
+                bool is_idle = ((event & os::driver::serial::Event::rx_timeout)
+                    != 0);
+                if (is_idle)
+                  {
+                    object->rx_idle_ = true;
+                  }
+
+                // Wake up the reader only when enough bytes were received,
+                // when the line becomes idle, or, if a gap timeout is
+                // used, when the first bytes arrive, to start timing.
+                std::size_t len = object->rx_buf_->length ();
+                if ((len >= object->rx_wakeup_count_) || is_idle
+                    || object->rx_buf_->isFull ()
+                    || ((len == count) && (object->rx_gap_timeout_ > 0)))
+                  {
+                    OS_POSIX_DRIVERS_SERIAL_TRACE (object, serial_trace::rx_post, len);
+                    object->rx_sem_.post();
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+                    ++stats.rx_wakeups;
+#endif
+                  }
+                if ((len >= object->rx_threshold_) || is_idle
+                    || object->rx_buf_->isFull ())
+                  {
+                    object->post_poll_event ();
+                  }
+              }
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::handle_tx_event (
+          Buffered_serial_device* object, uint32_t event)
+      {
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+        serial_ioctl::Statistics& stats = object->stats_;
+#endif
+
+        if (event & os::driver::serial::Event::tx_complete)
+          {
+            if (object->tx_buf_ != nullptr)
+              {
+                if (object->tx_flow_sending_)
+                  {
+                    // The XON/XOFF was sent, not bytes from the buffer.
+                    object->tx_flow_sending_ = false;
+                  }
+                else
+                  {
+                    std::size_t count = object->driver_->get_tx_count ();
+                    std::size_t adjust = object->tx_buf_->advanceFront (count);
+                    assert(count == adjust);
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+                    stats.tx_bytes += count;
+#endif
+                  }
+
+                if (object->send_next () != os::driver::RETURN_OK)
+                  {
+                    // Refused by the driver; the bytes stay in the
+                    // buffer, the next write() retries.
+                    object->tx_error ();
+                  }
+
+                Serial_bridgeable* source = object->bridge_source_;
+                if (source != nullptr)
+                  {
+                    // There is space now, take more from the source.
+                    source->bridge_pull ();
+                  }
+
+                if (object->tx_buf_->isBelowLowWaterMark ())
+                  {
+                    // Wake up thread, to come and send more bytes.
+                    OS_POSIX_DRIVERS_SERIAL_TRACE (object, serial_trace::tx_post,
+                                                  object->tx_buf_->length ());
+                    object->tx_sem_.post();
+                    object->post_poll_event ();
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+                    ++stats.tx_wakeups;
+#endif
+                  }
+              }
+            else
+              {
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+                stats.tx_bytes += object->driver_->get_tx_count ();
+#endif
+
+                // Skip empty writev() segments.
+                const struct iovec* iov = object->tx_iov_;
+                int iovcnt = object->tx_iovcnt_;
+                while ((iovcnt > 0) && (iov->iov_len == 0))
+                  {
+                    ++iov;
+                    --iovcnt;
+                  }
+
+                if (iovcnt > 0)
+                  {
+                    // Chain the next writev() segment.
+                    object->tx_chain_count_ += object->driver_->get_tx_count ();
+                    object->tx_iov_ = iov + 1;
+                    object->tx_iovcnt_ = iovcnt - 1;
+
+                    OS_POSIX_DRIVERS_SERIAL_TRACE (object, serial_trace::send,
+                                                  iov->iov_len);
+                    if (object->driver_->send (iov->iov_base, iov->iov_len)
+                        != os::driver::RETURN_OK)
+                      {
+                        // Stop the chain, writev() returns the bytes
+                        // of the previous segments.
+                        object->tx_iov_ = nullptr;
+                        object->tx_iovcnt_ = 0;
+                        object->tx_chain_failed_ = true;
+                        object->tx_error ();
+                      }
+                  }
+                else
+                  {
+                    object->tx_iovcnt_ = 0;
+
+                    // No buffer, wake up the thread to return from write().
+                    OS_POSIX_DRIVERS_SERIAL_TRACE (object, serial_trace::tx_post, 0);
+                    object->tx_sem_.post();
+                    object->post_poll_event ();
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS)
+                    ++stats.tx_wakeups;
+#endif
+                  }
+              }
+          }
+      }
+
+    template<typename Cs_T, typename Buffer_T, typename Driver_T>
+      void
+      Buffered_serial_device<Cs_T, Buffer_T, Driver_T>::handle_line_event (
+          Buffered_serial_device* object, uint32_t event)
+      {
+        if (event & os::driver::serial::Event::dcd)
+          {
+            os::driver::serial::Modem_status status;
+            status = object->driver_->get_modem_status ();
+
+            bool is_dcd_active = status.is_dcd_active ();
+            object->is_connected_ = is_dcd_active;
+            if (is_dcd_active)
+              {
+                // Connected, wake-up open().
+                object->open_sem_.post();
+              }
+            else
+              {
+                // Disconnected, cancel read.
+                object->rx_sem_.post();
+
+                // Cancel write.
+                object->tx_sem_.post();
+              }
+            object->post_poll_event ();
+          }
+        if (event & os::driver::serial::Event::cts)
+          {
+            if (object->flow_control_ & serial_ioctl::flow_cts)
+              {
+                os::driver::serial::Modem_status status;
+                status = object->driver_->get_modem_status ();
+
+                bool paused = !status.is_cts_active ();
+                if (paused != object->tx_cts_paused_)
+                  {
+                    // Pause or resume the transmission.
+                    object->tx_cts_paused_ = paused;
+                    object->update_tx_pause ();
+                  }
+              }
           }
         if (event & os::driver::serial::Event::dsr)
           {
-            // TODO: add flow control
+            // DSR is not used for flow control.
           }
       }
 
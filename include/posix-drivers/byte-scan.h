@@ -0,0 +1,100 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef POSIX_DRIVERS_BYTE_SCAN_H_
+#define POSIX_DRIVERS_BYTE_SCAN_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// ----------------------------------------------------------------------------
+
+// Bulk byte scanning, a word at a time (SWAR), used to locate the
+// delimiters in the circular buffers, and the copy used to move
+// the short transfers in and out of them.
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    // Like memchr(); return a pointer to the first occurrence of the
+    // byte, or nullptr.
+    const uint8_t*
+    find_byte (const uint8_t* buf, std::size_t len, uint8_t c);
+
+    // Return the number of occurrences of the byte.
+    std::size_t
+    count_byte (const uint8_t* buf, std::size_t len, uint8_t c);
+
+    // Like memcpy(), for buffers that do not overlap; the short copies,
+    // typical for the console traffic, are done inline, with at most
+    // two (possibly overlapping) word moves, instead of a library call.
+    // The fixed size memcpy() calls compile to single loads and stores
+    // where unaligned accesses are allowed, and to byte accesses
+    // otherwise (Cortex-M0).
+    inline void
+    copy_bytes (uint8_t* dst, const uint8_t* src, std::size_t len)
+    {
+      if (len > 16)
+        {
+          std::memcpy (dst, src, len);
+        }
+      else if (len >= 8)
+        {
+          uint64_t head;
+          uint64_t tail;
+          std::memcpy (&head, src, 8);
+          std::memcpy (&tail, src + len - 8, 8);
+          std::memcpy (dst, &head, 8);
+          std::memcpy (dst + len - 8, &tail, 8);
+        }
+      else if (len >= 4)
+        {
+          uint32_t head;
+          uint32_t tail;
+          std::memcpy (&head, src, 4);
+          std::memcpy (&tail, src + len - 4, 4);
+          std::memcpy (dst, &head, 4);
+          std::memcpy (dst + len - 4, &tail, 4);
+        }
+      else if (len > 0)
+        {
+          // 1 to 3 bytes; the middle one may repeat the first or last.
+          dst[0] = src[0];
+          dst[len / 2] = src[len / 2];
+          dst[len - 1] = src[len - 1];
+        }
+    }
+
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* POSIX_DRIVERS_BYTE_SCAN_H_ */
@@ -29,10 +29,13 @@
 #define POSIX_DRIVERS_CMSIS_DRIVER_SERIAL_H_
 
 // #include "Driver_USART.h"
+#include "posix-drivers/serial-event.h"
 
 // ----------------------------------------------------------------------------
 #ifdef __cplusplus
 
+struct iovec;
+
 namespace os
 {
   namespace cmsis
@@ -41,6 +44,15 @@ namespace os
     {
       // ----------------------------------------------------------------------
 
+      // A vendor extension of the CMSIS USART drivers of the controllers
+      // with linked-list DMA: send all the segments as one transfer,
+      // with a single ARM_USART_EVENT_SEND_COMPLETE/TX_COMPLETE, and
+      // GetTxCount() counting the bytes of all the segments.
+      typedef int32_t
+      (*send_chain_t) (const struct iovec* iov, int iovcnt);
+
+      // ----------------------------------------------------------------------
+
       class Serial
       {
 
@@ -78,6 +90,20 @@ namespace os
         virtual int32_t
         send (const void* data, uint32_t num) = 0;
 
+        // The maximum number of segments for send_chain(), 0 if not
+        // supported; by default 0.
+        virtual uint32_t
+        get_send_segments_max (void);
+
+        // Optional scatter-gather send, for the controllers with
+        // linked-list DMA: send all the segments as one transfer, with
+        // a single ARM_USART_EVENT_SEND_COMPLETE/TX_COMPLETE, and
+        // get_tx_count() counting the bytes of all the segments.
+        // Call it only for up to get_send_segments_max() segments;
+        // by default ARM_DRIVER_ERROR_UNSUPPORTED.
+        virtual int32_t
+        send_chain (const struct iovec* iov, int iovcnt);
+
         virtual int32_t
         receive (void* data, uint32_t num) = 0;
 
@@ -102,6 +128,12 @@ namespace os
         virtual ARM_USART_MODEM_STATUS
         get_modem_status (void) = 0;
 
+        // The vendor specific event bits that report the progress
+        // of a reception, like a DMA half-transfer; they are passed
+        // to the callback as ARM_USART_EVENT_RX_PROGRESS.
+        void
+        set_rx_progress_events (uint32_t events);
+
         void
         signal_event (uint32_t event);
 
@@ -115,6 +147,8 @@ namespace os
         signal_event_t cb_event_; // Pointer to static function.
         const void* cb_object_; // Pointer to object instance.
 
+        uint32_t rx_progress_events_;
+
       };
     } /* namespace driver */
   } /* namespace cmsis */
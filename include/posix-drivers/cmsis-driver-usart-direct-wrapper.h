@@ -0,0 +1,470 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef CMSIS_DRIVER_USART_DIRECT_WRAPPER_H_
+#define CMSIS_DRIVER_USART_DIRECT_WRAPPER_H_
+
+// ----------------------------------------------------------------------------
+
+#include <cmsis-plus/drivers/serial.h>
+#include <posix-drivers/serial-event.h>
+
+#include "Driver_USART.h"
+#include "posix-drivers/cmsis-driver-serial.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// ----------------------------------------------------------------------------
+
+// The os::driver::Serial API, implemented directly on a CMSIS USART
+// driver, with non-virtual inline functions; used as the driver type
+// of Buffered_serial_device, it gets direct calls to the CMSIS function
+// table, with no virtual hops, also in signal_event().
+//
+// The CMSIS callback has no object pointer; the driver is a template
+// parameter, so each instantiation has its own static callback that
+// forwards the event, and no per-instance trampoline needs to be
+// written by the application:
+//
+//   extern ARM_DRIVER_USART Driver_USART2;
+//   using Usart2 = os::cmsis::driver::Usart_direct_wrapper<&Driver_USART2>;
+//   Usart2 usart2_driver;
+//   os::dev::Buffered_serial_device<Cs, os::dev::ByteCircularBuffer, Usart2>
+//     usart2 { "usart2", &usart2_driver, &rx_buf, &tx_buf };
+//
+// As for the os::driver::Serial drivers, power() must be called
+// before open().
+//
+// For the controllers with linked-list DMA, pass the vendor send_chain
+// function and its maximum number of segments too; the device then
+// sends the wrapped transmit buffer as one transfer:
+//
+//   using Usart2 = os::cmsis::driver::Usart_direct_wrapper<&Driver_USART2,
+//     &USART2_SendChain, 4>;
+
+namespace os
+{
+  namespace cmsis
+  {
+    namespace driver
+    {
+      // ----------------------------------------------------------------------
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P = nullptr,
+          std::size_t Segments_P = 0>
+        class Usart_direct_wrapper
+        {
+        public:
+
+          Usart_direct_wrapper () = default;
+
+          Usart_direct_wrapper (const Usart_direct_wrapper&) = delete;
+
+          Usart_direct_wrapper&
+          operator= (const Usart_direct_wrapper&) = delete;
+
+          // ------------------------------------------------------------------
+
+          // Only one callback per driver.
+          void
+          register_callback (os::driver::signal_event_t cb_func,
+                             const void* cb_object = nullptr);
+
+          // Initialize the CMSIS driver when first powered up, not when
+          // it wakes up from low power; uninitialize it when powered
+          // down.
+          os::driver::return_t
+          power (os::driver::Power state);
+
+          const os::driver::serial::Capabilities&
+          get_capabilities (void);
+
+          os::driver::return_t
+          send (const void* data, std::size_t num);
+
+          // 0 without a send_chain function.
+          std::size_t
+          get_send_segments_max (void);
+
+          os::driver::return_t
+          send_chain (const struct iovec* iov, int iovcnt);
+
+          os::driver::return_t
+          receive (void* data, std::size_t num);
+
+          std::size_t
+          get_tx_count (void);
+
+          std::size_t
+          get_rx_count (void);
+
+          os::driver::return_t
+          configure (os::driver::serial::config_t cfg,
+                     os::driver::serial::config_arg_t arg);
+
+          os::driver::return_t
+          control (os::driver::serial::Control ctrl);
+
+          os::driver::serial::Status
+          get_status (void);
+
+          os::driver::return_t
+          control_modem_line (os::driver::serial::Modem_control ctrl);
+
+          os::driver::serial::Modem_status
+          get_modem_status (void);
+
+          // ------------------------------------------------------------------
+
+        private:
+
+          // Passed to the CMSIS driver.
+          static void
+          signal_event (uint32_t event);
+
+          static os::driver::signal_event_t cb_func_;
+          static const void* cb_object_;
+
+          os::driver::serial::Capabilities capabilities_;
+
+          bool is_initialized_ = false;
+        };
+
+      // ----------------------------------------------------------------------
+
+      // The events are passed unchanged, including
+      // ARM_USART_EVENT_RX_PROGRESS, see serial-event.h; all the
+      // CMSIS event bits must have the same values.
+      static_assert(ARM_USART_EVENT_SEND_COMPLETE
+          == os::driver::serial::Event::send_complete, "event");
+      static_assert(ARM_USART_EVENT_RECEIVE_COMPLETE
+          == os::driver::serial::Event::receive_complete, "event");
+      static_assert(ARM_USART_EVENT_TRANSFER_COMPLETE
+          == os::driver::serial::Event::transfer_complete, "event");
+      static_assert(ARM_USART_EVENT_TX_COMPLETE
+          == os::driver::serial::Event::tx_complete, "event");
+      static_assert(ARM_USART_EVENT_TX_UNDERFLOW
+          == os::driver::serial::Event::tx_underflow, "event");
+      static_assert(ARM_USART_EVENT_RX_OVERFLOW
+          == os::driver::serial::Event::rx_overflow, "event");
+      static_assert(ARM_USART_EVENT_RX_TIMEOUT
+          == os::driver::serial::Event::rx_timeout, "event");
+      static_assert(ARM_USART_EVENT_RX_BREAK
+          == os::driver::serial::Event::rx_break, "event");
+      static_assert(ARM_USART_EVENT_RX_FRAMING_ERROR
+          == os::driver::serial::Event::rx_framing_error, "event");
+      static_assert(ARM_USART_EVENT_RX_PARITY_ERROR
+          == os::driver::serial::Event::rx_parity_error, "event");
+      static_assert(ARM_USART_EVENT_CTS
+          == os::driver::serial::Event::cts, "event");
+      static_assert(ARM_USART_EVENT_DSR
+          == os::driver::serial::Event::dsr, "event");
+      static_assert(ARM_USART_EVENT_DCD
+          == os::driver::serial::Event::dcd, "event");
+      static_assert(ARM_USART_EVENT_RI
+          == os::driver::serial::Event::ri, "event");
+
+      // The configuration bits too.
+      static_assert(ARM_USART_MODE_ASYNCHRONOUS
+          == os::driver::serial::MODE_ASYNCHRONOUS, "mode");
+      static_assert(ARM_USART_PARITY_EVEN
+          == os::driver::serial::PARITY_EVEN, "mode");
+      static_assert(ARM_USART_FLOW_CONTROL_RTS_CTS
+          == os::driver::serial::FLOW_CONTROL_RTS_CTS, "mode");
+
+      // ----------------------------------------------------------------------
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        os::driver::signal_event_t Usart_direct_wrapper<Driver_P, Chain_P,
+            Segments_P>::cb_func_ = nullptr;
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        const void* Usart_direct_wrapper<Driver_P, Chain_P,
+            Segments_P>::cb_object_ = nullptr;
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        void
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::signal_event (
+            uint32_t event)
+        {
+          os::driver::signal_event_t cb_func = cb_func_;
+          if (cb_func != nullptr)
+            {
+              cb_func (cb_object_, event);
+            }
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline void
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::register_callback (
+            os::driver::signal_event_t cb_func, const void* cb_object)
+        {
+          cb_object_ = cb_object;
+          cb_func_ = cb_func;
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        os::driver::return_t
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::power (
+            os::driver::Power state)
+        {
+          int32_t status;
+          if (state == os::driver::Power::full)
+            {
+              if (!is_initialized_)
+                {
+                  status = Driver_P->Initialize (signal_event);
+                  if (status != ARM_DRIVER_OK)
+                    {
+                      return status;
+                    }
+                  is_initialized_ = true;
+                }
+              return Driver_P->PowerControl (ARM_POWER_FULL);
+            }
+          if (state == os::driver::Power::low)
+            {
+              return Driver_P->PowerControl (ARM_POWER_LOW);
+            }
+
+          status = Driver_P->PowerControl (ARM_POWER_OFF);
+          if (is_initialized_)
+            {
+              Driver_P->Uninitialize ();
+              is_initialized_ = false;
+            }
+          return status;
+        }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Waggregate-return"
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        const os::driver::serial::Capabilities&
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::get_capabilities (
+            void)
+        {
+          ARM_USART_CAPABILITIES capa = Driver_P->GetCapabilities ();
+
+          capabilities_ = os::driver::serial::Capabilities ();
+          capabilities_.asynchronous = capa.asynchronous;
+          capabilities_.flow_control_rts = capa.flow_control_rts;
+          capabilities_.flow_control_cts = capa.flow_control_cts;
+          capabilities_.event_tx_complete = capa.event_tx_complete;
+          capabilities_.event_rx_timeout = capa.event_rx_timeout;
+          capabilities_.rts = capa.rts;
+          capabilities_.cts = capa.cts;
+          capabilities_.dtr = capa.dtr;
+          capabilities_.dsr = capa.dsr;
+          capabilities_.dcd = capa.dcd;
+          capabilities_.ri = capa.ri;
+          capabilities_.event_cts = capa.event_cts;
+          capabilities_.event_dsr = capa.event_dsr;
+          capabilities_.event_dcd = capa.event_dcd;
+          capabilities_.event_ri = capa.event_ri;
+          return capabilities_;
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline os::driver::serial::Status
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::get_status (void)
+        {
+          ARM_USART_STATUS arm = Driver_P->GetStatus ();
+
+          os::driver::serial::Status status
+            { };
+          status.tx_busy = arm.tx_busy;
+          status.rx_busy = arm.rx_busy;
+          status.tx_underflow = arm.tx_underflow;
+          status.rx_overflow = arm.rx_overflow;
+          status.rx_break = arm.rx_break;
+          status.rx_framing_error = arm.rx_framing_error;
+          status.rx_parity_error = arm.rx_parity_error;
+          return status;
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline os::driver::serial::Modem_status
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::get_modem_status (
+            void)
+        {
+          ARM_USART_MODEM_STATUS arm = Driver_P->GetModemStatus ();
+
+          os::driver::serial::Modem_status status
+            { };
+          status.cts = arm.cts;
+          status.dsr = arm.dsr;
+          status.dcd = arm.dcd;
+          status.ri = arm.ri;
+          return status;
+        }
+
+#pragma GCC diagnostic pop
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline os::driver::return_t
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::send (
+            const void* data, std::size_t num)
+        {
+          return Driver_P->Send (data, static_cast<uint32_t> (num));
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline std::size_t
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::get_send_segments_max (
+            void)
+        {
+          return (Chain_P != nullptr) ? Segments_P : 0;
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline os::driver::return_t
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::send_chain (
+            const struct iovec* iov, int iovcnt)
+        {
+          if ((Chain_P == nullptr) || (iovcnt <= 0)
+              || (static_cast<std::size_t> (iovcnt) > Segments_P))
+            {
+              return ARM_DRIVER_ERROR_UNSUPPORTED;
+            }
+          return Chain_P (iov, iovcnt);
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline os::driver::return_t
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::receive (
+            void* data, std::size_t num)
+        {
+          return Driver_P->Receive (data, static_cast<uint32_t> (num));
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline std::size_t
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::get_tx_count (void)
+        {
+          return Driver_P->GetTxCount ();
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline std::size_t
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::get_rx_count (void)
+        {
+          return Driver_P->GetRxCount ();
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline os::driver::return_t
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::configure (
+            os::driver::serial::config_t cfg,
+            os::driver::serial::config_arg_t arg)
+        {
+          return Driver_P->Control (cfg, arg);
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline os::driver::return_t
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::control (
+            os::driver::serial::Control ctrl)
+        {
+          switch (ctrl)
+            {
+            case os::driver::serial::Control::enable_tx:
+              return Driver_P->Control (ARM_USART_CONTROL_TX, 1);
+
+            case os::driver::serial::Control::disable_tx:
+              return Driver_P->Control (ARM_USART_CONTROL_TX, 0);
+
+            case os::driver::serial::Control::enable_rx:
+              return Driver_P->Control (ARM_USART_CONTROL_RX, 1);
+
+            case os::driver::serial::Control::disable_rx:
+              return Driver_P->Control (ARM_USART_CONTROL_RX, 0);
+
+            case os::driver::serial::Control::enable_break:
+              return Driver_P->Control (ARM_USART_CONTROL_BREAK, 1);
+
+            case os::driver::serial::Control::disable_break:
+              return Driver_P->Control (ARM_USART_CONTROL_BREAK, 0);
+
+            case os::driver::serial::Control::abort_send:
+              return Driver_P->Control (ARM_USART_ABORT_SEND, 0);
+
+            case os::driver::serial::Control::abort_receive:
+              return Driver_P->Control (ARM_USART_ABORT_RECEIVE, 0);
+
+            case os::driver::serial::Control::abort_transfer:
+              return Driver_P->Control (ARM_USART_ABORT_TRANSFER, 0);
+            }
+          return ARM_DRIVER_ERROR_UNSUPPORTED;
+        }
+
+      template<ARM_DRIVER_USART* Driver_P, send_chain_t Chain_P,
+          std::size_t Segments_P>
+        inline os::driver::return_t
+        Usart_direct_wrapper<Driver_P, Chain_P, Segments_P>::control_modem_line (
+            os::driver::serial::Modem_control ctrl)
+        {
+          switch (ctrl)
+            {
+            case os::driver::serial::Modem_control::deactivate_rts:
+              return Driver_P->SetModemControl (ARM_USART_RTS_CLEAR);
+
+            case os::driver::serial::Modem_control::activate_rts:
+              return Driver_P->SetModemControl (ARM_USART_RTS_SET);
+
+            case os::driver::serial::Modem_control::deactivate_dtr:
+              return Driver_P->SetModemControl (ARM_USART_DTR_CLEAR);
+
+            case os::driver::serial::Modem_control::activate_dtr:
+              return Driver_P->SetModemControl (ARM_USART_DTR_SET);
+            }
+          return ARM_DRIVER_ERROR_UNSUPPORTED;
+        }
+
+    } /* namespace driver */
+  } /* namespace cmsis */
+} /* namespace os */
+
+#endif /* CMSIS_DRIVER_USART_DIRECT_WRAPPER_H_ */
@@ -54,7 +54,11 @@ namespace os
 
         // --------------------------------------------------------------------
 
-        Usart_wrapper (ARM_DRIVER_USART* driver);
+        // For the drivers of the controllers with linked-list DMA, the
+        // vendor send_chain function and its maximum number of segments.
+        Usart_wrapper (ARM_DRIVER_USART* driver,
+                       send_chain_t send_chain = nullptr,
+                       uint32_t send_segments_max = 0);
 
         virtual
         ~Usart_wrapper ();
@@ -76,6 +80,12 @@ namespace os
         virtual int32_t
         send (const void* data, uint32_t num) override;
 
+        virtual uint32_t
+        get_send_segments_max (void) override;
+
+        virtual int32_t
+        send_chain (const struct iovec* iov, int iovcnt) override;
+
         virtual int32_t
         receive (void* data, uint32_t num) override;
 
@@ -110,6 +120,9 @@ namespace os
       private:
 
         ARM_DRIVER_USART* driver_;
+
+        send_chain_t send_chain_;
+        uint32_t send_segments_max_;
       };
 
     } /* namespace driver */
@@ -0,0 +1,132 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef POSIX_DRIVERS_CRC_H_
+#define POSIX_DRIVERS_CRC_H_
+
+#include <cstdint>
+#include <cstddef>
+
+// ----------------------------------------------------------------------------
+
+// Streaming checksums, updated while the bytes are copied into or out
+// of the circular buffers, so that the data is touched only once.
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    // The interface of the checksum backends. A backend for a hardware
+    // CRC unit derives from it and feeds the unit in copy().
+    class Checksum
+    {
+    public:
+
+      virtual void
+      reset (void) = 0;
+
+      // Update the checksum with the bytes.
+      virtual void
+      update (const uint8_t* buf, std::size_t len) = 0;
+
+      // Copy the bytes and update the checksum with them,
+      // in a single pass.
+      virtual void
+      copy (uint8_t* dst, const uint8_t* src, std::size_t len) = 0;
+
+      // The checksum of the bytes since reset().
+      virtual uint32_t
+      value (void) const = 0;
+
+    protected:
+
+      ~Checksum () = default;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // CRC-16/CCITT, polynomial 0x1021, not reflected, table driven;
+    // the initial value is 0xFFFF (CCITT-FALSE) or 0 (XMODEM).
+    class Crc16_ccitt final : public Checksum
+    {
+    public:
+
+      Crc16_ccitt (uint16_t init = 0xFFFF);
+
+      virtual void
+      reset (void) override;
+
+      virtual void
+      update (const uint8_t* buf, std::size_t len) override;
+
+      virtual void
+      copy (uint8_t* dst, const uint8_t* src, std::size_t len) override;
+
+      virtual uint32_t
+      value (void) const override;
+
+    private:
+
+      uint16_t const init_;
+      uint16_t crc_;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // CRC-32 (IEEE 802.3), polynomial 0x04C11DB7, reflected,
+    // table driven.
+    class Crc32 final : public Checksum
+    {
+    public:
+
+      Crc32 ();
+
+      virtual void
+      reset (void) override;
+
+      virtual void
+      update (const uint8_t* buf, std::size_t len) override;
+
+      virtual void
+      copy (uint8_t* dst, const uint8_t* src, std::size_t len) override;
+
+      virtual uint32_t
+      value (void) const override;
+
+    private:
+
+      // Not inverted.
+      uint32_t crc_;
+    };
+
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* POSIX_DRIVERS_CRC_H_ */
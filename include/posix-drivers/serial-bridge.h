@@ -0,0 +1,117 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef POSIX_DRIVERS_SERIAL_BRIDGE_H_
+#define POSIX_DRIVERS_SERIAL_BRIDGE_H_
+
+// ----------------------------------------------------------------------------
+
+#include <cstddef>
+#include <cstdint>
+
+// ----------------------------------------------------------------------------
+
+// Forward the bytes received by a serial device directly to another
+// one, from the ISR, without a thread and without a user buffer; used
+// for example for UART to USB CDC bridges.
+//
+// The received bytes are copied from the receive buffer of the source
+// straight to the transmit buffer of the sink. When the sink has no
+// space, they stay in the source receive buffer (and the source flow
+// control, if any, throttles the sender); the sink pulls them when its
+// transmission makes space.
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    // Implemented by the devices that can be bridged.
+    class Serial_bridgeable
+    {
+    public:
+
+      // Forward the received bytes to the sink, instead of returning
+      // them to read(); nullptr stops. Both devices must be open, the
+      // sink must have a transmit buffer and the source must not use a
+      // framing mode. Return 0, or -1 and errno.
+      virtual int
+      set_bridge_sink (Serial_bridgeable* sink) = 0;
+
+      // Called by set_bridge_sink() of the source; nullptr when
+      // detached. Return 0, or -1 and errno.
+      virtual int
+      set_bridge_source (Serial_bridgeable* source) = 0;
+
+      // Called by the source, usually from its ISR; copy up to nbyte
+      // bytes to the transmit buffer and start the transmission.
+      // Return the number of bytes taken.
+      virtual std::size_t
+      bridge_push (const uint8_t* buf, std::size_t nbyte) = 0;
+
+      // Called by the sink, usually from its ISR, when there is space
+      // in its transmit buffer; forward the bytes received meanwhile.
+      virtual void
+      bridge_pull (void) = 0;
+
+    protected:
+
+      ~Serial_bridgeable () = default;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // Bridge the two devices in both directions. Return 0, or -1 and
+    // errno, with no bridge set.
+    inline int
+    bridge_serial (Serial_bridgeable& a, Serial_bridgeable& b)
+    {
+      if (a.set_bridge_sink (&b) != 0)
+        {
+          return -1;
+        }
+      if (b.set_bridge_sink (&a) != 0)
+        {
+          a.set_bridge_sink (nullptr);
+          return -1;
+        }
+      return 0;
+    }
+
+    // Stop the bridge in both directions.
+    inline void
+    unbridge_serial (Serial_bridgeable& a, Serial_bridgeable& b)
+    {
+      a.set_bridge_sink (nullptr);
+      b.set_bridge_sink (nullptr);
+    }
+
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* POSIX_DRIVERS_SERIAL_BRIDGE_H_ */
@@ -0,0 +1,70 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef POSIX_DRIVERS_SERIAL_EVENT_H_
+#define POSIX_DRIVERS_SERIAL_EVENT_H_
+
+// ----------------------------------------------------------------------------
+
+#include <cstdint>
+
+// ----------------------------------------------------------------------------
+
+// Serial events not defined by CMSIS, raised by the drivers that can
+// report the progress of a reception before it completes.
+//
+// ARM_USART_EVENT_RX_PROGRESS: more bytes were received, the receive
+// is still active; get_rx_count() tells how many. Signalled by the DMA
+// half-transfer interrupt, or by a periodic update of the count, so
+// the bytes reach the readers without waiting for the end of a long
+// DMA window or for the line to become idle.
+//
+// The CMSIS events use the bits 0-13; the C drivers can raise this one
+// with the same value.
+#if !defined(ARM_USART_EVENT_RX_PROGRESS)
+#define ARM_USART_EVENT_RX_PROGRESS (1UL << 14)
+#endif
+
+#if defined(__cplusplus)
+
+namespace os
+{
+  namespace dev
+  {
+    namespace serial_event
+    {
+      // The same as ARM_USART_EVENT_RX_PROGRESS, next to the
+      // os::driver::serial::Event bits.
+      constexpr uint32_t rx_progress = ARM_USART_EVENT_RX_PROGRESS;
+
+    } /* namespace serial_event */
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* defined(__cplusplus) */
+
+#endif /* POSIX_DRIVERS_SERIAL_EVENT_H_ */
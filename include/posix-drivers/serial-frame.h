@@ -0,0 +1,167 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef POSIX_DRIVERS_SERIAL_FRAME_H_
+#define POSIX_DRIVERS_SERIAL_FRAME_H_
+
+// ----------------------------------------------------------------------------
+
+#include <posix-drivers/serial-ioctl.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// ----------------------------------------------------------------------------
+
+// Encoding and decoding of the frames used by the framed receive mode,
+// see serial_ioctl::Rx_framing_mode.
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    namespace serial_frame
+    {
+      // SLIP special characters, RFC 1055.
+      constexpr uint8_t slip_end = 0xC0;
+      constexpr uint8_t slip_esc = 0xDB;
+      constexpr uint8_t slip_esc_end = 0xDC;
+      constexpr uint8_t slip_esc_esc = 0xDD;
+
+      // Return the byte that ends the frames in the given mode;
+      // meaningful only for the modes with an end delimiter.
+      uint8_t
+      get_end_delimiter (int mode, uint8_t delimiter);
+
+      // Encode the bytes as one SLIP frame, with the END before and
+      // after; return the encoded length, or 0 if it does not fit.
+      std::size_t
+      slip_encode (const uint8_t* src, std::size_t len, uint8_t* dst,
+                   std::size_t size);
+
+      // Encode the bytes as one COBS frame, with the 0x00 end; return
+      // the encoded length, or 0 if it does not fit.
+      std::size_t
+      cobs_encode (const uint8_t* src, std::size_t len, uint8_t* dst,
+                   std::size_t size);
+
+    } /* namespace serial_frame */
+
+    // ------------------------------------------------------------------------
+
+    // Decode one frame, possibly given in several segments (for example
+    // the two segments of a circular buffer); the end delimiters are
+    // dropped. The bytes beyond the destination size are lost.
+    class Serial_frame_decoder
+    {
+    public:
+
+      Serial_frame_decoder (int mode, uint8_t delimiter, uint8_t* buf,
+                            std::size_t size);
+
+      Serial_frame_decoder (const Serial_frame_decoder&) = delete;
+
+      Serial_frame_decoder&
+      operator= (const Serial_frame_decoder&) = delete;
+
+      void
+      decode (const uint8_t* src, std::size_t len);
+
+      // The number of decoded bytes stored in the destination.
+      std::size_t
+      length (void) const;
+
+      // More bytes than the destination size were decoded.
+      bool
+      is_truncated (void) const;
+
+      // Invalid escape (SLIP) or incomplete block (COBS).
+      bool
+      is_malformed (void) const;
+
+    private:
+
+      void
+      store (uint8_t c);
+
+      uint8_t* const buf_;
+      std::size_t const size_;
+      std::size_t len_ = 0;
+
+      int const mode_;
+      uint8_t const delimiter_;
+
+      // COBS, the bytes remaining in the current block, and whether
+      // a zero follows it.
+      uint8_t cobs_remaining_ = 0;
+      bool cobs_zero_ = false;
+
+      bool slip_escaped_ = false;
+      bool truncated_ = false;
+      bool malformed_ = false;
+    };
+
+    // ------------------------------------------------------------------------
+
+    inline std::size_t
+    Serial_frame_decoder::length (void) const
+    {
+      return len_;
+    }
+
+    inline bool
+    Serial_frame_decoder::is_truncated (void) const
+    {
+      return truncated_;
+    }
+
+    inline bool
+    Serial_frame_decoder::is_malformed (void) const
+    {
+      return malformed_ || slip_escaped_ || (cobs_remaining_ != 0);
+    }
+
+    inline void
+    Serial_frame_decoder::store (uint8_t c)
+    {
+      if (len_ < size_)
+        {
+          buf_[len_++] = c;
+        }
+      else
+        {
+          truncated_ = true;
+        }
+    }
+
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* POSIX_DRIVERS_SERIAL_FRAME_H_ */
@@ -0,0 +1,333 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef POSIX_DRIVERS_SERIAL_IOCTL_H_
+#define POSIX_DRIVERS_SERIAL_IOCTL_H_
+
+// ----------------------------------------------------------------------------
+
+#include <cmsis-plus/rtos/os.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// ----------------------------------------------------------------------------
+
+// Definitions for the ioctl() requests understood by the serial devices,
+// in the spirit of the termios tcgetattr()/tcsetattr() calls.
+
+namespace os
+{
+  namespace dev
+  {
+    namespace serial_ioctl
+    {
+      // ----------------------------------------------------------------------
+
+      enum Request
+        : int
+          {
+            // Set the receive wake-up conditions.
+            // Argument: const Rx_threshold*.
+            set_rx_threshold = 1,
+
+            // Get the receive wake-up conditions.
+            // Argument: Rx_threshold*.
+            get_rx_threshold,
+
+            // Set the flow control, as a combination of Flow_control bits.
+            // Argument: int.
+            set_flow_control,
+
+            // Get the flow control.
+            // Argument: int*.
+            get_flow_control,
+
+            // Reconfigure the line; on an open device, wait for the
+            // transmit buffer to drain, but keep the received bytes.
+            // Fails like drain(), with the old configuration kept,
+            // for example with EAGAIN if O_NONBLOCK.
+            // Argument: const Line_config*.
+            set_line_config,
+
+            // Get the line configuration.
+            // Argument: Line_config*.
+            get_line_config,
+
+            // Set the read()/write() timeouts.
+            // Argument: const Timeouts*.
+            set_timeouts,
+
+            // Get the read()/write() timeouts.
+            // Argument: Timeouts*.
+            get_timeouts,
+
+            // Set the transmit coalescing.
+            // Argument: const Tx_coalesce*.
+            set_tx_coalesce,
+
+            // Get the transmit coalescing.
+            // Argument: Tx_coalesce*.
+            get_tx_coalesce,
+
+            // Send the buffered bytes and wait for the transmission to
+            // complete, like tcdrain(); fails with EAGAIN if
+            // O_NONBLOCK, or ETIMEDOUT after the transmit timeout.
+            // No argument.
+            drain,
+
+            // Get the statistics; fails with ENOSYS if not enabled.
+            // Argument: Statistics*.
+            get_statistics,
+
+            // Reset the statistics.
+            // No argument.
+            reset_statistics,
+
+            // Set the receive framing; only on a closed device, and
+            // not with pooled buffers.
+            // Argument: const Rx_framing*.
+            set_rx_framing,
+
+            // Get the receive framing.
+            // Argument: Rx_framing*.
+            get_rx_framing,
+
+            // Set the idle power policy.
+            // Argument: const Power_policy*.
+            set_power_policy,
+
+            // Get the idle power policy.
+            // Argument: Power_policy*.
+            get_power_policy,
+      };
+
+      // When set in the open() flags, a third open() argument,
+      // a const Line_config*, is used instead of the default
+      // configuration (115200 bps 8N1, no flow control).
+      constexpr int oflag_line_config = 0x40000000;
+
+      // Flow control performed by the device, driven by the receive
+      // buffer water marks; the bits can be combined.
+      enum Flow_control
+        : int
+          {
+            flow_none = 0,
+
+            // Deactivate RTS when the receive buffer goes above the high
+            // water mark, activate it again below the low water mark.
+            flow_rts = 1 << 0,
+
+            // Pause the transmission while CTS is not active.
+            // Requires a transmit buffer.
+            flow_cts = 1 << 1,
+
+            flow_rts_cts = flow_rts | flow_cts,
+
+            // Send XOFF/XON at the same water marks, and pause the
+            // transmission after receiving XOFF, until XON.
+            // Requires a transmit buffer.
+            flow_xon_xoff = 1 << 2,
+      };
+
+      constexpr uint8_t xon = 0x11; // DC1
+      constexpr uint8_t xoff = 0x13; // DC3
+
+      // Similar to the termios c_cflag/speed.
+      struct Line_config
+      {
+        // Bits per second.
+        uint32_t baud_rate;
+
+        // The mode bits passed to the driver configuration; define
+        // the framing (data bits, parity, stop bits) and the flow
+        // control performed by the hardware, if any.
+        uint32_t mode;
+
+        // The flow control performed by the device, Flow_control bits.
+        int flow_control;
+      };
+
+      // ----------------------------------------------------------------------
+
+      // Similar to the termios VMIN/VTIME.
+      struct Rx_threshold
+      {
+        // A blocked read() is woken up only when this number of bytes
+        // is in the receive buffer (or the requested number,
+        // if smaller); must be at least 1.
+        std::size_t min_count;
+
+        // If not 0, once some bytes were received, read() returns
+        // the available bytes when no new bytes arrive for this
+        // duration, in clock ticks. The driver rx_timeout (idle line)
+        // event also wakes up the reader.
+        os::rtos::clock::duration_t gap_timeout;
+      };
+
+      // The longest time, in clock ticks, a blocking call waits for
+      // the device to make progress; 0 waits forever. When expired,
+      // the call returns the bytes already transferred, if any,
+      // otherwise fails with ETIMEDOUT.
+      struct Timeouts
+      {
+        // For read() and rx_peek().
+        os::rtos::clock::duration_t rx_timeout;
+
+        // For write(), writev(), tx_reserve() and drain().
+        os::rtos::clock::duration_t tx_timeout;
+      };
+
+      // Hold small writes in the transmit buffer, to send them with
+      // fewer, larger transfers.
+      struct Tx_coalesce
+      {
+        // The transmission is started only when this number of bytes
+        // is in the buffer (or the buffer is above the high water
+        // mark); 0 or 1 disables coalescing.
+        std::size_t min_count;
+
+        // If not 0, the bytes held are sent anyway at most this
+        // duration after the first one, in clock ticks; otherwise
+        // only drain() sends them.
+        os::rtos::clock::duration_t flush_timeout;
+      };
+
+      // How the received bytes are split into frames; in a framing
+      // mode, each read() returns one frame, decoded, without the end
+      // delimiter. The boundaries are detected in the ISR.
+      enum Rx_framing_mode
+        : int
+          {
+            // No frames, read() returns the available bytes.
+            framing_none = 0,
+
+            // A frame ends when the line becomes idle (the driver
+            // rx_timeout event).
+            framing_idle,
+
+            // A frame ends with the delimiter byte.
+            framing_delimiter,
+
+            // SLIP (RFC 1055); a frame ends with END (0xC0), the
+            // escaped bytes are decoded.
+            framing_slip,
+
+            // COBS; a frame ends with 0x00, the bytes are decoded.
+            framing_cobs,
+      };
+
+      struct Rx_framing
+      {
+        // One of Rx_framing_mode.
+        int mode;
+
+        // The end of frame byte, for framing_delimiter.
+        uint8_t delimiter;
+      };
+
+      // Lower the power of an open device while the line is quiet,
+      // to let the system sleep.
+      struct Power_policy
+      {
+        // If not 0, after no bytes were sent or received for this
+        // duration (up to twice it), in clock ticks, the driver is
+        // set to Power::low; the receive stays armed, to wake up on
+        // the start bit. The next write() or driver event restores
+        // Power::full. If the driver does not support Power::low,
+        // it stays at full power.
+        os::rtos::clock::duration_t idle_timeout;
+      };
+
+      // ----------------------------------------------------------------------
+
+      // Counters since open() or reset_statistics; maintained only if
+      // OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS is defined.
+      struct Statistics
+      {
+        // Bytes added to the receive buffer and sent by the driver.
+        std::size_t rx_bytes;
+        std::size_t tx_bytes;
+
+        // Received bytes lost because the receive buffer was full.
+        std::size_t rx_overruns;
+
+        // Events reported by the driver.
+        std::size_t rx_hw_overflows;
+        std::size_t rx_framing_errors;
+        std::size_t rx_parity_errors;
+        std::size_t rx_breaks;
+
+        // Transfers the driver refused to start outside write(), from
+        // the flush timer, a bridge or the ISR; the bytes stay queued.
+        std::size_t tx_errors;
+
+        // Receives the driver refused to start, from the ISR or after
+        // the reader freed space; the bytes are discarded, and
+        // counted as overruns, until a retry succeeds.
+        std::size_t rx_errors;
+
+        // The maximum length reached by the buffers.
+        std::size_t rx_max_length;
+        std::size_t tx_max_length;
+
+        // The number of times the rx/tx semaphores were posted.
+        std::size_t rx_wakeups;
+        std::size_t tx_wakeups;
+
+        // The number of driver callbacks, and the longest one, in
+        // OS_POSIX_DRIVERS_SERIAL_CYCLES() units (0 if not defined).
+        std::size_t isr_count;
+        uint32_t isr_max_cycles;
+
+        // With deferred dispatch, the driver callbacks that only
+        // recorded the event; the batches processed later are
+        // counted in isr_count.
+        std::size_t isr_deferred;
+
+        // Malformed frames, discarded, and frame boundaries lost
+        // because too many frames were pending (the frames merge).
+        std::size_t rx_frame_errors;
+        std::size_t rx_frame_overruns;
+
+        // The transitions to Power::low and back to Power::full, and
+        // the longest wake up (the driver power() call), in
+        // OS_POSIX_DRIVERS_SERIAL_CYCLES() units.
+        std::size_t power_low_entries;
+        std::size_t power_wakeups;
+        uint32_t power_wake_max_cycles;
+
+        // Wake ups refused by the driver; the device stays at low
+        // power and retries at the next access.
+        std::size_t power_wake_errors;
+      };
+
+    } /* namespace serial_ioctl */
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* POSIX_DRIVERS_SERIAL_IOCTL_H_ */
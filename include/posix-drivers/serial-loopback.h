@@ -0,0 +1,350 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef POSIX_DRIVERS_SERIAL_LOOPBACK_H_
+#define POSIX_DRIVERS_SERIAL_LOOPBACK_H_
+
+// ----------------------------------------------------------------------------
+
+// For host builds only; it needs the standard threads.
+#if !defined(__ARM_EABI__)
+
+#include <cmsis-plus/drivers/serial.h>
+#include <posix-drivers/serial-event.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <sys/uio.h>
+
+// ----------------------------------------------------------------------------
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    // A simulated serial driver, with the transmit line connected to the
+    // receive line, to test and measure the serial devices off-target.
+    //
+    // A host thread plays the role of the DMA and of the interrupt: at
+    // each tick it moves the bytes due at the configured baud rate
+    // (10 bits per character, as for 8N1), from the send() buffer to
+    // the receive() buffer, and calls the callback, like an ISR, with
+    // send_complete/tx_complete, receive_complete, rx_timeout (after
+    // the line was idle for a few characters) and rx_overflow (bytes
+    // arrived while no receive was armed; they are dropped). If enabled,
+    // it also signals serial_event::rx_progress when a receive is half
+    // full, as the DMA half-transfer interrupt.
+    //
+    // The modem lines are looped back too, as by a loopback plug: RTS
+    // drives CTS and DTR drives DSR; a change of RTS is signalled as
+    // Event::cts at the next tick, for the hardware flow control.
+    //
+    // It also implements get_send_segments_max() and send_chain(), to
+    // send several segments as one transfer, as the drivers of the
+    // controllers with linked-list DMA do; to use it, instantiate the
+    // device with Serial_loopback as the driver type.
+    //
+    // The device using it must be instantiated with
+    // Serial_loopback::Critical_section, which excludes the thread,
+    // as disabling the interrupts does on target.
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+
+    class Serial_loopback : public os::driver::Serial
+    {
+    public:
+
+      class Critical_section
+      {
+      public:
+
+        // One mutex for all the loopback drivers, so it can protect
+        // a pool shared by several devices.
+        static constexpr bool isGlobal = true;
+
+        inline
+        Critical_section ()
+        {
+          mutex ().lock ();
+        }
+
+        inline
+        ~Critical_section ()
+        {
+          mutex ().unlock ();
+        }
+      };
+
+      // The tick is the thread period, in microseconds; the bytes due
+      // are moved in bursts, one per tick.
+      Serial_loopback (uint32_t tick_us = 100);
+
+      Serial_loopback (const Serial_loopback&) = delete;
+
+      Serial_loopback&
+      operator= (const Serial_loopback&) = delete;
+
+      virtual
+      ~Serial_loopback ();
+
+      // ----------------------------------------------------------------------
+
+      // When not paced, all the pending bytes are moved at each tick,
+      // regardless of the baud rate.
+      void
+      set_paced (bool paced);
+
+      // The line is reported idle (rx_timeout) after this number of
+      // character times without bytes.
+      void
+      set_rx_idle_chars (uint32_t chars);
+
+      // Signal serial_event::rx_progress when half of the receive
+      // buffer is filled.
+      void
+      set_rx_progress (bool enabled);
+
+      // The maximum number of segments accepted by send_chain(),
+      // up to max_chain_segments; with 0, send_chain() always fails with
+      // ERROR_UNSUPPORTED, as for a controller without linked-list DMA.
+      // The device reads it at open().
+      void
+      set_send_chain_max (int segments);
+
+      static constexpr int max_chain_segments = 4;
+
+      // The next count calls to send() fail with ERROR, as for a
+      // controller that refuses the transfer; to exercise the
+      // error paths of the device.
+      void
+      set_send_errors (std::size_t count);
+
+      // The next count calls to receive() fail with ERROR, leaving
+      // the previous receive, if any, as it was.
+      void
+      set_receive_errors (std::size_t count);
+
+      // The next count calls to power(Power::full) fail with ERROR,
+      // as for a controller that does not wake up.
+      void
+      set_power_errors (std::size_t count);
+
+      // The state set by power(); Power::low keeps the line working,
+      // as a wake-up capable controller does, but the sends issued at
+      // low power are counted.
+      os::driver::Power
+      get_power (void);
+
+      // The value set by set_send_chain_max().
+      std::size_t
+      get_send_segments_max (void);
+
+      // Send all the segments as one transfer, with a single
+      // send_complete/tx_complete.
+      os::driver::return_t
+      send_chain (const struct iovec* iov, int iovcnt);
+
+      // The state of the RTS line, as set by control_modem_line().
+      bool
+      is_rts_active (void);
+
+      // The carrier detect line, not wired by the loopback plug; once
+      // set, the driver reports the DCD capability, and a change is
+      // signalled as Event::dcd at the next tick.
+      void
+      set_dcd (bool active);
+
+      // Counters since construction or reset_counters().
+      struct Counters
+      {
+        // Bytes moved to the receive buffer, and dropped.
+        std::size_t rx_bytes;
+        std::size_t rx_dropped;
+
+        // Calls to send() and receive().
+        std::size_t sends;
+        std::size_t receives;
+
+        // Successful calls to send_chain(), also counted as sends.
+        std::size_t chained_sends;
+
+        // Calls to power() changing the state, and sends started
+        // while at Power::low.
+        std::size_t power_changes;
+        std::size_t low_power_sends;
+
+        // Calls to the callback.
+        std::size_t callbacks;
+
+        // Changes of the RTS line.
+        std::size_t rts_changes;
+      };
+
+      Counters
+      get_counters (void);
+
+      void
+      reset_counters (void);
+
+      // ----------------------------------------------------------------------
+
+    protected:
+
+      virtual os::driver::serial::Capabilities&
+      do_get_capabilities (void) override;
+
+      virtual os::driver::return_t
+      do_power (os::driver::Power state) override;
+
+      virtual os::driver::return_t
+      do_send (const void* data, std::size_t num) override;
+
+      virtual os::driver::return_t
+      do_receive (void* data, std::size_t num) override;
+
+      virtual std::size_t
+      do_get_tx_count (void) override;
+
+      virtual std::size_t
+      do_get_rx_count (void) override;
+
+      virtual os::driver::return_t
+      do_configure (os::driver::serial::config_t cfg,
+                    os::driver::serial::config_arg_t arg) override;
+
+      virtual os::driver::return_t
+      do_control (os::driver::serial::Control ctrl) override;
+
+      virtual os::driver::serial::Status
+      do_get_status (void) override;
+
+      virtual os::driver::return_t
+      do_control_modem_line (os::driver::serial::Modem_control ctrl)
+          override;
+
+      virtual os::driver::serial::Modem_status
+      do_get_modem_status (void) override;
+
+      // ----------------------------------------------------------------------
+
+    private:
+
+      // Shared by all instances, like the interrupts.
+      static std::recursive_mutex&
+      mutex (void);
+
+      void
+      run (void);
+
+      // Called with the mutex locked; move up to count bytes, calling
+      // the callback, return the number of bytes sent.
+      std::size_t
+      move (std::size_t count);
+
+      void
+      signal (os::driver::event_t event);
+
+      // Called with the mutex locked.
+      bool
+      is_tx_busy (void) const;
+
+      // Called with the mutex locked; when the current segment is done,
+      // continue with the next non empty one of the chain, if any.
+      void
+      load_chain_segment (void);
+
+      // ----------------------------------------------------------------------
+
+      os::driver::serial::Capabilities capabilities_
+        { };
+
+      const uint8_t* tx_buf_ = nullptr;
+      std::size_t tx_size_ = 0;
+      std::size_t tx_count_ = 0;
+
+      // The send_chain() segments, the next one to send, and the bytes
+      // of the segments already sent.
+      struct iovec tx_chain_[max_chain_segments];
+      int tx_chain_size_ = 0;
+      int tx_chain_next_ = 0;
+      std::size_t tx_chain_done_ = 0;
+      int send_chain_max_ = max_chain_segments;
+      std::size_t send_errors_ = 0;
+      std::size_t receive_errors_ = 0;
+      std::size_t power_errors_ = 0;
+
+      uint8_t* rx_buf_ = nullptr;
+      std::size_t rx_size_ = 0;
+      std::size_t rx_count_ = 0;
+      // The count when the bytes were last reported.
+      std::size_t rx_reported_ = 0;
+
+      uint32_t baud_rate_ = 115200;
+      uint32_t rx_idle_chars_ = 2;
+      // In nanoseconds, accumulated while the line is idle.
+      uint64_t rx_idle_time_ = 0;
+      // In nanoseconds, not yet used to move bytes.
+      uint64_t credit_ = 0;
+
+      Counters counters_
+        { };
+
+      os::driver::Power power_ = os::driver::Power::full;
+
+      bool rts_ = false;
+      bool dtr_ = false;
+      bool dcd_ = false;
+      // Modem line events to signal at the next tick.
+      os::driver::event_t modem_events_ = 0;
+
+      uint32_t const tick_us_;
+
+      bool paced_ = true;
+      bool rx_progress_ = false;
+      bool tx_enabled_ = false;
+      bool rx_enabled_ = false;
+
+      std::atomic<bool> exit_
+        { false };
+      std::thread thread_;
+    };
+
+#pragma GCC diagnostic pop
+
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* !defined(__ARM_EABI__) */
+
+#endif /* POSIX_DRIVERS_SERIAL_LOOPBACK_H_ */
@@ -0,0 +1,138 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef POSIX_DRIVERS_SERIAL_POLL_H_
+#define POSIX_DRIVERS_SERIAL_POLL_H_
+
+// ----------------------------------------------------------------------------
+
+#include <cmsis-plus/rtos/os.h>
+
+#include <cstddef>
+
+// ----------------------------------------------------------------------------
+
+// Readiness multiplexing, in the spirit of poll(), so that a single
+// thread can service many serial devices.
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    namespace serial_poll
+    {
+      enum Events
+        : unsigned int
+          {
+            // Bytes can be read without blocking.
+            in = 1 << 0,
+
+            // Bytes can be written without blocking.
+            out = 1 << 1,
+
+            // Disconnected; always reported.
+            hangup = 1 << 2,
+      };
+    } /* namespace serial_poll */
+
+    // ------------------------------------------------------------------------
+
+    // Shared by all devices waited for by a thread; posted by the
+    // devices, usually from the ISR, when they might have become ready.
+    class Serial_poll_event
+    {
+    public:
+
+      Serial_poll_event (const char* name);
+
+      Serial_poll_event (const Serial_poll_event&) = delete;
+
+      Serial_poll_event&
+      operator= (const Serial_poll_event&) = delete;
+
+      void
+      post (void);
+
+      // Wait for a post, the timeout is in clock ticks, 0 waits
+      // forever; return 0 or ETIMEDOUT.
+      int
+      wait (os::rtos::clock::duration_t timeout);
+
+    private:
+
+      os::rtos::semaphore_binary sem_;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // Implemented by the devices that can be polled.
+    class Serial_pollable
+    {
+    public:
+
+      // Post the event when the device might have become ready;
+      // nullptr to stop.
+      virtual void
+      set_poll_event (Serial_poll_event* event) = 0;
+
+      // Return the current serial_poll::Events, without blocking.
+      virtual unsigned int
+      get_poll_events (void) = 0;
+
+    protected:
+
+      ~Serial_pollable () = default;
+    };
+
+    // ------------------------------------------------------------------------
+
+    struct Serial_pollfd
+    {
+      Serial_pollable* device;
+
+      // The requested serial_poll::Events.
+      unsigned int events;
+
+      // The returned serial_poll::Events.
+      unsigned int revents;
+    };
+
+    // Similar to poll(); the devices must have been given the same event
+    // with set_poll_event(). Return the number of ready devices, or 0
+    // after waiting for the timeout without any device becoming ready.
+    int
+    poll_serial (Serial_pollfd* fds, std::size_t nfds,
+                 Serial_poll_event& event,
+                 os::rtos::clock::duration_t timeout);
+
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* POSIX_DRIVERS_SERIAL_POLL_H_ */
@@ -0,0 +1,181 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef POSIX_DRIVERS_SERIAL_TRACE_H_
+#define POSIX_DRIVERS_SERIAL_TRACE_H_
+
+// ----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+// ----------------------------------------------------------------------------
+
+// Define OS_POSIX_DRIVERS_SERIAL_CYCLES() to read a free running cycle
+// counter, like the Cortex-M DWT->CYCCNT; it is used for the trace
+// timestamps and for the ISR duration in the statistics.
+#if !defined(OS_POSIX_DRIVERS_SERIAL_CYCLES)
+#define OS_POSIX_DRIVERS_SERIAL_CYCLES() (static_cast<uint32_t> (0))
+#endif
+
+// Define OS_INCLUDE_POSIX_DRIVERS_SERIAL_TRACE to record the serial
+// device events in a trace ring; by default the hooks are compiled out.
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_TRACE)
+#define OS_POSIX_DRIVERS_SERIAL_TRACE(device, point, arg) \
+  os::dev::serial_trace::record ((device), (point), (arg))
+#else
+#define OS_POSIX_DRIVERS_SERIAL_TRACE(device, point, arg) \
+  do { (void) (device); (void) (point); (void) (arg); } while (false)
+#endif
+
+// The number of records kept, must be a power of 2.
+#if !defined(OS_INTEGER_POSIX_DRIVERS_SERIAL_TRACE_SIZE)
+#define OS_INTEGER_POSIX_DRIVERS_SERIAL_TRACE_SIZE (64)
+#endif
+
+namespace os
+{
+  namespace dev
+  {
+    namespace serial_trace
+    {
+      // ----------------------------------------------------------------------
+
+      enum Point
+        : uint16_t
+          {
+            // Driver callback; the argument is the event.
+            isr_enter,
+            isr_exit,
+
+            // Driver calls; the argument is the number of bytes.
+            send,
+            receive,
+
+            // The argument is the number of bytes in the buffer.
+            rx_post,
+            tx_post,
+
+            // Before and after blocking; the argument is the timeout.
+            rx_wait,
+            rx_wakeup,
+            tx_wait,
+            tx_wakeup,
+
+            // Bytes handed to the application; the argument is the count.
+            read_return,
+
+            points_count
+      };
+
+      struct Record
+      {
+        uint32_t cycles;
+        const void* device;
+        uint32_t arg;
+        Point point;
+      };
+
+      static constexpr std::size_t size =
+      OS_INTEGER_POSIX_DRIVERS_SERIAL_TRACE_SIZE;
+
+      static_assert((size > 0) && ((size & (size - 1)) == 0),
+          "The trace size must be a power of 2.");
+
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_TRACE)
+
+      // The ring is shared by all devices, ISRs and threads; each
+      // record reserves a slot with an atomic increment, and when
+      // full, overwrites the oldest record.
+      extern Record records[size];
+
+#if defined(__ARM_ARCH_6M__)
+
+      // ARMv6-M (Cortex-M0/M0+) has no exclusive accesses, and the
+      // atomic increment would be a call to __atomic_fetch_add_4(),
+      // not provided by newlib; mask the interrupts around it.
+      extern uint32_t volatile next;
+
+      inline uint32_t
+      reserve (void)
+      {
+        uint32_t primask;
+        asm volatile ("mrs %0, primask" : "=r" (primask));
+        asm volatile ("cpsid i" : : : "memory");
+        uint32_t idx = next;
+        next = idx + 1;
+        asm volatile ("msr primask, %0" : : "r" (primask) : "memory");
+        return idx;
+      }
+
+#else
+
+      extern std::atomic<uint32_t> next;
+
+      inline uint32_t
+      reserve (void)
+      {
+        return next.fetch_add (1, std::memory_order_relaxed);
+      }
+
+#endif /* defined(__ARM_ARCH_6M__) */
+
+      // ----------------------------------------------------------------------
+
+      inline void
+      record (const void* device, Point point, uint32_t arg)
+      {
+        uint32_t cycles = OS_POSIX_DRIVERS_SERIAL_CYCLES ();
+        uint32_t idx = reserve ();
+
+        Record& r = records[idx & (size - 1)];
+        r.cycles = cycles;
+        r.device = device;
+        r.arg = arg;
+        r.point = point;
+      }
+
+      // Discard all records.
+      void
+      clear (void);
+
+      // Print the records, oldest first, with the cycles elapsed since
+      // the previous record, via os::trace. Should be called when the
+      // devices are quiet, the records being written meanwhile might be
+      // inconsistent.
+      void
+      dump (void);
+
+#endif /* defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_TRACE) */
+
+    } /* namespace serial_trace */
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* POSIX_DRIVERS_SERIAL_TRACE_H_ */
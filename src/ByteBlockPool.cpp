@@ -0,0 +1,109 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "posix-drivers/ByteBlockPool.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cassert>
+
+// ----------------------------------------------------------------------------
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    constexpr ByteBlockPool::index_t ByteBlockPool::none;
+
+    ByteBlockPool::ByteBlockPool (uint8_t* storage, std::size_t blockSize,
+                                  std::size_t count, index_t* links) :
+        fStorage (storage), //
+        fBlockSize (blockSize), //
+        fCount (count), //
+        fLinks (links)
+    {
+      assert(storage != nullptr);
+      assert(links != nullptr);
+      assert(blockSize > 0);
+      assert(count < none);
+
+      // All blocks are free, in order.
+      for (std::size_t i = 0; i < fCount; ++i)
+        {
+          fLinks[i] =
+              (i + 1 < fCount) ? static_cast<index_t> (i + 1) : none;
+        }
+      fFree = (fCount > 0) ? 0 : none;
+      fFreeCount = fCount;
+      fMinFreeCount = fCount;
+    }
+
+    ByteBlockPool::index_t
+    ByteBlockPool::allocate (void)
+    {
+      index_t block = fFree;
+      if (block == none)
+        {
+          return none;
+        }
+
+      fFree = fLinks[block];
+      fLinks[block] = none;
+
+      std::size_t count = fFreeCount - 1;
+      fFreeCount = count;
+      if (count < fMinFreeCount)
+        {
+          fMinFreeCount = count;
+        }
+      return block;
+    }
+
+    void
+    ByteBlockPool::release (index_t block)
+    {
+      assert(block < fCount);
+
+      fLinks[block] = fFree;
+      fFree = block;
+      fFreeCount = fFreeCount + 1;
+    }
+
+    void
+    ByteBlockPool::dump (void)
+    {
+      os::trace::printf ("%s @%p {block=%u, count=%u, free=%u, min=%u}\n",
+                         __PRETTY_FUNCTION__, this,
+                         (unsigned int) fBlockSize, (unsigned int) fCount,
+                         (unsigned int) fFreeCount,
+                         (unsigned int) fMinFreeCount);
+    }
+
+  } /* namespace dev */
+} /* namespace os */
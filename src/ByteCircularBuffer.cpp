@@ -26,6 +26,8 @@
  */
 
 #include "posix-drivers/ByteCircularBuffer.h"
+#include "posix-drivers/byte-scan.h"
+#include "posix-drivers/crc.h"
 #include <cmsis-plus/diag/trace.h>
 
 #include <cstring>
@@ -65,8 +67,9 @@ namespace os
     void
     ByteCircularBuffer::clear (void)
     {
-      fBack = fFront = const_cast<uint8_t* volatile > (fBuf);
+      fBack = fFront = 0;
       fLen = 0;
+      fMaxLen = 0;
 #if defined(DEBUG)
       std::memset ((void*) fBuf, '?', fSize);
 #endif
@@ -75,19 +78,23 @@ namespace os
     std::size_t
     ByteCircularBuffer::pushBack (uint8_t c)
     {
-      if (isFull ())
+      std::size_t used = fLen;
+      if (used >= fSize)
         {
           return 0;
         }
 
       // Add to back.
-      *fBack++ = c;
-      if ((std::size_t) (fBack - fBuf) >= fSize)
+      std::size_t back = fBack;
+      data ()[back++] = c;
+      if (back >= fSize)
         {
           // Wrap.
-          fBack = const_cast<uint8_t* volatile > (fBuf);
+          back = 0;
         }
-      fLen++;
+      fBack = back;
+      fLen = used + 1;
+      updateMaxLength (used + 1);
       return 1;
     }
 
@@ -97,10 +104,56 @@ namespace os
     {
       assert(buf != nullptr);
 
+      // Read the volatile members only once.
+      std::size_t used = fLen;
       std::size_t len = count;
-      if (count > (fSize - fLen))
+      if (count > (fSize - used))
         {
-          len = fSize - fLen;
+          len = fSize - used;
+        }
+
+      if (len == 0)
+        {
+          return 0;
+        }
+
+      uint8_t* const storage = data ();
+      std::size_t back = fBack;
+      std::size_t sizeToEnd = fSize - back;
+      if (len <= sizeToEnd)
+        {
+          copy_bytes (storage + back, buf, len);
+          back += len;
+          if (back >= fSize)
+            {
+              // Wrap.
+              back = 0;
+            }
+        }
+      else
+        {
+          copy_bytes (storage + back, buf, sizeToEnd);
+          copy_bytes (storage, buf + sizeToEnd, len - sizeToEnd);
+          back = len - sizeToEnd;
+        }
+      fBack = back;
+      fLen = used + len;
+      updateMaxLength (used + len);
+      return len;
+    }
+
+    std::size_t
+    ByteCircularBuffer::pushBack (const uint8_t* buf, std::size_t count,
+                                  Checksum& sum)
+    {
+      assert(buf != nullptr);
+
+      // Read the volatile members only once.
+      std::size_t used = fLen;
+      std::size_t len = count;
+      if (count > (fSize - used))
+        {
+          len = fSize - used;
         }
 
       if (len == 0)
@@ -108,26 +161,27 @@ namespace os
           return 0;
         }
 
-      std::size_t sizeToEnd = (std::size_t) (fSize - (fBack - fBuf));
+      std::size_t back = fBack;
+      std::size_t sizeToEnd = fSize - back;
       if (len <= sizeToEnd)
         {
-          std::memcpy (fBack, buf, len);
-          fBack += len;
-          if ((std::size_t) (fBack - fBuf) >= fSize)
+          sum.copy (data () + back, buf, len);
+          back += len;
+          if (back >= fSize)
             {
               // Wrap.
-              fBack = const_cast<uint8_t* volatile > (fBuf);
+              back = 0;
             }
-          fLen += len;
         }
       else
         {
-          std::memcpy (fBack, buf, sizeToEnd);
-          fBack = const_cast<uint8_t* volatile > (fBuf);
-          std::memcpy (fBack, buf + sizeToEnd, len - sizeToEnd);
-          fBack += (len - sizeToEnd);
-          fLen += len;
+          sum.copy (data () + back, buf, sizeToEnd);
+          sum.copy (data (), buf + sizeToEnd, len - sizeToEnd);
+          back = len - sizeToEnd;
         }
+      fBack = back;
+      fLen = used + len;
+      updateMaxLength (used + len);
       return len;
     }
 
@@ -145,13 +199,15 @@ namespace os
           return 0;
         }
 
-      fBack += adjust;
-      if (fBack >= (fBuf + fSize))
+      std::size_t back = fBack + adjust;
+      if (back >= fSize)
         {
           // Wrap.
-          fBack -= fSize;
+          back -= fSize;
         }
+      fBack = back;
       fLen += adjust;
+      updateMaxLength ();
 
       return adjust;
     }
@@ -159,9 +215,9 @@ namespace os
     void
     ByteCircularBuffer::retreatBack (void)
     {
-      if (fBack == fBuf)
+      if (fBack == 0)
         {
-          fBack = (uint8_t*) (fBuf + fSize - 1);
+          fBack = fSize - 1;
         }
       else
         {
@@ -175,20 +231,21 @@ namespace os
     {
       assert(buf != nullptr);
 
-      uint8_t c;
-      if (fLen == 0)
+      std::size_t used = fLen;
+      if (used == 0)
         {
           return 0;
         }
       else
         {
-          c = *fFront++;
-          if ((std::size_t) (fFront - fBuf) >= fSize)
+          std::size_t front = fFront;
+          *buf = fBuf[front++];
+          if (front >= fSize)
             {
-              fFront = const_cast<uint8_t* volatile > (fBuf);
+              front = 0;
             }
-          fLen--;
-          *buf = c;
+          fFront = front;
+          fLen = used - 1;
           return 1;
         }
     }
@@ -198,31 +255,69 @@ namespace os
     {
       assert(buf != nullptr);
 
+      // Read the volatile members only once.
+      std::size_t used = fLen;
       std::size_t len = siz;
-      if (len > fLen)
+      if (len > used)
         {
-          len = fLen;
+          len = used;
         }
 
-      std::size_t sizeToEnd = fSize - (std::size_t) (fFront - fBuf);
+      std::size_t front = fFront;
+      std::size_t sizeToEnd = fSize - front;
       if (len <= sizeToEnd)
         {
-          std::memcpy (buf, fFront, len);
-          fFront += len;
-          if ((std::size_t) (fFront - fBuf) >= fSize)
+          copy_bytes (buf, fBuf + front, len);
+          front += len;
+          if (front >= fSize)
             {
-              fFront = const_cast<uint8_t* volatile > (fBuf);
+              front = 0;
             }
-          fLen -= len;
         }
       else
         {
-          std::memcpy (buf, fFront, sizeToEnd);
-          fFront = const_cast<uint8_t* volatile > (fBuf);
-          std::memcpy (buf + sizeToEnd, fFront, len - sizeToEnd);
-          fFront += (len - sizeToEnd);
-          fLen -= len;
+          copy_bytes (buf, fBuf + front, sizeToEnd);
+          copy_bytes (buf + sizeToEnd, fBuf, len - sizeToEnd);
+          front = len - sizeToEnd;
         }
+      fFront = front;
+      fLen = used - len;
+      return len;
+    }
+
+    std::size_t
+    ByteCircularBuffer::popFront (uint8_t* buf, std::size_t siz,
+                                  Checksum& sum)
+    {
+      assert(buf != nullptr);
+
+      // Read the volatile members only once.
+      std::size_t used = fLen;
+      std::size_t len = siz;
+      if (len > used)
+        {
+          len = used;
+        }
+
+      std::size_t front = fFront;
+      std::size_t sizeToEnd = fSize - front;
+      if (len <= sizeToEnd)
+        {
+          sum.copy (buf, fBuf + front, len);
+          front += len;
+          if (front >= fSize)
+            {
+              front = 0;
+            }
+        }
+      else
+        {
+          sum.copy (buf, fBuf + front, sizeToEnd);
+          sum.copy (buf + sizeToEnd, fBuf, len - sizeToEnd);
+          front = len - sizeToEnd;
+        }
+      fFront = front;
+      fLen = used - len;
       return len;
     }
 
@@ -240,12 +335,13 @@ namespace os
           adjust = fLen;
         }
 
-      fFront += adjust;
-      if (fFront >= (fBuf + fSize))
+      std::size_t front = fFront + adjust;
+      if (front >= fSize)
         {
           // Wrap.
-          fFront -= fSize;
+          front -= fSize;
         }
+      fFront = front;
       fLen -= adjust;
 
       return adjust;
@@ -255,9 +351,10 @@ namespace os
     ByteCircularBuffer::getFrontContiguousBuffer (uint8_t** ppbuf)
     {
       assert(ppbuf != nullptr);
-      *ppbuf = fFront;
+      std::size_t front = fFront;
+      *ppbuf = data () + front;
 
-      std::size_t sizeToEnd = fSize - (std::size_t) (fFront - fBuf);
+      std::size_t sizeToEnd = fSize - front;
       std::size_t len = sizeToEnd;
       if (len > fLen)
         {
@@ -271,9 +368,10 @@ namespace os
     ByteCircularBuffer::getBackContiguousBuffer (uint8_t** ppbuf)
     {
       assert(ppbuf != nullptr);
-      *ppbuf = fBack;
+      std::size_t back = fBack;
+      *ppbuf = data () + back;
 
-      std::size_t sizeToEnd = fSize - (std::size_t) (fBack - fBuf);
+      std::size_t sizeToEnd = fSize - back;
       std::size_t len = sizeToEnd;
       if (len > (fSize - fLen))
         {
@@ -283,12 +381,181 @@ namespace os
       return len;
     }
 
+    std::size_t
+    ByteCircularBuffer::peekFront (uint8_t** ppbuf1, std::size_t* plen1,
+                                   uint8_t** ppbuf2, std::size_t* plen2)
+    {
+      assert(ppbuf1 != nullptr);
+      assert(plen1 != nullptr);
+      assert(ppbuf2 != nullptr);
+      assert(plen2 != nullptr);
+
+      std::size_t len = fLen;
+      std::size_t front = fFront;
+      std::size_t sizeToEnd = fSize - front;
+
+      *ppbuf1 = data () + front;
+      *ppbuf2 = data ();
+      if (len <= sizeToEnd)
+        {
+          *plen1 = len;
+          *plen2 = 0;
+        }
+      else
+        {
+          *plen1 = sizeToEnd;
+          *plen2 = len - sizeToEnd;
+        }
+      return len;
+    }
+
+    std::size_t
+    ByteCircularBuffer::reserveBack (uint8_t** ppbuf1, std::size_t* plen1,
+                                     uint8_t** ppbuf2, std::size_t* plen2)
+    {
+      assert(ppbuf1 != nullptr);
+      assert(plen1 != nullptr);
+      assert(ppbuf2 != nullptr);
+      assert(plen2 != nullptr);
+
+      std::size_t space = fSize - fLen;
+      std::size_t back = fBack;
+      std::size_t sizeToEnd = fSize - back;
+
+      *ppbuf1 = data () + back;
+      *ppbuf2 = data ();
+      if (space <= sizeToEnd)
+        {
+          *plen1 = space;
+          *plen2 = 0;
+        }
+      else
+        {
+          *plen1 = sizeToEnd;
+          *plen2 = space - sizeToEnd;
+        }
+      return space;
+    }
+
+    constexpr std::size_t ByteCircularBuffer::npos;
+
+    std::size_t
+    ByteCircularBuffer::find (uint8_t c, std::size_t offset) const
+    {
+      std::size_t len = fLen;
+      if (offset >= len)
+        {
+          return npos;
+        }
+
+      std::size_t front = fFront;
+      std::size_t sizeToEnd = fSize - front;
+      const uint8_t* p;
+      if (offset < sizeToEnd)
+        {
+          // In the first segment.
+          std::size_t end = (len < sizeToEnd) ? len : sizeToEnd;
+          p = find_byte (fBuf + front + offset, end - offset, c);
+          if (p != nullptr)
+            {
+              return static_cast<std::size_t> (p - (fBuf + front));
+            }
+          if (len <= sizeToEnd)
+            {
+              return npos;
+            }
+          offset = sizeToEnd;
+        }
+
+      // In the second segment, at the beginning of the buffer.
+      p = find_byte (fBuf + (offset - sizeToEnd), len - offset, c);
+      if (p != nullptr)
+        {
+          return sizeToEnd + static_cast<std::size_t> (p - fBuf);
+        }
+      return npos;
+    }
+
+    std::size_t
+    ByteCircularBuffer::count (uint8_t c) const
+    {
+      std::size_t len = fLen;
+      std::size_t front = fFront;
+      std::size_t sizeToEnd = fSize - front;
+      if (len <= sizeToEnd)
+        {
+          return count_byte (fBuf + front, len, c);
+        }
+      return count_byte (fBuf + front, sizeToEnd, c)
+          + count_byte (fBuf, len - sizeToEnd, c);
+    }
+
+    std::size_t
+    ByteCircularBuffer::copyBeforeBack (std::size_t distance, uint8_t* buf,
+                                        std::size_t count) const
+    {
+      assert(buf != nullptr);
+
+      const uint8_t* pbuf1;
+      std::size_t len1;
+      const uint8_t* pbuf2;
+      std::size_t len2;
+      peekBeforeBack (distance, count, &pbuf1, &len1, &pbuf2, &len2);
+
+      std::memcpy (buf, pbuf1, len1);
+      std::memcpy (buf + len1, pbuf2, len2);
+      return len1 + len2;
+    }
+
+    std::size_t
+    ByteCircularBuffer::peekBeforeBack (std::size_t distance,
+                                        std::size_t count,
+                                        const uint8_t** ppbuf1,
+                                        std::size_t* plen1,
+                                        const uint8_t** ppbuf2,
+                                        std::size_t* plen2) const
+    {
+      assert(ppbuf1 != nullptr);
+      assert(plen1 != nullptr);
+      assert(ppbuf2 != nullptr);
+      assert(plen2 != nullptr);
+
+      if (distance > fSize)
+        {
+          distance = fSize;
+        }
+      std::size_t len = (count < distance) ? count : distance;
+
+      std::size_t begin = fBack + fSize - distance;
+      if (begin >= fSize)
+        {
+          begin -= fSize;
+        }
+      std::size_t sizeToEnd = fSize - begin;
+      *ppbuf1 = fBuf + begin;
+      *ppbuf2 = fBuf;
+      if (len <= sizeToEnd)
+        {
+          *plen1 = len;
+          *plen2 = 0;
+        }
+      else
+        {
+          *plen1 = sizeToEnd;
+          *plen2 = len - sizeToEnd;
+        }
+      return len;
+    }
+
     void
     ByteCircularBuffer::dump (void)
     {
-      os::trace::printf ("%s @%p {buf=%p, size=%d, len=%d, hwm=%d, lwn=%d}\n",
-                         __PRETTY_FUNCTION__, fBuf, fSize, fLen, fHighWaterMark,
-                         fLowWaterMark);
+      os::trace::printf (
+          "%s @%p {buf=%p, size=%u, len=%u, max=%u, hwm=%u, lwn=%u}\n",
+          __PRETTY_FUNCTION__, this, fBuf, (unsigned int) fSize,
+          (unsigned int) fLen, (unsigned int) fMaxLen,
+          (unsigned int) fHighWaterMark,
+          (unsigned int) fLowWaterMark);
     }
 
   }
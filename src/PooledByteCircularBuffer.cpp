@@ -0,0 +1,528 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "posix-drivers/PooledByteCircularBuffer.h"
+#include "posix-drivers/byte-scan.h"
+#include "posix-drivers/crc.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cstring>
+#include <cassert>
+
+// ----------------------------------------------------------------------------
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    PooledByteCircularBuffer::PooledByteCircularBuffer (
+        ByteBlockPool& pool, std::size_t maxBlocks, std::size_t highWaterMark,
+        std::size_t lowWaterMark) :
+        fPool (pool), //
+        fBlockSize (pool.blockSize ()), //
+        fMaxBlocks (maxBlocks), //
+        fSize (maxBlocks * pool.blockSize ()), //
+        fHighWaterMark (highWaterMark <= fSize ? highWaterMark : fSize), //
+        fLowWaterMark (lowWaterMark)
+    {
+      assert(fLowWaterMark <= fHighWaterMark);
+
+      fHead = fTail = ByteBlockPool::none;
+      fBlocks = 0;
+      clear ();
+    }
+
+    PooledByteCircularBuffer::PooledByteCircularBuffer (ByteBlockPool& pool,
+                                                        std::size_t maxBlocks) :
+        PooledByteCircularBuffer (pool, maxBlocks,
+                                  maxBlocks * pool.blockSize (), 0)
+    {
+      ;
+    }
+
+    PooledByteCircularBuffer::~PooledByteCircularBuffer ()
+    {
+      clear ();
+    }
+
+    // ------------------------------------------------------------------------
+
+    constexpr std::size_t PooledByteCircularBuffer::npos;
+
+    void
+    PooledByteCircularBuffer::clear (void)
+    {
+      ByteBlockPool::index_t block = fHead;
+      while (block != ByteBlockPool::none)
+        {
+          ByteBlockPool::index_t next = fPool.next (block);
+          fPool.release (block);
+          block = next;
+        }
+      fHead = fTail = ByteBlockPool::none;
+      fBlocks = 0;
+      fBack = fFront = 0;
+      fLen = 0;
+      fMaxLen = 0;
+    }
+
+    void
+    PooledByteCircularBuffer::trim (void)
+    {
+      if ((fLen != 0) || (fTail == ByteBlockPool::none))
+        {
+          return;
+        }
+
+      // An empty buffer has only one block.
+      assert(fHead == fTail);
+      fPool.release (fTail);
+      fHead = fTail = ByteBlockPool::none;
+      fBlocks = 0;
+      fBack = fFront = 0;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::frontLength (void) const
+    {
+      if (fHead == ByteBlockPool::none)
+        {
+          return 0;
+        }
+      std::size_t end = (fHead == fTail) ? fBack : fBlockSize;
+      return end - fFront;
+    }
+
+    void
+    PooledByteCircularBuffer::consumeFront (std::size_t count)
+    {
+      fFront += count;
+      fLen -= count;
+      if ((fFront == fBlockSize) && (fHead != fTail))
+        {
+          // The first block was consumed, return it to the pool.
+          ByteBlockPool::index_t block = fHead;
+          fHead = fPool.next (block);
+          fPool.release (block);
+          fBlocks = fBlocks - 1;
+          fFront = 0;
+        }
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::prepareBack (void)
+    {
+      if ((fTail != ByteBlockPool::none) && (fBack < fBlockSize))
+        {
+          return fBlockSize - fBack;
+        }
+
+      if ((fTail != ByteBlockPool::none) && (fHead == fTail)
+          && (fFront == fBlockSize))
+        {
+          // The only block is full and consumed; nobody refers to
+          // its bytes, reuse it from the beginning.
+          fFront = fBack = 0;
+          return fBlockSize;
+        }
+
+      if (fBlocks >= fMaxBlocks)
+        {
+          return 0;
+        }
+      ByteBlockPool::index_t block = fPool.allocate ();
+      if (block == ByteBlockPool::none)
+        {
+          return 0;
+        }
+
+      if (fTail == ByteBlockPool::none)
+        {
+          fHead = block;
+          fFront = 0;
+        }
+      else
+        {
+          fPool.link (fTail, block);
+        }
+      fTail = block;
+      fBack = 0;
+      fBlocks = fBlocks + 1;
+      return fBlockSize;
+    }
+
+    // ------------------------------------------------------------------------
+
+    std::size_t
+    PooledByteCircularBuffer::pushBack (uint8_t c)
+    {
+      if (prepareBack () == 0)
+        {
+          return 0;
+        }
+
+      fPool.block (fTail)[fBack] = c;
+      fBack = fBack + 1;
+      fLen = fLen + 1;
+      updateMaxLength ();
+      return 1;
+    }
+
+    // Return the actual number of bytes, if not enough space for all.
+    std::size_t
+    PooledByteCircularBuffer::pushBack (const uint8_t* buf, std::size_t count)
+    {
+      assert(buf != nullptr);
+
+      std::size_t done = 0;
+      while (done < count)
+        {
+          std::size_t len = prepareBack ();
+          if (len == 0)
+            {
+              break;
+            }
+          if (len > count - done)
+            {
+              len = count - done;
+            }
+          std::memcpy (fPool.block (fTail) + fBack, buf + done, len);
+          fBack += len;
+          fLen += len;
+          done += len;
+        }
+      updateMaxLength ();
+      return done;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::pushBack (const uint8_t* buf, std::size_t count,
+                                        Checksum& sum)
+    {
+      assert(buf != nullptr);
+
+      std::size_t done = 0;
+      while (done < count)
+        {
+          std::size_t len = prepareBack ();
+          if (len == 0)
+            {
+              break;
+            }
+          if (len > count - done)
+            {
+              len = count - done;
+            }
+          sum.copy (fPool.block (fTail) + fBack, buf + done, len);
+          fBack += len;
+          fLen += len;
+          done += len;
+        }
+      updateMaxLength ();
+      return done;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::advanceBack (std::size_t count)
+    {
+      if (fTail == ByteBlockPool::none)
+        {
+          return 0;
+        }
+
+      std::size_t len = fBlockSize - fBack;
+      if (count < len)
+        {
+          len = count;
+        }
+      fBack += len;
+      fLen += len;
+      updateMaxLength ();
+      return len;
+    }
+
+    void
+    PooledByteCircularBuffer::retreatBack (void)
+    {
+      if ((fLen == 0) || (fBack == 0))
+        {
+          // Inside the last block only.
+          return;
+        }
+
+      fBack = fBack - 1;
+      fLen = fLen - 1;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::popFront (uint8_t* buf)
+    {
+      if (fLen == 0)
+        {
+          return 0;
+        }
+
+      *buf = fPool.block (fHead)[fFront];
+      consumeFront (1);
+      return 1;
+    }
+
+    // Return the actual number of bytes, if less than requested.
+    std::size_t
+    PooledByteCircularBuffer::popFront (uint8_t* buf, std::size_t siz)
+    {
+      assert(buf != nullptr);
+
+      std::size_t done = 0;
+      while ((done < siz) && (fLen > 0))
+        {
+          std::size_t len = frontLength ();
+          if (len > siz - done)
+            {
+              len = siz - done;
+            }
+          std::memcpy (buf + done, fPool.block (fHead) + fFront, len);
+          consumeFront (len);
+          done += len;
+        }
+      return done;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::popFront (uint8_t* buf, std::size_t siz,
+                                        Checksum& sum)
+    {
+      assert(buf != nullptr);
+
+      std::size_t done = 0;
+      while ((done < siz) && (fLen > 0))
+        {
+          std::size_t len = frontLength ();
+          if (len > siz - done)
+            {
+              len = siz - done;
+            }
+          sum.copy (buf + done, fPool.block (fHead) + fFront, len);
+          consumeFront (len);
+          done += len;
+        }
+      return done;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::advanceFront (std::size_t count)
+    {
+      std::size_t done = 0;
+      while ((done < count) && (fLen > 0))
+        {
+          std::size_t len = frontLength ();
+          if (len > count - done)
+            {
+              len = count - done;
+            }
+          consumeFront (len);
+          done += len;
+        }
+      return done;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::getFrontContiguousBuffer (uint8_t** ppbuf)
+    {
+      assert(ppbuf != nullptr);
+
+      if (fHead == ByteBlockPool::none)
+        {
+          *ppbuf = nullptr;
+          return 0;
+        }
+
+      *ppbuf = fPool.block (fHead) + fFront;
+      return frontLength ();
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::getBackContiguousBuffer (uint8_t** ppbuf)
+    {
+      assert(ppbuf != nullptr);
+
+      std::size_t len = prepareBack ();
+      if (len == 0)
+        {
+          *ppbuf = (fTail != ByteBlockPool::none) ?
+              (fPool.block (fTail) + fBack) : nullptr;
+          return 0;
+        }
+
+      *ppbuf = fPool.block (fTail) + fBack;
+      return len;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::peekFront (uint8_t** ppbuf1, std::size_t* plen1,
+                                         uint8_t** ppbuf2, std::size_t* plen2)
+    {
+      assert(ppbuf1 != nullptr);
+      assert(plen1 != nullptr);
+      assert(ppbuf2 != nullptr);
+      assert(plen2 != nullptr);
+
+      *plen1 = getFrontContiguousBuffer (ppbuf1);
+      *ppbuf2 = nullptr;
+      *plen2 = 0;
+      if ((fHead != ByteBlockPool::none) && (fHead != fTail))
+        {
+          ByteBlockPool::index_t next = fPool.next (fHead);
+          *ppbuf2 = fPool.block (next);
+          *plen2 = (next == fTail) ? fBack : fBlockSize;
+        }
+      return *plen1 + *plen2;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::reserveBack (uint8_t** ppbuf1,
+                                           std::size_t* plen1,
+                                           uint8_t** ppbuf2,
+                                           std::size_t* plen2)
+    {
+      assert(ppbuf1 != nullptr);
+      assert(plen1 != nullptr);
+      assert(ppbuf2 != nullptr);
+      assert(plen2 != nullptr);
+
+      *plen1 = getBackContiguousBuffer (ppbuf1);
+      *ppbuf2 = nullptr;
+      *plen2 = 0;
+      return *plen1;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::find (uint8_t c, std::size_t offset) const
+    {
+      if (offset >= fLen)
+        {
+          return npos;
+        }
+
+      // The offset, from the front, of the block beginning.
+      std::size_t base = 0;
+      std::size_t begin = fFront;
+      for (ByteBlockPool::index_t block = fHead;
+          block != ByteBlockPool::none; block = fPool.next (block))
+        {
+          std::size_t end = (block == fTail) ? fBack : fBlockSize;
+          std::size_t len = end - begin;
+          if (offset < base + len)
+            {
+              const uint8_t* start = fPool.block (block) + begin;
+              std::size_t skip = (offset > base) ? (offset - base) : 0;
+              const uint8_t* p = find_byte (start + skip, len - skip, c);
+              if (p != nullptr)
+                {
+                  return base + static_cast<std::size_t> (p - start);
+                }
+            }
+          base += len;
+          begin = 0;
+        }
+      return npos;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::count (uint8_t c) const
+    {
+      std::size_t n = 0;
+      std::size_t begin = fFront;
+      for (ByteBlockPool::index_t block = fHead;
+          block != ByteBlockPool::none; block = fPool.next (block))
+        {
+          std::size_t end = (block == fTail) ? fBack : fBlockSize;
+          n += count_byte (fPool.block (block) + begin, end - begin, c);
+          begin = 0;
+        }
+      return n;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::copyBeforeBack (
+        std::size_t distance __attribute__((unused)),
+        uint8_t* buf __attribute__((unused)),
+        std::size_t count __attribute__((unused))) const
+    {
+      return 0;
+    }
+
+    std::size_t
+    PooledByteCircularBuffer::peekBeforeBack (
+        std::size_t distance __attribute__((unused)),
+        std::size_t count __attribute__((unused)), const uint8_t** ppbuf1,
+        std::size_t* plen1, const uint8_t** ppbuf2, std::size_t* plen2) const
+    {
+      assert(ppbuf1 != nullptr);
+      assert(plen1 != nullptr);
+      assert(ppbuf2 != nullptr);
+      assert(plen2 != nullptr);
+
+      *ppbuf1 = nullptr;
+      *plen1 = 0;
+      *ppbuf2 = nullptr;
+      *plen2 = 0;
+      return 0;
+    }
+
+    bool
+    PooledByteCircularBuffer::isFull (void) const
+    {
+      if ((fTail != ByteBlockPool::none) && (fBack < fBlockSize))
+        {
+          return false;
+        }
+      if ((fTail != ByteBlockPool::none) && (fHead == fTail)
+          && (fFront == fBlockSize))
+        {
+          // Will be reused.
+          return false;
+        }
+      return (fBlocks >= fMaxBlocks) || (fPool.getFreeCount () == 0);
+    }
+
+    void
+    PooledByteCircularBuffer::dump (void)
+    {
+      os::trace::printf (
+          "%s @%p {blocks=%u, size=%u, len=%u, max=%u, hwm=%u, lwn=%u}\n",
+          __PRETTY_FUNCTION__, this, (unsigned int) fBlocks,
+          (unsigned int) fSize, (unsigned int) fLen,
+          (unsigned int) fMaxLen, (unsigned int) fHighWaterMark,
+          (unsigned int) fLowWaterMark);
+    }
+
+  } /* namespace dev */
+} /* namespace os */
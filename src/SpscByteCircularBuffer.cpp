@@ -0,0 +1,563 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "posix-drivers/SpscByteCircularBuffer.h"
+#include "posix-drivers/byte-scan.h"
+#include "posix-drivers/crc.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cstring>
+#include <cassert>
+
+// ----------------------------------------------------------------------------
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    SpscByteCircularBuffer::SpscByteCircularBuffer (uint8_t* buf,
+                                                    std::size_t siz,
+                                                    std::size_t highWaterMark,
+                                                    std::size_t lowWaterMark) :
+        fBuf (buf), //
+        fSize (siz), //
+        fHighWaterMark (highWaterMark <= fSize ? highWaterMark : siz), //
+        fLowWaterMark (lowWaterMark)
+    {
+      assert(fLowWaterMark <= fHighWaterMark);
+
+      clear ();
+    }
+
+    SpscByteCircularBuffer::SpscByteCircularBuffer (uint8_t* buf,
+                                                    std::size_t siz) :
+        SpscByteCircularBuffer (buf, siz, siz, 0)
+    {
+      ;
+    }
+
+    // ------------------------------------------------------------------------
+
+    void
+    SpscByteCircularBuffer::clear (void)
+    {
+      fBack.store (0, std::memory_order_relaxed);
+      fFront.store (0, std::memory_order_release);
+      fMaxLen.store (0, std::memory_order_relaxed);
+#if defined(DEBUG)
+      std::memset (fBuf, '?', fSize);
+#endif
+    }
+
+    // ------------------------------------------------------------------------
+    // Producer side.
+
+    std::size_t
+    SpscByteCircularBuffer::pushBack (uint8_t c)
+    {
+      std::size_t back = fBack.load (std::memory_order_relaxed);
+      std::size_t front = fFront.load (std::memory_order_acquire);
+
+      if (distance (back, front) >= fSize)
+        {
+          // Full.
+          return 0;
+        }
+
+      // Add to back.
+      fBuf[position (back)] = c;
+      fBack.store (next (back, 1), std::memory_order_release);
+      updateMaxLength (distance (back, front) + 1);
+      return 1;
+    }
+
+    // Return the actual number of bytes, if not enough space for all.
+    std::size_t
+    SpscByteCircularBuffer::pushBack (const uint8_t* buf, std::size_t count)
+    {
+      assert(buf != nullptr);
+
+      std::size_t back = fBack.load (std::memory_order_relaxed);
+      std::size_t front = fFront.load (std::memory_order_acquire);
+
+      std::size_t len = count;
+      std::size_t space = fSize - distance (back, front);
+      if (len > space)
+        {
+          len = space;
+        }
+
+      if (len == 0)
+        {
+          return 0;
+        }
+
+      std::size_t pos = position (back);
+      std::size_t sizeToEnd = fSize - pos;
+      if (len <= sizeToEnd)
+        {
+          copy_bytes (fBuf + pos, buf, len);
+        }
+      else
+        {
+          copy_bytes (fBuf + pos, buf, sizeToEnd);
+          copy_bytes (fBuf, buf + sizeToEnd, len - sizeToEnd);
+        }
+
+      // Publish the new bytes only after they were copied.
+      fBack.store (next (back, len), std::memory_order_release);
+      updateMaxLength (fSize - space + len);
+      return len;
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::pushBack (const uint8_t* buf, std::size_t count,
+                                      Checksum& sum)
+    {
+      assert(buf != nullptr);
+
+      std::size_t back = fBack.load (std::memory_order_relaxed);
+      std::size_t front = fFront.load (std::memory_order_acquire);
+
+      std::size_t len = count;
+      std::size_t space = fSize - distance (back, front);
+      if (len > space)
+        {
+          len = space;
+        }
+
+      if (len == 0)
+        {
+          return 0;
+        }
+
+      std::size_t pos = position (back);
+      std::size_t sizeToEnd = fSize - pos;
+      if (len <= sizeToEnd)
+        {
+          sum.copy (fBuf + pos, buf, len);
+        }
+      else
+        {
+          sum.copy (fBuf + pos, buf, sizeToEnd);
+          sum.copy (fBuf, buf + sizeToEnd, len - sizeToEnd);
+        }
+
+      // Publish the new bytes only after they were copied.
+      fBack.store (next (back, len), std::memory_order_release);
+      updateMaxLength (fSize - space + len);
+      return len;
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::advanceBack (std::size_t count)
+    {
+      std::size_t back = fBack.load (std::memory_order_relaxed);
+      std::size_t front = fFront.load (std::memory_order_acquire);
+
+      std::size_t adjust = count;
+      std::size_t space = fSize - distance (back, front);
+      if (adjust > space)
+        {
+          adjust = space;
+        }
+
+      if (adjust == 0)
+        {
+          return 0;
+        }
+
+      fBack.store (next (back, adjust), std::memory_order_release);
+      updateMaxLength (fSize - space + adjust);
+      return adjust;
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::getBackContiguousBuffer (uint8_t** ppbuf)
+    {
+      assert(ppbuf != nullptr);
+
+      std::size_t back = fBack.load (std::memory_order_relaxed);
+      std::size_t front = fFront.load (std::memory_order_acquire);
+
+      std::size_t pos = position (back);
+      *ppbuf = fBuf + pos;
+
+      std::size_t sizeToEnd = fSize - pos;
+      std::size_t len = sizeToEnd;
+      std::size_t space = fSize - distance (back, front);
+      if (len > space)
+        {
+          len = space;
+        }
+
+      return len;
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::reserveBack (uint8_t** ppbuf1, std::size_t* plen1,
+                                         uint8_t** ppbuf2, std::size_t* plen2)
+    {
+      assert(ppbuf1 != nullptr);
+      assert(plen1 != nullptr);
+      assert(ppbuf2 != nullptr);
+      assert(plen2 != nullptr);
+
+      std::size_t back = fBack.load (std::memory_order_relaxed);
+      std::size_t front = fFront.load (std::memory_order_acquire);
+
+      std::size_t space = fSize - distance (back, front);
+      std::size_t pos = position (back);
+      std::size_t sizeToEnd = fSize - pos;
+
+      *ppbuf1 = fBuf + pos;
+      *ppbuf2 = fBuf;
+      if (space <= sizeToEnd)
+        {
+          *plen1 = space;
+          *plen2 = 0;
+        }
+      else
+        {
+          *plen1 = sizeToEnd;
+          *plen2 = space - sizeToEnd;
+        }
+      return space;
+    }
+
+    // ------------------------------------------------------------------------
+    // Consumer side.
+
+    std::size_t
+    SpscByteCircularBuffer::popFront (uint8_t* buf)
+    {
+      assert(buf != nullptr);
+
+      std::size_t front = fFront.load (std::memory_order_relaxed);
+      std::size_t back = fBack.load (std::memory_order_acquire);
+
+      if (back == front)
+        {
+          // Empty.
+          return 0;
+        }
+
+      *buf = fBuf[position (front)];
+      fFront.store (next (front, 1), std::memory_order_release);
+      return 1;
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::popFront (uint8_t* buf, std::size_t siz)
+    {
+      assert(buf != nullptr);
+
+      std::size_t front = fFront.load (std::memory_order_relaxed);
+      std::size_t back = fBack.load (std::memory_order_acquire);
+
+      std::size_t len = siz;
+      std::size_t used = distance (back, front);
+      if (len > used)
+        {
+          len = used;
+        }
+
+      if (len == 0)
+        {
+          return 0;
+        }
+
+      std::size_t pos = position (front);
+      std::size_t sizeToEnd = fSize - pos;
+      if (len <= sizeToEnd)
+        {
+          copy_bytes (buf, fBuf + pos, len);
+        }
+      else
+        {
+          copy_bytes (buf, fBuf + pos, sizeToEnd);
+          copy_bytes (buf + sizeToEnd, fBuf, len - sizeToEnd);
+        }
+
+      // Release the space only after the bytes were copied.
+      fFront.store (next (front, len), std::memory_order_release);
+      return len;
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::popFront (uint8_t* buf, std::size_t siz,
+                                      Checksum& sum)
+    {
+      assert(buf != nullptr);
+
+      std::size_t front = fFront.load (std::memory_order_relaxed);
+      std::size_t back = fBack.load (std::memory_order_acquire);
+
+      std::size_t len = siz;
+      std::size_t used = distance (back, front);
+      if (len > used)
+        {
+          len = used;
+        }
+
+      if (len == 0)
+        {
+          return 0;
+        }
+
+      std::size_t pos = position (front);
+      std::size_t sizeToEnd = fSize - pos;
+      if (len <= sizeToEnd)
+        {
+          sum.copy (buf, fBuf + pos, len);
+        }
+      else
+        {
+          sum.copy (buf, fBuf + pos, sizeToEnd);
+          sum.copy (buf + sizeToEnd, fBuf, len - sizeToEnd);
+        }
+
+      // Release the space only after the bytes were copied.
+      fFront.store (next (front, len), std::memory_order_release);
+      return len;
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::advanceFront (std::size_t count)
+    {
+      if (count == 0)
+        {
+          return 0;
+        }
+
+      std::size_t front = fFront.load (std::memory_order_relaxed);
+      std::size_t back = fBack.load (std::memory_order_acquire);
+
+      std::size_t adjust = count;
+      std::size_t used = distance (back, front);
+      if (adjust > used)
+        {
+          adjust = used;
+        }
+
+      fFront.store (next (front, adjust), std::memory_order_release);
+      return adjust;
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::getFrontContiguousBuffer (uint8_t** ppbuf)
+    {
+      assert(ppbuf != nullptr);
+
+      std::size_t front = fFront.load (std::memory_order_acquire);
+      std::size_t back = fBack.load (std::memory_order_acquire);
+
+      std::size_t pos = position (front);
+      *ppbuf = fBuf + pos;
+
+      std::size_t sizeToEnd = fSize - pos;
+      std::size_t len = sizeToEnd;
+      std::size_t used = distance (back, front);
+      if (len > used)
+        {
+          len = used;
+        }
+
+      return len;
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::peekFront (uint8_t** ppbuf1, std::size_t* plen1,
+                                       uint8_t** ppbuf2, std::size_t* plen2)
+    {
+      assert(ppbuf1 != nullptr);
+      assert(plen1 != nullptr);
+      assert(ppbuf2 != nullptr);
+      assert(plen2 != nullptr);
+
+      std::size_t front = fFront.load (std::memory_order_relaxed);
+      std::size_t back = fBack.load (std::memory_order_acquire);
+
+      std::size_t len = distance (back, front);
+      std::size_t pos = position (front);
+      std::size_t sizeToEnd = fSize - pos;
+
+      *ppbuf1 = fBuf + pos;
+      *ppbuf2 = fBuf;
+      if (len <= sizeToEnd)
+        {
+          *plen1 = len;
+          *plen2 = 0;
+        }
+      else
+        {
+          *plen1 = sizeToEnd;
+          *plen2 = len - sizeToEnd;
+        }
+      return len;
+    }
+
+    // ------------------------------------------------------------------------
+    // Consumer side, scanning.
+
+    constexpr std::size_t SpscByteCircularBuffer::npos;
+
+    std::size_t
+    SpscByteCircularBuffer::find (uint8_t c, std::size_t offset) const
+    {
+      std::size_t front = fFront.load (std::memory_order_relaxed);
+      std::size_t back = fBack.load (std::memory_order_acquire);
+
+      std::size_t len = distance (back, front);
+      if (offset >= len)
+        {
+          return npos;
+        }
+
+      std::size_t pos = position (front);
+      std::size_t sizeToEnd = fSize - pos;
+      const uint8_t* p;
+      if (offset < sizeToEnd)
+        {
+          // In the first segment.
+          std::size_t end = (len < sizeToEnd) ? len : sizeToEnd;
+          p = find_byte (fBuf + pos + offset, end - offset, c);
+          if (p != nullptr)
+            {
+              return static_cast<std::size_t> (p - (fBuf + pos));
+            }
+          if (len <= sizeToEnd)
+            {
+              return npos;
+            }
+          offset = sizeToEnd;
+        }
+
+      // In the second segment, at the beginning of the buffer.
+      p = find_byte (fBuf + (offset - sizeToEnd), len - offset, c);
+      if (p != nullptr)
+        {
+          return sizeToEnd + static_cast<std::size_t> (p - fBuf);
+        }
+      return npos;
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::count (uint8_t c) const
+    {
+      std::size_t front = fFront.load (std::memory_order_relaxed);
+      std::size_t back = fBack.load (std::memory_order_acquire);
+
+      std::size_t len = distance (back, front);
+      std::size_t pos = position (front);
+      std::size_t sizeToEnd = fSize - pos;
+      if (len <= sizeToEnd)
+        {
+          return count_byte (fBuf + pos, len, c);
+        }
+      return count_byte (fBuf + pos, sizeToEnd, c)
+          + count_byte (fBuf, len - sizeToEnd, c);
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::copyBeforeBack (std::size_t distance,
+                                            uint8_t* buf,
+                                            std::size_t count) const
+    {
+      assert(buf != nullptr);
+
+      const uint8_t* pbuf1;
+      std::size_t len1;
+      const uint8_t* pbuf2;
+      std::size_t len2;
+      peekBeforeBack (distance, count, &pbuf1, &len1, &pbuf2, &len2);
+
+      std::memcpy (buf, pbuf1, len1);
+      std::memcpy (buf + len1, pbuf2, len2);
+      return len1 + len2;
+    }
+
+    std::size_t
+    SpscByteCircularBuffer::peekBeforeBack (std::size_t distance,
+                                            std::size_t count,
+                                            const uint8_t** ppbuf1,
+                                            std::size_t* plen1,
+                                            const uint8_t** ppbuf2,
+                                            std::size_t* plen2) const
+    {
+      assert(ppbuf1 != nullptr);
+      assert(plen1 != nullptr);
+      assert(ppbuf2 != nullptr);
+      assert(plen2 != nullptr);
+
+      std::size_t back = fBack.load (std::memory_order_acquire);
+
+      if (distance > fSize)
+        {
+          distance = fSize;
+        }
+      std::size_t len = (count < distance) ? count : distance;
+
+      std::size_t begin = position (back) + fSize - distance;
+      if (begin >= fSize)
+        {
+          begin -= fSize;
+        }
+      std::size_t sizeToEnd = fSize - begin;
+      *ppbuf1 = fBuf + begin;
+      *ppbuf2 = fBuf;
+      if (len <= sizeToEnd)
+        {
+          *plen1 = len;
+          *plen2 = 0;
+        }
+      else
+        {
+          *plen1 = sizeToEnd;
+          *plen2 = len - sizeToEnd;
+        }
+      return len;
+    }
+
+    // ------------------------------------------------------------------------
+
+    void
+    SpscByteCircularBuffer::dump (void)
+    {
+      os::trace::printf (
+          "%s @%p {buf=%p, size=%u, len=%u, max=%u, hwm=%u, lwn=%u}\n",
+          __PRETTY_FUNCTION__, this, fBuf, (unsigned int) fSize,
+          (unsigned int) length (), (unsigned int) getMaxLength (),
+          (unsigned int) fHighWaterMark,
+          (unsigned int) fLowWaterMark);
+    }
+
+  }
+/* namespace dev */
+} /* namespace os */
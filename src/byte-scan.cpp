@@ -0,0 +1,169 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "posix-drivers/byte-scan.h"
+
+#include <cstring>
+#include <cassert>
+
+// ----------------------------------------------------------------------------
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    namespace
+    {
+      using word_t = uint32_t;
+
+      constexpr word_t low7 = 0x7F7F7F7Fu;
+
+      // Replicate the byte in all the bytes of a word.
+      inline word_t
+      splat (uint8_t c)
+      {
+        return c * static_cast<word_t> (0x01010101u);
+      }
+
+      // Return a word with the high bit set in each byte of the word
+      // equal to the pattern, and all other bits 0. Exact, as opposed
+      // to the shorter (x - 0x01..) & ~x & 0x80.., which can also flag
+      // bytes following a match, due to the borrow; this matters for
+      // counting and on big endian.
+      inline word_t
+      match (word_t w, word_t pattern)
+      {
+        word_t x = w ^ pattern;
+        return ~(((x & low7) + low7) | x | low7);
+      }
+
+      // The index, in memory order, of the first matching byte.
+      inline std::size_t
+      first (word_t m)
+      {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        return static_cast<std::size_t> (__builtin_clz (m)) / 8;
+#else
+        return static_cast<std::size_t> (__builtin_ctz (m)) / 8;
+#endif
+      }
+
+      inline word_t
+      load (const uint8_t* p)
+      {
+        // Aligned, compiles to a single load.
+        word_t w;
+        std::memcpy (&w, p, sizeof(w));
+        return w;
+      }
+
+      inline bool
+      is_aligned (const uint8_t* p)
+      {
+        return (reinterpret_cast<uintptr_t> (p) & (sizeof(word_t) - 1)) == 0;
+      }
+    }
+
+    // ------------------------------------------------------------------------
+
+    const uint8_t*
+    find_byte (const uint8_t* buf, std::size_t len, uint8_t c)
+    {
+      assert(buf != nullptr || len == 0);
+
+      const uint8_t* p = buf;
+      const uint8_t* end = buf + len;
+
+      // Bytes up to the first word boundary.
+      for (; (p < end) && !is_aligned (p); ++p)
+        {
+          if (*p == c)
+            {
+              return p;
+            }
+        }
+
+      // Whole words.
+      word_t pattern = splat (c);
+      for (; (end - p) >= static_cast<std::ptrdiff_t> (sizeof(word_t));
+          p += sizeof(word_t))
+        {
+          word_t m = match (load (p), pattern);
+          if (m != 0)
+            {
+              return p + first (m);
+            }
+        }
+
+      // The remaining bytes.
+      for (; p < end; ++p)
+        {
+          if (*p == c)
+            {
+              return p;
+            }
+        }
+      return nullptr;
+    }
+
+    std::size_t
+    count_byte (const uint8_t* buf, std::size_t len, uint8_t c)
+    {
+      assert(buf != nullptr || len == 0);
+
+      const uint8_t* p = buf;
+      const uint8_t* end = buf + len;
+      std::size_t count = 0;
+
+      for (; (p < end) && !is_aligned (p); ++p)
+        {
+          count += (*p == c);
+        }
+
+      word_t pattern = splat (c);
+      for (; (end - p) >= static_cast<std::ptrdiff_t> (sizeof(word_t));
+          p += sizeof(word_t))
+        {
+          word_t m = match (load (p), pattern);
+          if (m != 0)
+            {
+              count += static_cast<std::size_t> (__builtin_popcount (m));
+            }
+        }
+
+      for (; p < end; ++p)
+        {
+          count += (*p == c);
+        }
+      return count;
+    }
+
+  } /* namespace dev */
+} /* namespace os */
@@ -42,6 +42,7 @@ namespace os
       {
         cb_event_ = nullptr;
         cb_object_ = nullptr;
+        rx_progress_events_ = 0;
       }
 
       int32_t
@@ -53,11 +54,36 @@ namespace os
         return do_initialize ();
       }
 
+      uint32_t
+      Serial::get_send_segments_max (void)
+      {
+        return 0;
+      }
+
+      int32_t
+      Serial::send_chain (const struct iovec* iov __attribute__((unused)),
+                          int iovcnt __attribute__((unused)))
+      {
+        return ARM_DRIVER_ERROR_UNSUPPORTED;
+      }
+
+      void
+      Serial::set_rx_progress_events (uint32_t events)
+      {
+        rx_progress_events_ = events;
+      }
+
       // ----------------------------------------------------------------------
 
       void
       Serial::signal_event (uint32_t event)
       {
+        if (event & rx_progress_events_)
+          {
+            // Map the vendor event to the common one.
+            event = (event & ~rx_progress_events_)
+                | ARM_USART_EVENT_RX_PROGRESS;
+          }
         if (cb_event_ != nullptr)
           {
             // Forward event to registered callback.
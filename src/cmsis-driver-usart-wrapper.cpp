@@ -38,8 +38,12 @@ namespace os
     {
       // ----------------------------------------------------------------------
 
-      Usart_wrapper::Usart_wrapper (ARM_DRIVER_USART* driver) :
-          driver_ (driver)
+      Usart_wrapper::Usart_wrapper (ARM_DRIVER_USART* driver,
+                                    send_chain_t send_chain,
+                                    uint32_t send_segments_max) :
+          driver_ (driver), //
+          send_chain_ (send_chain), //
+          send_segments_max_ (send_segments_max)
       {
         ;
       }
@@ -99,6 +103,23 @@ namespace os
         return driver_->Send (data, num);
       }
 
+      uint32_t
+      Usart_wrapper::get_send_segments_max (void)
+      {
+        return (send_chain_ != nullptr) ? send_segments_max_ : 0;
+      }
+
+      int32_t
+      Usart_wrapper::send_chain (const struct iovec* iov, int iovcnt)
+      {
+        if ((send_chain_ == nullptr) || (iovcnt <= 0)
+            || (static_cast<uint32_t> (iovcnt) > send_segments_max_))
+          {
+            return ARM_DRIVER_ERROR_UNSUPPORTED;
+          }
+        return send_chain_ (iov, iovcnt);
+      }
+
       int32_t
       Usart_wrapper::receive (void* data, uint32_t num)
       {
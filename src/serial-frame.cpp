@@ -0,0 +1,266 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "posix-drivers/serial-frame.h"
+
+#include <cassert>
+
+// ----------------------------------------------------------------------------
+
+namespace os
+{
+  namespace dev
+  {
+    namespace serial_frame
+    {
+      // ----------------------------------------------------------------------
+
+      uint8_t
+      get_end_delimiter (int mode, uint8_t delimiter)
+      {
+        switch (mode)
+          {
+          case serial_ioctl::framing_slip:
+            return slip_end;
+
+          case serial_ioctl::framing_cobs:
+            return 0;
+
+          default:
+            return delimiter;
+          }
+      }
+
+      std::size_t
+      slip_encode (const uint8_t* src, std::size_t len, uint8_t* dst,
+                   std::size_t size)
+      {
+        assert(src != nullptr || len == 0);
+        assert(dst != nullptr);
+
+        std::size_t out = 0;
+        if (out >= size)
+          {
+            return 0;
+          }
+        dst[out++] = slip_end;
+
+        for (std::size_t i = 0; i < len; ++i)
+          {
+            uint8_t c = src[i];
+            if ((c == slip_end) || (c == slip_esc))
+              {
+                if (out + 2 > size)
+                  {
+                    return 0;
+                  }
+                dst[out++] = slip_esc;
+                dst[out++] = (c == slip_end) ? slip_esc_end : slip_esc_esc;
+              }
+            else
+              {
+                if (out + 1 > size)
+                  {
+                    return 0;
+                  }
+                dst[out++] = c;
+              }
+          }
+
+        if (out >= size)
+          {
+            return 0;
+          }
+        dst[out++] = slip_end;
+        return out;
+      }
+
+      std::size_t
+      cobs_encode (const uint8_t* src, std::size_t len, uint8_t* dst,
+                   std::size_t size)
+      {
+        assert(src != nullptr || len == 0);
+        assert(dst != nullptr);
+
+        if (size < 2)
+          {
+            return 0;
+          }
+
+        // The code byte of the current block is written when the
+        // block ends.
+        std::size_t code_pos = 0;
+        uint8_t code = 1;
+        std::size_t out = 1;
+
+        for (std::size_t i = 0; i < len; ++i)
+          {
+            if (out >= size)
+              {
+                return 0;
+              }
+            if (src[i] == 0)
+              {
+                dst[code_pos] = code;
+                code_pos = out++;
+                code = 1;
+              }
+            else
+              {
+                dst[out++] = src[i];
+                if (++code == 0xFF)
+                  {
+                    if (out >= size)
+                      {
+                        return 0;
+                      }
+                    dst[code_pos] = code;
+                    code_pos = out++;
+                    code = 1;
+                  }
+              }
+          }
+
+        if (out >= size)
+          {
+            return 0;
+          }
+        dst[code_pos] = code;
+        dst[out++] = 0;
+        return out;
+      }
+
+    } /* namespace serial_frame */
+
+    // ------------------------------------------------------------------------
+
+    Serial_frame_decoder::Serial_frame_decoder (int mode, uint8_t delimiter,
+                                                uint8_t* buf,
+                                                std::size_t size) :
+        buf_ (buf), //
+        size_ (size), //
+        mode_ (mode), //
+        delimiter_ (serial_frame::get_end_delimiter (mode, delimiter))
+    {
+      assert(buf != nullptr || size == 0);
+    }
+
+    void
+    Serial_frame_decoder::decode (const uint8_t* src, std::size_t len)
+    {
+      assert(src != nullptr || len == 0);
+
+      switch (mode_)
+        {
+        case serial_ioctl::framing_slip:
+          for (std::size_t i = 0; i < len; ++i)
+            {
+              uint8_t c = src[i];
+              if (slip_escaped_)
+                {
+                  slip_escaped_ = false;
+                  if (c == serial_frame::slip_esc_end)
+                    {
+                      store (serial_frame::slip_end);
+                    }
+                  else if (c == serial_frame::slip_esc_esc)
+                    {
+                      store (serial_frame::slip_esc);
+                    }
+                  else
+                    {
+                      malformed_ = true;
+                      store (c);
+                    }
+                }
+              else if (c == serial_frame::slip_esc)
+                {
+                  slip_escaped_ = true;
+                }
+              else if (c != serial_frame::slip_end)
+                {
+                  store (c);
+                }
+            }
+          break;
+
+        case serial_ioctl::framing_cobs:
+          for (std::size_t i = 0; i < len; ++i)
+            {
+              uint8_t c = src[i];
+              if (c == 0)
+                {
+                  // End of frame; the last block must be complete.
+                  if (cobs_remaining_ != 0)
+                    {
+                      malformed_ = true;
+                    }
+                  cobs_remaining_ = 0;
+                  cobs_zero_ = false;
+                }
+              else if (cobs_remaining_ == 0)
+                {
+                  // A code byte; the zero that ended the previous
+                  // block, if any, is stored now, so that the implicit
+                  // zero at the end of the frame is not.
+                  if (cobs_zero_)
+                    {
+                      store (0);
+                    }
+                  cobs_remaining_ = static_cast<uint8_t> (c - 1);
+                  cobs_zero_ = (c != 0xFF);
+                }
+              else
+                {
+                  store (c);
+                  --cobs_remaining_;
+                }
+            }
+          break;
+
+        case serial_ioctl::framing_delimiter:
+          for (std::size_t i = 0; i < len; ++i)
+            {
+              if (src[i] != delimiter_)
+                {
+                  store (src[i]);
+                }
+            }
+          break;
+
+        default:
+          for (std::size_t i = 0; i < len; ++i)
+            {
+              store (src[i]);
+            }
+          break;
+        }
+    }
+
+  } /* namespace dev */
+} /* namespace os */
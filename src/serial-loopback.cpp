@@ -0,0 +1,622 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#if !defined(__ARM_EABI__)
+
+#include "posix-drivers/serial-loopback.h"
+
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+// ----------------------------------------------------------------------------
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    namespace
+    {
+      // Start bit, 8 data bits, stop bit.
+      constexpr uint32_t bits_per_char = 10;
+    }
+
+    // ------------------------------------------------------------------------
+
+    Serial_loopback::Serial_loopback (uint32_t tick_us) :
+        tick_us_ (tick_us)
+    {
+      capabilities_.asynchronous = true;
+      capabilities_.event_tx_complete = true;
+      capabilities_.event_rx_timeout = true;
+      capabilities_.rts = true;
+      capabilities_.cts = true;
+      capabilities_.dtr = true;
+      capabilities_.dsr = true;
+      capabilities_.event_cts = true;
+      capabilities_.event_dsr = true;
+
+      thread_ = std::thread (&Serial_loopback::run, this);
+    }
+
+    Serial_loopback::~Serial_loopback ()
+    {
+      exit_ = true;
+      thread_.join ();
+    }
+
+    std::recursive_mutex&
+    Serial_loopback::mutex (void)
+    {
+      static std::recursive_mutex mutex;
+      return mutex;
+    }
+
+    // ------------------------------------------------------------------------
+
+    void
+    Serial_loopback::set_paced (bool paced)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      paced_ = paced;
+    }
+
+    void
+    Serial_loopback::set_rx_idle_chars (uint32_t chars)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      rx_idle_chars_ = chars;
+    }
+
+    void
+    Serial_loopback::set_rx_progress (bool enabled)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      rx_progress_ = enabled;
+    }
+
+    os::driver::Power
+    Serial_loopback::get_power (void)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      return power_;
+    }
+
+    bool
+    Serial_loopback::is_rts_active (void)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      return rts_;
+    }
+
+    void
+    Serial_loopback::set_dcd (bool active)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      capabilities_.dcd = true;
+      capabilities_.event_dcd = true;
+      if (active != dcd_)
+        {
+          dcd_ = active;
+          modem_events_ |= os::driver::serial::Event::dcd;
+        }
+    }
+
+    Serial_loopback::Counters
+    Serial_loopback::get_counters (void)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      return counters_;
+    }
+
+    void
+    Serial_loopback::reset_counters (void)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      counters_ = Counters ();
+    }
+
+    // ------------------------------------------------------------------------
+
+    // The thread, the "hardware".
+
+    void
+    Serial_loopback::run (void)
+    {
+      auto last = std::chrono::steady_clock::now ();
+
+      while (!exit_)
+        {
+          std::this_thread::sleep_for (std::chrono::microseconds (tick_us_));
+
+          auto now = std::chrono::steady_clock::now ();
+          uint64_t elapsed = static_cast<uint64_t> (std::chrono::duration_cast<
+              std::chrono::nanoseconds> (now - last).count ());
+          last = now;
+
+          std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+          if (modem_events_ != 0)
+            {
+              // The modem status interrupt.
+              os::driver::event_t event = modem_events_;
+              modem_events_ = 0;
+              signal (event);
+            }
+
+          uint64_t char_time = (1000000000ull * bits_per_char) / baud_rate_;
+          std::size_t due;
+          if (paced_)
+            {
+              credit_ += elapsed;
+              due = static_cast<std::size_t> (credit_ / char_time);
+              credit_ -= due * char_time;
+            }
+          else
+            {
+              due = std::numeric_limits<std::size_t>::max ();
+            }
+
+          std::size_t moved = move (due);
+          if (moved < due)
+            {
+              // The line was idle for part of the tick; do not
+              // accumulate the unused time.
+              credit_ = 0;
+            }
+
+          if (moved > 0)
+            {
+              rx_idle_time_ = 0;
+            }
+          else
+            {
+              rx_idle_time_ += elapsed;
+              if ((rx_count_ != rx_reported_)
+                  && (!paced_ || (rx_idle_time_ >= rx_idle_chars_ * char_time)))
+                {
+                  // Report the bytes received so far.
+                  rx_reported_ = rx_count_;
+                  signal (os::driver::serial::Event::rx_timeout);
+                }
+            }
+        }
+    }
+
+    std::size_t
+    Serial_loopback::move (std::size_t count)
+    {
+      std::size_t done = 0;
+      while (done < count)
+        {
+          std::size_t n = tx_size_ - tx_count_;
+          if (!tx_enabled_ || (n == 0))
+            {
+              break;
+            }
+          n = (n < count - done) ? n : (count - done);
+
+          os::driver::event_t event = 0;
+          std::size_t rx_left = rx_enabled_ ? (rx_size_ - rx_count_) : 0;
+          if (rx_left > 0)
+            {
+              // Stop at the end of the receive, the callback
+              // might arm the next one.
+              n = (n < rx_left) ? n : rx_left;
+              std::size_t half = rx_size_ / 2;
+              if (rx_progress_ && (rx_count_ < half)
+                  && (rx_count_ + n > half))
+                {
+                  // Also stop at the half, to report exactly it.
+                  n = half - rx_count_;
+                }
+              std::memcpy (rx_buf_ + rx_count_, tx_buf_ + tx_count_, n);
+              bool is_half = (rx_count_ < half) && (rx_count_ + n >= half);
+              rx_count_ += n;
+              counters_.rx_bytes += n;
+              if (rx_count_ == rx_size_)
+                {
+                  rx_reported_ = rx_count_;
+                  event |= os::driver::serial::Event::receive_complete;
+                }
+              else if (rx_progress_ && is_half)
+                {
+                  // The half-transfer interrupt.
+                  rx_reported_ = rx_count_;
+                  event |= serial_event::rx_progress;
+                }
+            }
+          else
+            {
+              // Nowhere to store them.
+              counters_.rx_dropped += n;
+              if (rx_enabled_)
+                {
+                  event |= os::driver::serial::Event::rx_overflow;
+                }
+            }
+
+          tx_count_ += n;
+          done += n;
+          load_chain_segment ();
+          if (!is_tx_busy ())
+            {
+              event |= os::driver::serial::Event::send_complete
+                  | os::driver::serial::Event::tx_complete;
+            }
+
+          if (event != 0)
+            {
+              signal (event);
+            }
+        }
+      return done;
+    }
+
+    void
+    Serial_loopback::signal (os::driver::event_t event)
+    {
+      ++counters_.callbacks;
+      if (cb_func_ != nullptr)
+        {
+          cb_func_ (cb_object_, event);
+        }
+    }
+
+    bool
+    Serial_loopback::is_tx_busy (void) const
+    {
+      return (tx_count_ != tx_size_) || (tx_chain_next_ < tx_chain_size_);
+    }
+
+    void
+    Serial_loopback::load_chain_segment (void)
+    {
+      while ((tx_count_ == tx_size_) && (tx_chain_next_ < tx_chain_size_))
+        {
+          tx_chain_done_ += tx_size_;
+          const struct iovec& seg = tx_chain_[tx_chain_next_++];
+          tx_buf_ = static_cast<const uint8_t*> (seg.iov_base);
+          tx_size_ = seg.iov_len;
+          tx_count_ = 0;
+        }
+    }
+
+    void
+    Serial_loopback::set_send_chain_max (int segments)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      send_chain_max_ =
+          (segments < max_chain_segments) ? segments : max_chain_segments;
+    }
+
+    void
+    Serial_loopback::set_send_errors (std::size_t count)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      send_errors_ = count;
+    }
+
+    void
+    Serial_loopback::set_receive_errors (std::size_t count)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      receive_errors_ = count;
+    }
+
+    void
+    Serial_loopback::set_power_errors (std::size_t count)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      power_errors_ = count;
+    }
+
+    std::size_t
+    Serial_loopback::get_send_segments_max (void)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      return static_cast<std::size_t> (send_chain_max_);
+    }
+
+    os::driver::return_t
+    Serial_loopback::send_chain (const struct iovec* iov, int iovcnt)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      if ((iovcnt <= 0) || (iovcnt > send_chain_max_))
+        {
+          return os::driver::ERROR_UNSUPPORTED;
+        }
+      if (is_tx_busy ())
+        {
+          return os::driver::ERROR;
+        }
+
+      ++counters_.sends;
+      ++counters_.chained_sends;
+      if (power_ == os::driver::Power::low)
+        {
+          ++counters_.low_power_sends;
+        }
+      std::memcpy (tx_chain_, iov, sizeof(struct iovec) * iovcnt);
+      tx_chain_size_ = iovcnt;
+      tx_chain_next_ = 0;
+      tx_chain_done_ = 0;
+      tx_buf_ = nullptr;
+      tx_size_ = 0;
+      tx_count_ = 0;
+      load_chain_segment ();
+      return os::driver::RETURN_OK;
+    }
+
+    // ------------------------------------------------------------------------
+
+    os::driver::serial::Capabilities&
+    Serial_loopback::do_get_capabilities (void)
+    {
+      return capabilities_;
+    }
+
+    os::driver::return_t
+    Serial_loopback::do_power (os::driver::Power state)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      if ((state == os::driver::Power::full) && (power_errors_ > 0))
+        {
+          --power_errors_;
+          return os::driver::ERROR;
+        }
+      if (state != power_)
+        {
+          ++counters_.power_changes;
+          power_ = state;
+        }
+      return os::driver::RETURN_OK;
+    }
+
+    os::driver::return_t
+    Serial_loopback::do_send (const void* data, std::size_t num)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      if (is_tx_busy ())
+        {
+          // Busy.
+          return os::driver::ERROR;
+        }
+      if (send_errors_ > 0)
+        {
+          --send_errors_;
+          return os::driver::ERROR;
+        }
+
+      ++counters_.sends;
+      if (power_ == os::driver::Power::low)
+        {
+          ++counters_.low_power_sends;
+        }
+      tx_chain_size_ = 0;
+      tx_chain_next_ = 0;
+      tx_chain_done_ = 0;
+      tx_buf_ = static_cast<const uint8_t*> (data);
+      tx_size_ = num;
+      tx_count_ = 0;
+      return os::driver::RETURN_OK;
+    }
+
+    os::driver::return_t
+    Serial_loopback::do_receive (void* data, std::size_t num)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      if (receive_errors_ > 0)
+        {
+          --receive_errors_;
+          return os::driver::ERROR;
+        }
+
+      ++counters_.receives;
+      rx_buf_ = static_cast<uint8_t*> (data);
+      rx_size_ = num;
+      rx_count_ = 0;
+      rx_reported_ = 0;
+      return os::driver::RETURN_OK;
+    }
+
+    std::size_t
+    Serial_loopback::do_get_tx_count (void)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      return tx_chain_done_ + tx_count_;
+    }
+
+    std::size_t
+    Serial_loopback::do_get_rx_count (void)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      return rx_count_;
+    }
+
+    os::driver::return_t
+    Serial_loopback::do_configure (
+        os::driver::serial::config_t cfg __attribute__((unused)),
+        os::driver::serial::config_arg_t arg)
+    {
+      if (arg == 0)
+        {
+          return os::driver::ERROR;
+        }
+
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      baud_rate_ = arg;
+      credit_ = 0;
+      return os::driver::RETURN_OK;
+    }
+
+    os::driver::return_t
+    Serial_loopback::do_control (os::driver::serial::Control ctrl)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      switch (ctrl)
+        {
+        case os::driver::serial::Control::enable_tx:
+          tx_enabled_ = true;
+          break;
+
+        case os::driver::serial::Control::disable_tx:
+          tx_enabled_ = false;
+          break;
+
+        case os::driver::serial::Control::enable_rx:
+          rx_enabled_ = true;
+          break;
+
+        case os::driver::serial::Control::disable_rx:
+          rx_enabled_ = false;
+          break;
+
+        case os::driver::serial::Control::enable_break:
+        case os::driver::serial::Control::disable_break:
+          // There is no line to hold.
+          break;
+
+        case os::driver::serial::Control::abort_send:
+          tx_size_ = tx_count_;
+          tx_chain_next_ = tx_chain_size_;
+          break;
+
+        case os::driver::serial::Control::abort_receive:
+          rx_size_ = rx_count_;
+          break;
+
+        case os::driver::serial::Control::abort_transfer:
+          tx_size_ = tx_count_;
+          tx_chain_next_ = tx_chain_size_;
+          rx_size_ = rx_count_;
+          break;
+
+        default:
+          return os::driver::ERROR_UNSUPPORTED;
+        }
+      return os::driver::RETURN_OK;
+    }
+
+    os::driver::serial::Status
+    Serial_loopback::do_get_status (void)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      os::driver::serial::Status status
+        { };
+      status.tx_busy = is_tx_busy ();
+      status.rx_busy = (rx_count_ != rx_size_);
+      return status;
+    }
+
+    os::driver::return_t
+    Serial_loopback::do_control_modem_line (
+        os::driver::serial::Modem_control ctrl)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      bool rts = rts_;
+      bool dtr = dtr_;
+      switch (ctrl)
+        {
+        case os::driver::serial::Modem_control::activate_rts:
+          rts = true;
+          break;
+
+        case os::driver::serial::Modem_control::deactivate_rts:
+          rts = false;
+          break;
+
+        case os::driver::serial::Modem_control::activate_dtr:
+          dtr = true;
+          break;
+
+        case os::driver::serial::Modem_control::deactivate_dtr:
+          dtr = false;
+          break;
+
+        default:
+          return os::driver::ERROR_UNSUPPORTED;
+        }
+
+      if (rts != rts_)
+        {
+          rts_ = rts;
+          ++counters_.rts_changes;
+          modem_events_ |= os::driver::serial::Event::cts;
+        }
+      if (dtr != dtr_)
+        {
+          dtr_ = dtr;
+          modem_events_ |= os::driver::serial::Event::dsr;
+        }
+      return os::driver::RETURN_OK;
+    }
+
+    os::driver::serial::Modem_status
+    Serial_loopback::do_get_modem_status (void)
+    {
+      std::lock_guard<std::recursive_mutex> lock (mutex ());
+
+      os::driver::serial::Modem_status status
+        { };
+      status.cts = rts_;
+      status.dsr = dtr_;
+      status.dcd = dcd_;
+      return status;
+    }
+
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* !defined(__ARM_EABI__) */
+
@@ -0,0 +1,106 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "posix-drivers/serial-poll.h"
+
+#include <cassert>
+#include <cerrno>
+
+// ----------------------------------------------------------------------------
+
+namespace os
+{
+  namespace dev
+  {
+    // ------------------------------------------------------------------------
+
+    Serial_poll_event::Serial_poll_event (const char* name) :
+        sem_
+          { name, 0 }
+    {
+      ;
+    }
+
+    void
+    Serial_poll_event::post (void)
+    {
+      sem_.post ();
+    }
+
+    int
+    Serial_poll_event::wait (os::rtos::clock::duration_t timeout)
+    {
+      if (timeout == 0)
+        {
+          sem_.wait ();
+          return 0;
+        }
+      if (sem_.timed_wait (timeout) == ETIMEDOUT)
+        {
+          return ETIMEDOUT;
+        }
+      return 0;
+    }
+
+    // ------------------------------------------------------------------------
+
+    int
+    poll_serial (Serial_pollfd* fds, std::size_t nfds,
+                 Serial_poll_event& event,
+                 os::rtos::clock::duration_t timeout)
+    {
+      assert(fds != nullptr || nfds == 0);
+
+      while (true)
+        {
+          int count = 0;
+          for (std::size_t i = 0; i < nfds; ++i)
+            {
+              fds[i].revents = fds[i].device->get_poll_events ()
+                  & (fds[i].events | serial_poll::hangup);
+              if (fds[i].revents != 0)
+                {
+                  ++count;
+                }
+            }
+          if (count > 0)
+            {
+              return count;
+            }
+
+          // A post between the checks and the wait is not lost,
+          // the semaphore keeps it.
+          if (event.wait (timeout) == ETIMEDOUT)
+            {
+              return 0;
+            }
+        }
+    }
+
+  } /* namespace dev */
+} /* namespace os */
@@ -0,0 +1,100 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "posix-drivers/serial-trace.h"
+#include <cmsis-plus/diag/trace.h>
+
+// ----------------------------------------------------------------------------
+
+#if defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_TRACE)
+
+namespace os
+{
+  namespace dev
+  {
+    namespace serial_trace
+    {
+      // ----------------------------------------------------------------------
+
+      Record records[size];
+#if defined(__ARM_ARCH_6M__)
+      uint32_t volatile next = 0;
+#else
+      std::atomic<uint32_t> next
+        { 0 };
+#endif
+
+      // ----------------------------------------------------------------------
+
+      void
+      clear (void)
+      {
+#if defined(__ARM_ARCH_6M__)
+        next = 0;
+#else
+        next.store (0, std::memory_order_relaxed);
+#endif
+      }
+
+      void
+      dump (void)
+      {
+        static const char* const names[points_count] =
+          { "isr_enter", "isr_exit", "send", "receive", "rx_post", "tx_post",
+              "rx_wait", "rx_wakeup", "tx_wait", "tx_wakeup", "read_return" };
+
+#if defined(__ARM_ARCH_6M__)
+        uint32_t end = next;
+#else
+        uint32_t end = next.load (std::memory_order_relaxed);
+#endif
+        uint32_t begin = (end > size) ? (end - size) : 0;
+
+        os::trace::printf ("%s (%u records)\n", __PRETTY_FUNCTION__,
+                           (unsigned int) (end - begin));
+
+        uint32_t previous = 0;
+        for (uint32_t i = begin; i < end; ++i)
+          {
+            const Record& r = records[i & (size - 1)];
+            uint32_t delta = (i == begin) ? 0 : (r.cycles - previous);
+            previous = r.cycles;
+
+            os::trace::printf (
+                "%10u +%-8u %p %-12s %u\n", (unsigned int) r.cycles,
+                (unsigned int) delta, r.device,
+                (r.point < points_count) ? names[r.point] : "?",
+                (unsigned int) r.arg);
+          }
+      }
+
+    } /* namespace serial_trace */
+  } /* namespace dev */
+} /* namespace os */
+
+#endif /* defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_TRACE) */
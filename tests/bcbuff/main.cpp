@@ -79,9 +79,13 @@ main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
   // Array operator.
   assert(cb[2] == '2');
 
+  // Maximum length.
+  assert(cb.getMaxLength () == 5);
+
   // Clear.
   cb.clear ();
   assert(cb.isEmpty ());
+  assert(cb.getMaxLength () == 0);
 
   //  0 1 2 3 4
   // | |x|x| | |
@@ -193,6 +197,165 @@ main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
   assert(ch[3] == 'g');
   assert(ch[4] == '?');
 
+  // Zero-copy access, wrapped data.
+  cb.clear ();
+  assert(cb.pushBack ((uint8_t* )"abcd", 4) == 4);
+  assert(cb.advanceFront (3) == 3);
+  assert(cb.pushBack ((uint8_t* )"xyz", 3) == 3);
+
+  uint8_t* pb2;
+  std::size_t len1;
+  std::size_t len2;
+  assert(cb.peekFront (&pb, &len1, &pb2, &len2) == 4);
+  assert(pb == &buff[3]);
+  assert(len1 == 2);
+  assert(pb2 == &buff[0]);
+  assert(len2 == 2);
+  assert(pb[0] == 'd' && pb[1] == 'x' && pb2[0] == 'y' && pb2[1] == 'z');
+
+  // Scan, wrapped data.
+  assert(cb.find ('d') == 0);
+  assert(cb.find ('y') == 2);
+  assert(cb.find ('z', 3) == 3);
+  assert(cb.find ('x', 2) == os::dev::ByteCircularBuffer::npos);
+  assert(cb.find ('d', 4) == os::dev::ByteCircularBuffer::npos);
+  assert(cb.count ('y') == 1);
+  assert(cb.count ('?') == 0);
+
+  assert(cb.reserveBack (&pb, &len1, &pb2, &len2) == 1);
+  assert(pb == &buff[2]);
+  assert(len1 == 1);
+  assert(len2 == 0);
+
+  // Consume and commit.
+  assert(cb.advanceFront (4) == 4);
+  assert(cb.reserveBack (&pb, &len1, &pb2, &len2) == 5);
+  assert(len1 == 3);
+  assert(len2 == 2);
+  pb[0] = 'r';
+  assert(cb.advanceBack (1) == 1);
+  assert(cb.getMaxLength () == 4);
+  assert(cb.popFront (&ch[0]) == 1);
+  assert(ch[0] == 'r');
+
+  cb.resetMaxLength ();
+  assert(cb.getMaxLength () == 0);
+  assert(cb.pushBack ((uint8_t* )"st", 2) == 2);
+  assert(cb.getMaxLength () == 2);
+
+  // Scan, a word at a time, wrapped data.
+  uint8_t lbuff[64];
+  uint8_t line[60];
+  os::dev::ByteCircularBuffer lcb
+    { lbuff, sizeof(lbuff) };
+  std::memset (line, '.', sizeof(line));
+  line[55] = '\n';
+  assert(lcb.pushBack (line, 60) == 60);
+  assert(lcb.advanceFront (50) == 50);
+  std::memset (line, '.', sizeof(line));
+  line[20] = '\n';
+  line[35] = '\n';
+  assert(lcb.pushBack (line, 40) == 40);
+  assert(lcb.length () == 50);
+
+  assert(lcb.find ('\n') == 5);
+  assert(lcb.find ('\n', 6) == 30);
+  assert(lcb.find ('\n', 31) == 45);
+  assert(lcb.find ('\n', 46) == os::dev::ByteCircularBuffer::npos);
+  assert(lcb.find ('?') == os::dev::ByteCircularBuffer::npos);
+  assert(lcb.count ('\n') == 3);
+  assert(lcb.count ('.') == 47);
+
+  // History before the back, wrapped; the stream is "abcdefghij",
+  // the last 8 bytes are still in the storage.
+  uint8_t hbuff[8];
+  os::dev::ByteCircularBuffer hcb
+    { hbuff, sizeof(hbuff) };
+  assert(hcb.pushBack ((uint8_t* )"abcdef", 6) == 6);
+  assert(hcb.advanceFront (6) == 6);
+  assert(hcb.pushBack ((uint8_t* )"ghij", 4) == 4);
+
+  assert(hcb.copyBeforeBack (6, ch, 6) == 6);
+  assert(std::memcmp (ch, "efghij", 6) == 0);
+  assert(hcb.copyBeforeBack (8, ch, 3) == 3);
+  assert(std::memcmp (ch, "cde", 3) == 0);
+  assert(hcb.copyBeforeBack (20, ch, 6) == 6);
+  assert(std::memcmp (ch, "cdefgh", 6) == 0);
+  assert(hcb.copyBeforeBack (2, ch, 6) == 2);
+  assert(std::memcmp (ch, "ij", 2) == 0);
+  assert(hcb.copyBeforeBack (0, ch, 6) == 0);
+
+  const uint8_t* hpb;
+  const uint8_t* hpb2;
+  assert(hcb.peekBeforeBack (6, 6, &hpb, &len1, &hpb2, &len2) == 6);
+  assert(len1 == 4 && std::memcmp (hpb, "efgh", 4) == 0);
+  assert(len2 == 2 && std::memcmp (hpb2, "ij", 2) == 0);
+  assert(hcb.peekBeforeBack (8, 3, &hpb, &len1, &hpb2, &len2) == 3);
+  assert(len1 == 3 && len2 == 0 && std::memcmp (hpb, "cde", 3) == 0);
+
+  // Every short length, at every position, both sides of the inline
+  // copies; the bytes after the copied ones must not be touched.
+  uint8_t sbuff[32];
+  os::dev::ByteCircularBuffer scb
+    { sbuff, sizeof(sbuff) };
+  uint8_t pattern[20];
+  for (std::size_t i = 0; i < sizeof(pattern); ++i)
+    {
+      pattern[i] = static_cast<uint8_t> ('A' + i);
+    }
+  for (std::size_t offset = 0; offset < sizeof(sbuff); ++offset)
+    {
+      for (std::size_t len = 0; len <= sizeof(pattern); ++len)
+        {
+          scb.clear ();
+          assert(scb.advanceBack (offset) == offset);
+          assert(scb.advanceFront (offset) == offset);
+
+          uint8_t out[sizeof(pattern) + 1];
+          std::memset (out, '!', sizeof(out));
+          assert(scb.pushBack (pattern, len) == len);
+          assert(scb.popFront (out, len) == len);
+          assert(std::memcmp (out, pattern, len) == 0);
+          assert(out[len] == '!');
+          assert(scb.isEmpty ());
+        }
+    }
+
+  // Compile time sized buffer.
+  os::dev::TByteCircularBuffer<8, 6, 2> tcb;
+  static_assert(tcb.size () == 8, "size");
+  static_assert(tcb.highWaterMark == 6, "hwm");
+
+  assert(tcb.isEmpty ());
+  assert(tcb.pushBack ((uint8_t* )"abcdef", 6) == 6);
+  assert(tcb.isAboveHighWaterMark ());
+  assert(tcb.popFront (ch, 5) == 5);
+  assert(ch[0] == 'a');
+  assert(ch[4] == 'e');
+  assert(tcb.isBelowLowWaterMark ());
+
+  // Wrap with the mask.
+  assert(tcb.pushBack ((uint8_t* )"ghijkl", 6) == 6);
+  assert(tcb.pushBack ('m') == 1);
+  assert(tcb.isFull ());
+  assert(tcb.pushBack ('?') == 0);
+
+  pb = nullptr;
+  assert(tcb.getBackContiguousBuffer (&pb) == 0);
+
+  assert(tcb.popFront (&ch[0]) == 1);
+  assert(ch[0] == 'f');
+
+  // Also usable via the base class.
+  os::dev::ByteCircularBuffer* pcb = &tcb;
+  assert(pcb->length () == 7);
+  assert(pcb->popFront (ch, 6) == 6);
+  assert(ch[0] == 'g');
+  assert(ch[5] == 'l');
+  assert(tcb.popFront (&ch[0]) == 1);
+  assert(ch[0] == 'm');
+  assert(tcb.length () == 0);
+
   // cb.dump();
   os::trace::puts ("'test-bcbuff-debug' succeeded.");
   return 0;
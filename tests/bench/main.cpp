@@ -0,0 +1,474 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Host benchmarks for the circular buffers and for the buffered serial
+// device data path. On target, define OS_POSIX_DRIVERS_SERIAL_CYCLES()
+// to read the cycle counter, and the results are in cycles; on the
+// host they are in nanoseconds, from std::chrono.
+
+#if defined(OS_POSIX_DRIVERS_SERIAL_CYCLES)
+#define BENCH_USE_CYCLES
+#endif
+
+#include "posix-drivers/ByteCircularBuffer.h"
+#include "posix-drivers/SpscByteCircularBuffer.h"
+#include "posix-drivers/buffered-serial-device.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cassert>
+#include <cstring>
+#include <cstdio>
+
+#if !defined(BENCH_USE_CYCLES)
+#include <chrono>
+#endif
+
+// ----------------------------------------------------------------------------
+
+namespace
+{
+  // Total number of bytes moved by each measurement.
+  constexpr std::size_t bench_total = 1024 * 1024;
+
+  uint8_t src[4096];
+  uint8_t dst[4096];
+
+  // --------------------------------------------------------------------------
+
+  inline uint64_t
+  bench_now (void)
+  {
+#if defined(BENCH_USE_CYCLES)
+    return OS_POSIX_DRIVERS_SERIAL_CYCLES ();
+#else
+    return static_cast<uint64_t> (std::chrono::duration_cast<
+        std::chrono::nanoseconds> (
+        std::chrono::steady_clock::now ().time_since_epoch ()).count ());
+#endif
+  }
+
+  inline uint64_t
+  bench_elapsed (uint64_t begin)
+  {
+#if defined(BENCH_USE_CYCLES)
+    // The cycle counter is 32-bit and wraps.
+    return static_cast<uint32_t> (bench_now () - begin);
+#else
+    return bench_now () - begin;
+#endif
+  }
+
+  void
+  bench_report (const char* name, std::size_t size, std::size_t chunk,
+                std::size_t offset, uint64_t elapsed, std::size_t bytes)
+  {
+    std::printf ("%-24s size %5u chunk %4u offset %5u: %8.3f %s/byte\n",
+                 name, static_cast<unsigned int> (size),
+                 static_cast<unsigned int> (chunk),
+                 static_cast<unsigned int> (offset),
+                 static_cast<double> (elapsed) / static_cast<double> (bytes),
+#if defined(BENCH_USE_CYCLES)
+                 "cycles"
+#else
+                 "ns"
+#endif
+                 );
+  }
+
+  // --------------------------------------------------------------------------
+
+  // Move the indices so the transfers start at the offset, to measure
+  // the wrap paths; the offset must be less than the size.
+  template<typename Buffer_T>
+    void
+    bench_position (Buffer_T& cb, std::size_t offset)
+    {
+      cb.clear ();
+      std::size_t n = cb.pushBack (src, offset);
+      assert(n == offset);
+      n = cb.advanceFront (offset);
+      assert(n == offset);
+    }
+
+  // Byte at a time, as the per character drivers do.
+  template<typename Buffer_T>
+    void
+    bench_bytes (const char* name, Buffer_T& cb, std::size_t offset)
+    {
+      std::size_t chunk = cb.size () / 2;
+      bench_position (cb, offset);
+
+      uint64_t begin = bench_now ();
+      for (std::size_t done = 0; done < bench_total; done += chunk)
+        {
+          for (std::size_t i = 0; i < chunk; ++i)
+            {
+              cb.pushBack (src[i]);
+            }
+          for (std::size_t i = 0; i < chunk; ++i)
+            {
+              cb.popFront (&dst[i]);
+            }
+        }
+      uint64_t elapsed = bench_elapsed (begin);
+
+      assert(std::memcmp (src, dst, chunk) == 0);
+      bench_report (name, cb.size (), 1, offset, elapsed, bench_total);
+    }
+
+  // Bulk copies, the chunk must be at most the size.
+  template<typename Buffer_T>
+    void
+    bench_bulk (const char* name, Buffer_T& cb, std::size_t chunk,
+                std::size_t offset)
+    {
+      bench_position (cb, offset);
+
+      uint64_t begin = bench_now ();
+      for (std::size_t done = 0; done < bench_total; done += chunk)
+        {
+          cb.pushBack (src, chunk);
+          cb.popFront (dst, chunk);
+        }
+      uint64_t elapsed = bench_elapsed (begin);
+
+      assert(cb.isEmpty ());
+      assert(std::memcmp (src, dst, chunk) == 0);
+      bench_report (name, cb.size (), chunk, offset, elapsed, bench_total);
+    }
+
+  template<typename Buffer_T>
+    void
+    bench_buffer (const char* name, Buffer_T& cb)
+    {
+      std::size_t size = cb.size ();
+      // No wrap, and the first transfer wraps in the middle.
+      const std::size_t offsets[] =
+        { 0, size - 7 };
+
+      for (std::size_t offset : offsets)
+        {
+          bench_bytes (name, cb, offset);
+
+          // The short transfers of the console traffic.
+          const std::size_t small_chunks[] =
+            { 2, 3, 8 };
+          for (std::size_t chunk : small_chunks)
+            {
+              bench_bulk (name, cb, chunk, offset);
+            }
+
+          for (std::size_t chunk = 4; chunk <= size; chunk *= 4)
+            {
+              bench_bulk (name, cb, chunk, offset);
+            }
+        }
+    }
+
+  // --------------------------------------------------------------------------
+
+  // A serial driver simulated in memory, with the transmit line
+  // connected to the receive line. The transfers only record the
+  // buffers; pump() plays the role of the DMA and of the interrupt,
+  // moving up to a burst of bytes and calling the callback, from the
+  // caller context, never from within a driver call.
+  class Bench_serial : public os::driver::Serial
+  {
+  public:
+
+    Bench_serial (std::size_t burst) :
+        burst_ (burst)
+    {
+      capabilities_.asynchronous = true;
+      capabilities_.event_tx_complete = true;
+      capabilities_.event_rx_timeout = true;
+    }
+
+    // Return false when there is nothing to move.
+    bool
+    pump (void)
+    {
+      std::size_t tx_left = tx_size_ - tx_count_;
+      std::size_t rx_left = rx_size_ - rx_count_;
+      if (tx_left == 0)
+        {
+          return false;
+        }
+
+      std::size_t n = burst_;
+      n = (tx_left < n) ? tx_left : n;
+      n = (rx_left < n) ? rx_left : n;
+
+      std::memcpy (rx_buf_ + rx_count_, tx_buf_ + tx_count_, n);
+      tx_count_ += n;
+      rx_count_ += n;
+
+      os::driver::event_t event = 0;
+      if (rx_count_ == rx_size_)
+        {
+          event |= os::driver::serial::Event::receive_complete;
+        }
+      if (tx_count_ == tx_size_)
+        {
+          event |= os::driver::serial::Event::send_complete
+              | os::driver::serial::Event::tx_complete;
+          if ((event & os::driver::serial::Event::receive_complete) == 0)
+            {
+              // The line becomes idle after the last byte.
+              event |= os::driver::serial::Event::rx_timeout;
+            }
+        }
+
+      ++events_;
+      if (event != 0)
+        {
+          cb_func_ (cb_object_, event);
+        }
+      return true;
+    }
+
+    std::size_t
+    get_events (void) const
+    {
+      return events_;
+    }
+
+  protected:
+
+    virtual os::driver::serial::Capabilities&
+    do_get_capabilities (void) override
+    {
+      return capabilities_;
+    }
+
+    virtual os::driver::return_t
+    do_power (os::driver::Power state __attribute__((unused))) override
+    {
+      return os::driver::RETURN_OK;
+    }
+
+    virtual os::driver::return_t
+    do_send (const void* data, std::size_t num) override
+    {
+      tx_buf_ = static_cast<const uint8_t*> (data);
+      tx_size_ = num;
+      tx_count_ = 0;
+      return os::driver::RETURN_OK;
+    }
+
+    virtual os::driver::return_t
+    do_receive (void* data, std::size_t num) override
+    {
+      rx_buf_ = static_cast<uint8_t*> (data);
+      rx_size_ = num;
+      rx_count_ = 0;
+      return os::driver::RETURN_OK;
+    }
+
+    virtual std::size_t
+    do_get_tx_count (void) override
+    {
+      return tx_count_;
+    }
+
+    virtual std::size_t
+    do_get_rx_count (void) override
+    {
+      return rx_count_;
+    }
+
+    virtual os::driver::return_t
+    do_configure (os::driver::serial::config_t cfg __attribute__((unused)),
+                  os::driver::serial::config_arg_t arg __attribute__((unused))) override
+    {
+      return os::driver::RETURN_OK;
+    }
+
+    virtual os::driver::return_t
+    do_control (os::driver::serial::Control ctrl) override
+    {
+      if ((ctrl == os::driver::serial::Control::abort_send)
+          || (ctrl == os::driver::serial::Control::abort_transfer))
+        {
+          tx_size_ = tx_count_;
+        }
+      if ((ctrl == os::driver::serial::Control::abort_receive)
+          || (ctrl == os::driver::serial::Control::abort_transfer))
+        {
+          rx_size_ = rx_count_;
+        }
+      return os::driver::RETURN_OK;
+    }
+
+    virtual os::driver::serial::Status
+    do_get_status (void) override
+    {
+      os::driver::serial::Status status
+        { };
+      status.tx_busy = (tx_count_ != tx_size_);
+      status.rx_busy = (rx_count_ != rx_size_);
+      return status;
+    }
+
+    virtual os::driver::return_t
+    do_control_modem_line (
+        os::driver::serial::Modem_control ctrl __attribute__((unused))) override
+    {
+      return os::driver::ERROR_UNSUPPORTED;
+    }
+
+    virtual os::driver::serial::Modem_status
+    do_get_modem_status (void) override
+    {
+      return os::driver::serial::Modem_status
+        { };
+    }
+
+  private:
+
+    os::driver::serial::Capabilities capabilities_
+      { };
+
+    const uint8_t* tx_buf_ = nullptr;
+    std::size_t tx_size_ = 0;
+    std::size_t tx_count_ = 0;
+
+    uint8_t* rx_buf_ = nullptr;
+    std::size_t rx_size_ = 0;
+    std::size_t rx_count_ = 0;
+
+    std::size_t burst_;
+    std::size_t events_ = 0;
+  };
+
+  // --------------------------------------------------------------------------
+
+  // write() a chunk, let the simulated driver move it, read() it back;
+  // the chunk must be smaller than the buffers.
+  template<typename Buffer_T>
+    void
+    bench_device (const char* name, Buffer_T& rx_buf, Buffer_T& tx_buf,
+                  std::size_t chunk, std::size_t burst)
+    {
+      Bench_serial driver
+        { burst };
+      os::dev::Buffered_serial_device<os::dev::Null_critical_section, Buffer_T> device
+        { "bench", &driver, &rx_buf, &tx_buf };
+
+      int ret = device.open (nullptr, 0);
+      assert(ret == 0);
+
+      uint64_t begin = bench_now ();
+      for (std::size_t done = 0; done < bench_total; done += chunk)
+        {
+          ssize_t n = device.write (src, chunk);
+          assert(n == static_cast<ssize_t> (chunk));
+
+          while (driver.pump ())
+            {
+              ;
+            }
+
+          std::size_t got = 0;
+          while (got < chunk)
+            {
+              n = device.read (dst + got, chunk - got);
+              assert(n > 0);
+              got += static_cast<std::size_t> (n);
+            }
+        }
+      uint64_t elapsed = bench_elapsed (begin);
+
+      assert(std::memcmp (src, dst, chunk) == 0);
+      bench_report (name, rx_buf.size (), chunk, burst, elapsed,
+                    bench_total);
+      std::printf ("%-24s %8.3f driver events/KB\n", name,
+                   static_cast<double> (driver.get_events ()) * 1024
+                       / static_cast<double> (bench_total));
+
+      device.close ();
+    }
+
+} /* namespace */
+
+// ----------------------------------------------------------------------------
+
+int
+main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
+{
+  for (std::size_t i = 0; i < sizeof(src); ++i)
+    {
+      src[i] = static_cast<uint8_t> (i * 7 + 1);
+    }
+
+  static uint8_t storage[4096];
+
+  const std::size_t sizes[] =
+    { 64, 256, 4096 };
+  for (std::size_t size : sizes)
+    {
+      os::dev::ByteCircularBuffer cb
+        { storage, size };
+      bench_buffer ("ByteCircularBuffer", cb);
+
+      os::dev::SpscByteCircularBuffer scb
+        { storage, size };
+      bench_buffer ("SpscByteCircularBuffer", scb);
+    }
+
+  os::dev::TByteCircularBuffer<256> tcb;
+  bench_buffer ("TByteCircularBuffer", tcb);
+
+  // The offset column is the simulated DMA burst. The chunks are
+  // smaller than the receive buffer, a full buffer overwrites
+  // the last byte.
+  static uint8_t rx_storage[1024];
+  static uint8_t tx_storage[1024];
+  os::dev::ByteCircularBuffer rx_cb
+    { rx_storage, sizeof(rx_storage) };
+  os::dev::ByteCircularBuffer tx_cb
+    { tx_storage, sizeof(tx_storage) };
+  os::dev::SpscByteCircularBuffer rx_scb
+    { rx_storage, sizeof(rx_storage) };
+  os::dev::SpscByteCircularBuffer tx_scb
+    { tx_storage, sizeof(tx_storage) };
+  os::dev::TByteCircularBuffer<1024> rx_tcb;
+  os::dev::TByteCircularBuffer<1024> tx_tcb;
+
+  const std::size_t chunks[] =
+    { 1, 16, 256, 512 };
+  for (std::size_t chunk : chunks)
+    {
+      bench_device ("device", rx_cb, tx_cb, chunk, 64);
+      bench_device ("device-spsc", rx_scb, tx_scb, chunk, 64);
+      bench_device ("device-template", rx_tcb, tx_tcb, chunk, 64);
+    }
+
+  os::trace::puts ("'test-bench-debug' succeeded.");
+  return 0;
+}
+
@@ -0,0 +1,278 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Test the bridge between two Buffered_serial_device, each on a
+// simulated loopback driver: the bytes written to the first device
+// loop back into its receive buffer, are forwarded from the ISR to the
+// second device, loop back again, and are read from the second device.
+
+#define OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS
+
+#include "posix-drivers/buffered-serial-device.h"
+#include "posix-drivers/serial-loopback.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+// ----------------------------------------------------------------------------
+
+namespace
+{
+  using Device = os::dev::Buffered_serial_device<
+  os::dev::Serial_loopback::Critical_section>;
+
+  constexpr std::size_t total = 4 * 1024;
+
+  inline uint8_t
+  pattern (std::size_t pos)
+  {
+    return static_cast<uint8_t> (pos * 7 + 1);
+  }
+
+  void
+  open_device (Device& device, uint32_t baud_rate)
+  {
+    os::dev::serial_ioctl::Line_config config
+      {
+        baud_rate,
+        os::driver::serial::MODE_ASYNCHRONOUS
+            | os::driver::serial::DATA_BITS_8
+            | os::driver::serial::PARITY_NONE
+            | os::driver::serial::STOP_BITS_1
+            | os::driver::serial::FLOW_CONTROL_NONE,
+        os::dev::serial_ioctl::flow_none };
+    int ret = device.open (
+        nullptr, O_NONBLOCK | os::dev::serial_ioctl::oflag_line_config,
+        &config);
+    assert(ret == 0);
+  }
+
+  // Write the pattern to one device, read it from the other one;
+  // return the number of bytes received.
+  std::size_t
+  transfer (Device& from, Device& to, std::size_t count)
+  {
+    uint8_t chunk[64];
+    uint8_t in[256];
+    std::size_t sent = 0;
+    std::size_t received = 0;
+    auto last_rx = std::chrono::steady_clock::now ();
+    for (;;)
+      {
+        auto now = std::chrono::steady_clock::now ();
+        if (sent < count)
+          {
+            std::size_t n = count - sent;
+            n = (n < sizeof(chunk)) ? n : sizeof(chunk);
+            for (std::size_t i = 0; i < n; ++i)
+              {
+                chunk[i] = pattern (sent + i);
+              }
+            ssize_t ns = from.write (chunk, n);
+            if (ns > 0)
+              {
+                sent += static_cast<std::size_t> (ns);
+              }
+          }
+
+        ssize_t nr = to.read (in, sizeof(in));
+        if (nr > 0)
+          {
+            for (ssize_t i = 0; i < nr; ++i)
+              {
+                assert(in[i] == pattern (received + i));
+              }
+            received += static_cast<std::size_t> (nr);
+            last_rx = now;
+          }
+
+        if ((received >= count)
+            || ((sent == count)
+                && (now - last_rx > std::chrono::milliseconds (200))))
+          {
+            break;
+          }
+        std::this_thread::sleep_for (std::chrono::microseconds (50));
+      }
+    return received;
+  }
+
+  // The sink driver refuses the transfer started by a push; the bytes
+  // stay in the sink buffer and go out with the next push.
+  void
+  check_push_error (Device& from, Device& to,
+                    os::dev::Serial_loopback& to_driver)
+  {
+    uint8_t out[20];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+
+    to_driver.set_send_errors (1);
+    ssize_t nw = from.write (out, sizeof(out) / 2);
+    assert(nw == static_cast<ssize_t> (sizeof(out) / 2));
+
+    os::dev::serial_ioctl::Statistics stats;
+    auto begin = std::chrono::steady_clock::now ();
+    for (;;)
+      {
+        int ret = to.ioctl (os::dev::serial_ioctl::get_statistics, &stats);
+        assert(ret == 0);
+        if (stats.tx_errors > 0)
+          {
+            break;
+          }
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+    assert(stats.tx_errors == 1);
+
+    nw = from.write (out + sizeof(out) / 2, sizeof(out) / 2);
+    assert(nw == static_cast<ssize_t> (sizeof(out) / 2));
+
+    uint8_t in[sizeof(out)];
+    std::size_t received = 0;
+    begin = std::chrono::steady_clock::now ();
+    while (received < sizeof(in))
+      {
+        ssize_t nr = to.read (in + received, sizeof(in) - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+          }
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::microseconds (100));
+      }
+    assert(std::memcmp (in, out, sizeof(in)) == 0);
+  }
+
+} /* namespace */
+
+// ----------------------------------------------------------------------------
+
+int
+main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
+{
+  uint8_t rx_storage_a[256];
+  uint8_t tx_storage_a[256];
+  // Large enough for the reader of the sink, not to lose bytes
+  // with coarse host sleeps.
+  uint8_t rx_storage_b[2048];
+  uint8_t tx_storage_b[256];
+  uint8_t rx_storage_c[64];
+
+  os::dev::Serial_loopback driver_a;
+  os::dev::Serial_loopback driver_b;
+  os::dev::Serial_loopback driver_c;
+  driver_c.set_paced (false);
+
+  os::dev::ByteCircularBuffer rx_buf_a
+    { rx_storage_a, sizeof(rx_storage_a) };
+  os::dev::ByteCircularBuffer tx_buf_a
+    { tx_storage_a, sizeof(tx_storage_a) };
+  os::dev::ByteCircularBuffer rx_buf_b
+    { rx_storage_b, sizeof(rx_storage_b) };
+  os::dev::ByteCircularBuffer tx_buf_b
+    { tx_storage_b, sizeof(tx_storage_b) };
+  os::dev::ByteCircularBuffer rx_buf_c
+    { rx_storage_c, sizeof(rx_storage_c) };
+
+  Device a
+    { "a", &driver_a, &rx_buf_a, &tx_buf_a };
+  Device b
+    { "b", &driver_b, &rx_buf_b, &tx_buf_b };
+  // No transmit buffer, cannot be a sink.
+  Device c
+    { "c", &driver_c, &rx_buf_c, nullptr };
+
+  // Closed.
+  errno = 0;
+  assert(a.set_bridge_sink (&b) == -1);
+  assert(errno == EBADF);
+
+  // The sink no faster than the source.
+  open_device (a, 115200);
+  open_device (b, 230400);
+  open_device (c, 115200);
+
+  errno = 0;
+  assert(a.set_bridge_sink (&a) == -1);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(a.set_bridge_sink (&c) == -1);
+  assert(errno == EINVAL);
+
+  // Forwarded from the ISR, a -> b.
+  assert(a.set_bridge_sink (&b) == 0);
+
+  // Only one source per sink.
+  errno = 0;
+  assert(c.set_bridge_sink (&b) == -1);
+  assert(errno == EINVAL);
+
+  std::size_t received = transfer (a, b, total);
+  assert(received == total);
+  assert(a.get_rx_overrun_count () == 0);
+
+  // Nothing left for the reader of the source.
+  uint8_t in[16];
+  errno = 0;
+  assert(a.read (in, sizeof(in)) == -1);
+  assert(errno == EAGAIN);
+
+  check_push_error (a, b, driver_b);
+
+  // Stopped, the bytes go to the reader again.
+  assert(a.set_bridge_sink (nullptr) == 0);
+  received = transfer (a, a, 100);
+  assert(received == 100);
+
+  // Both directions; no traffic, with loopbacks it would circulate.
+  assert(os::dev::bridge_serial (a, b) == 0);
+  os::dev::unbridge_serial (a, b);
+
+  // close() stops the bridge of the peer too.
+  assert(a.set_bridge_sink (&b) == 0);
+  b.close ();
+  received = transfer (a, a, 100);
+  assert(received == 100);
+
+  a.close ();
+  c.close ();
+
+  os::trace::puts ("'test-bridge-debug' succeeded.");
+  return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "posix-drivers/crc.h"
+#include "posix-drivers/ByteCircularBuffer.h"
+#include "posix-drivers/SpscByteCircularBuffer.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cassert>
+#include <cstring>
+
+// ----------------------------------------------------------------------------
+
+using namespace os::dev;
+
+int
+main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
+{
+  const uint8_t* check = (const uint8_t*) "123456789";
+
+  // The standard check values.
+  Crc16_ccitt crc16;
+  crc16.update (check, 9);
+  assert(crc16.value () == 0x29B1);
+
+  Crc16_ccitt xmodem
+    { 0 };
+  xmodem.update (check, 9);
+  assert(xmodem.value () == 0x31C3);
+
+  Crc32 crc32;
+  crc32.update (check, 4);
+  crc32.update (check + 4, 5);
+  assert(crc32.value () == 0xCBF43926);
+
+  crc32.reset ();
+  assert(crc32.value () == 0);
+
+  // Copy and update in one pass.
+  uint8_t out[9];
+  crc32.copy (out, check, 9);
+  assert(std::memcmp (out, check, 9) == 0);
+  assert(crc32.value () == 0xCBF43926);
+
+  // Through the circular buffer, with wrapped data.
+  uint8_t buff[8];
+  ByteCircularBuffer cb
+    { buff, sizeof(buff) };
+  assert(cb.pushBack (check, 5) == 5);
+  assert(cb.advanceFront (5) == 5);
+
+  Crc32 txsum;
+  assert(cb.pushBack (check, 8, txsum) == 8);
+  assert(cb.pushBack (check, 1, txsum) == 0);
+  txsum.update (check + 8, 1);
+  assert(txsum.value () == 0xCBF43926);
+
+  Crc32 rxsum;
+  std::memset (out, '?', sizeof(out));
+  assert(cb.popFront (out, 6, rxsum) == 6);
+  assert(cb.popFront (out + 6, 6, rxsum) == 2);
+  assert(std::memcmp (out, check, 8) == 0);
+  rxsum.update (check + 8, 1);
+  assert(rxsum.value () == 0xCBF43926);
+
+  // The lock-free buffer has the same API.
+  uint8_t sbuff[8];
+  SpscByteCircularBuffer scb
+    { sbuff, sizeof(sbuff) };
+  assert(scb.pushBack (check, 6) == 6);
+  assert(scb.advanceFront (6) == 6);
+
+  crc16.reset ();
+  assert(scb.pushBack (check, 8, crc16) == 8);
+  crc16.update (check + 8, 1);
+  assert(crc16.value () == 0x29B1);
+
+  crc16.reset ();
+  assert(scb.popFront (out, sizeof(out), crc16) == 8);
+  crc16.update (check + 8, 1);
+  assert(crc16.value () == 0x29B1);
+
+  // Also via the compile time sized buffer.
+  TByteCircularBuffer<8> tcb;
+  crc32.reset ();
+  assert(tcb.pushBack (check, 3, crc32) == 3);
+  assert(tcb.popFront (out, 3) == 3);
+  crc32.update (check + 3, 6);
+  assert(crc32.value () == 0xCBF43926);
+
+  os::trace::puts ("'test-crc-debug' succeeded.");
+  return 0;
+}
@@ -0,0 +1,2368 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Soak test and measurements for Buffered_serial_device, against the
+// simulated loopback driver, paced at the baud rate by a host thread.
+// The application side runs in the main thread, with O_NONBLOCK;
+// the reader can be throttled, to find the rate where the receive
+// buffer overflows. The device uses the driver send_chain(), to send
+// the wrapped transmit buffer as one transfer, if enabled.
+
+#define OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS
+
+#include "posix-drivers/buffered-serial-device.h"
+#include "posix-drivers/serial-loopback.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// ----------------------------------------------------------------------------
+
+namespace
+{
+  using Device = os::dev::Buffered_serial_device<
+  os::dev::Serial_loopback::Critical_section, os::dev::ByteCircularBuffer,
+  os::dev::Serial_loopback>;
+
+  constexpr std::size_t total = 8 * 1024;
+
+  uint8_t rx_storage[256];
+  uint8_t tx_storage[256];
+
+  struct Scenario
+  {
+    const char* name;
+    uint32_t baud_rate;
+    // Bytes per write().
+    std::size_t chunk;
+    // The reader takes at most this number of bytes per millisecond;
+    // 0 for no limit.
+    std::size_t read_per_ms;
+    // Transmit coalescing, 0 to disable.
+    std::size_t coalesce;
+    // The segments accepted by the driver send_chain(), 0 to disable.
+    int chain;
+  };
+
+  inline uint8_t
+  pattern (std::size_t pos)
+  {
+    return static_cast<uint8_t> (pos * 7 + 1);
+  }
+
+  // Return the number of overruns.
+  std::size_t
+  run (const Scenario& sc)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_send_chain_max (sc.chain);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    os::dev::serial_ioctl::Line_config config
+      {
+        sc.baud_rate,
+        os::driver::serial::MODE_ASYNCHRONOUS
+            | os::driver::serial::DATA_BITS_8
+            | os::driver::serial::PARITY_NONE
+            | os::driver::serial::STOP_BITS_1
+            | os::driver::serial::FLOW_CONTROL_NONE,
+        os::dev::serial_ioctl::flow_none };
+    int ret = device.open (
+        nullptr, O_NONBLOCK | os::dev::serial_ioctl::oflag_line_config,
+        &config);
+    assert(ret == 0);
+
+    if (sc.coalesce > 1)
+      {
+        os::dev::serial_ioctl::Tx_coalesce coalesce
+          { sc.coalesce, 0 };
+        ret = device.ioctl (os::dev::serial_ioctl::set_tx_coalesce,
+                            &coalesce);
+        assert(ret == 0);
+      }
+
+    uint8_t chunk[256];
+    uint8_t in[256];
+    std::size_t sent = 0;
+    std::size_t received = 0;
+    std::size_t mismatches = 0;
+
+    auto begin = std::chrono::steady_clock::now ();
+    auto last_rx = begin;
+    auto last_read = begin;
+    for (;;)
+      {
+        auto now = std::chrono::steady_clock::now ();
+
+        if (sent < total)
+          {
+            std::size_t n = total - sent;
+            n = (n < sc.chunk) ? n : sc.chunk;
+            for (std::size_t i = 0; i < n; ++i)
+              {
+                chunk[i] = pattern (sent + i);
+              }
+            ssize_t ns = device.write (chunk, n);
+            if (ns > 0)
+              {
+                sent += static_cast<std::size_t> (ns);
+              }
+          }
+
+        std::size_t limit = sizeof(in);
+        if (sc.read_per_ms > 0)
+          {
+            limit = 0;
+            if (now - last_read >= std::chrono::milliseconds (1))
+              {
+                limit = sc.read_per_ms;
+                last_read = now;
+              }
+          }
+        if (limit > 0)
+          {
+            ssize_t nr = device.read (in, limit);
+            if (nr > 0)
+              {
+                for (ssize_t i = 0; i < nr; ++i)
+                  {
+                    if (in[i] != pattern (received + i))
+                      {
+                        ++mismatches;
+                      }
+                  }
+                received += static_cast<std::size_t> (nr);
+                last_rx = now;
+              }
+          }
+
+        if (received >= total)
+          {
+            break;
+          }
+        if ((sent == total)
+            && (now - last_rx > std::chrono::milliseconds (100)))
+          {
+            // The lost bytes will never come.
+            break;
+          }
+
+        std::this_thread::sleep_for (std::chrono::microseconds (50));
+      }
+    double seconds = std::chrono::duration<double> (
+        std::chrono::steady_clock::now () - begin).count ();
+
+    std::size_t overruns = device.get_rx_overrun_count ();
+    os::dev::serial_ioctl::Statistics stats;
+    ret = device.ioctl (os::dev::serial_ioctl::get_statistics, &stats);
+    assert(ret == 0);
+    os::dev::Serial_loopback::Counters counters = driver.get_counters ();
+
+    double kb = static_cast<double> (total) / 1024;
+    std::printf ("%-12s %7u bps: %8.1f B/s, %5u overruns, "
+                 "%6.1f rx wakeups/KB, %6.1f callbacks/KB, %6.1f sends/KB "
+                 "(%6.1f chained)\n",
+                 sc.name, static_cast<unsigned int> (sc.baud_rate),
+                 static_cast<double> (received) / seconds,
+                 static_cast<unsigned int> (overruns),
+                 static_cast<double> (stats.rx_wakeups) / kb,
+                 static_cast<double> (counters.callbacks) / kb,
+                 static_cast<double> (counters.sends) / kb,
+                 static_cast<double> (counters.chained_sends) / kb);
+
+    if ((overruns == 0) && (counters.rx_dropped == 0))
+      {
+        // Nothing lost, everything in order.
+        assert(received == total);
+        assert(mismatches == 0);
+      }
+
+    device.close ();
+    return overruns;
+  }
+
+  // writev() without a transmit buffer, from the user segments,
+  // as one transfer if the driver accepts the chain.
+  void
+  check_writev (int chain)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_send_chain_max (chain);
+    driver.set_paced (false);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, nullptr };
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    uint8_t seg0[40];
+    uint8_t seg2[100];
+    for (std::size_t i = 0; i < sizeof(seg0); ++i)
+      {
+        seg0[i] = pattern (i);
+      }
+    for (std::size_t i = 0; i < sizeof(seg2); ++i)
+      {
+        seg2[i] = pattern (sizeof(seg0) + i);
+      }
+    struct iovec iov[3];
+    iov[0].iov_base = seg0;
+    iov[0].iov_len = sizeof(seg0);
+    iov[1].iov_base = nullptr;
+    iov[1].iov_len = 0;
+    iov[2].iov_base = seg2;
+    iov[2].iov_len = sizeof(seg2);
+
+    driver.reset_counters ();
+    ssize_t nw = device.writev (iov, 3);
+    assert(nw == static_cast<ssize_t> (sizeof(seg0) + sizeof(seg2)));
+
+    uint8_t in[256];
+    std::size_t received = 0;
+    for (int i = 0; (i < 1000) && (received < static_cast<std::size_t> (nw));
+        ++i)
+      {
+        ssize_t nr = device.read (in + received, sizeof(in) - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+          }
+        std::this_thread::sleep_for (std::chrono::microseconds (100));
+      }
+    assert(received == static_cast<std::size_t> (nw));
+    for (std::size_t i = 0; i < received; ++i)
+      {
+        assert(in[i] == pattern (i));
+      }
+
+    os::dev::Serial_loopback::Counters counters = driver.get_counters ();
+    if (chain >= 3)
+      {
+        assert(counters.sends == 1);
+        assert(counters.chained_sends == 1);
+      }
+    else
+      {
+        // Not accepted, one segment at a time.
+        assert(counters.sends == 2);
+        assert(counters.chained_sends == 0);
+      }
+
+    if (chain == 0)
+      {
+        // The first segment refused by the driver.
+        driver.set_send_errors (1);
+        errno = 0;
+        nw = device.writev (iov, 3);
+        assert(nw == -1);
+        assert(errno == EIO);
+      }
+
+    device.close ();
+  }
+
+  // writev() through a transmit buffer smaller than the segments;
+  // the device waits for the buffer to drain, as for write().
+  void
+  check_writev_buffered (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, 64 };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    int ret = device.open (nullptr, 0);
+    assert(ret == 0);
+
+    uint8_t seg0[40];
+    uint8_t seg2[100];
+    for (std::size_t i = 0; i < sizeof(seg0); ++i)
+      {
+        seg0[i] = pattern (i);
+      }
+    for (std::size_t i = 0; i < sizeof(seg2); ++i)
+      {
+        seg2[i] = pattern (sizeof(seg0) + i);
+      }
+    struct iovec iov[3];
+    iov[0].iov_base = seg0;
+    iov[0].iov_len = sizeof(seg0);
+    iov[1].iov_base = nullptr;
+    iov[1].iov_len = 0;
+    iov[2].iov_base = seg2;
+    iov[2].iov_len = sizeof(seg2);
+
+    ssize_t nw = device.writev (iov, 3);
+    assert(nw == static_cast<ssize_t> (sizeof(seg0) + sizeof(seg2)));
+
+    ret = device.ioctl (os::dev::serial_ioctl::drain);
+    assert(ret == 0);
+
+    uint8_t in[256];
+    std::size_t received = 0;
+    auto begin = std::chrono::steady_clock::now ();
+    while (received < static_cast<std::size_t> (nw))
+      {
+        ssize_t nr = device.read (in + received, sizeof(in) - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+          }
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+      }
+    assert(received == static_cast<std::size_t> (nw));
+    for (std::size_t i = 0; i < received; ++i)
+      {
+        assert(in[i] == pattern (i));
+      }
+
+    device.close ();
+  }
+
+  // A long burst, in a receive window that does not fill, with the
+  // idle line detection disabled; the reader sees the bytes only
+  // if the driver reports the progress of the reception.
+  void
+  check_rx_progress (bool enabled)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_rx_progress (enabled);
+    driver.set_rx_idle_chars (1000000);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    uint8_t out[200];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+    ssize_t nw = device.write (out, sizeof(out));
+    assert(nw == static_cast<ssize_t> (sizeof(out)));
+
+    // Wait for the driver to move all the burst, about 17 ms at
+    // 115200 bps; the events are reported by then, whatever the
+    // host timing.
+    auto begin = std::chrono::steady_clock::now ();
+    while (driver.get_counters ().rx_bytes < sizeof(out))
+      {
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+
+    uint8_t in[256];
+    ssize_t nr = device.read (in, sizeof(in));
+    std::size_t received = (nr > 0) ? static_cast<std::size_t> (nr) : 0;
+
+    if (enabled)
+      {
+        // Exactly the half of the 256 bytes window, the driver
+        // stops there to report it.
+        assert(received == sizeof(rx_storage) / 2);
+        for (std::size_t i = 0; i < received; ++i)
+          {
+            assert(in[i] == pattern (i));
+          }
+      }
+    else
+      {
+        // Still waiting for the window to fill.
+        assert(received == 0);
+      }
+
+    device.close ();
+  }
+
+  // The driver refuses the transfer started by the coalescing flush
+  // timer; the error is counted and the bytes stay in the buffer,
+  // sent with the next write().
+  void
+  check_flush_error (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    os::dev::serial_ioctl::Tx_coalesce coalesce
+      { 64, 5 };
+    ret = device.ioctl (os::dev::serial_ioctl::set_tx_coalesce, &coalesce);
+    assert(ret == 0);
+
+    uint8_t out[64];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+
+    driver.set_send_errors (1);
+    ssize_t nw = device.write (out, 4);
+    assert(nw == 4);
+
+    os::dev::serial_ioctl::Statistics stats;
+    auto begin = std::chrono::steady_clock::now ();
+    for (;;)
+      {
+        ret = device.ioctl (os::dev::serial_ioctl::get_statistics, &stats);
+        assert(ret == 0);
+        if (stats.tx_errors > 0)
+          {
+            break;
+          }
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+    assert(stats.tx_errors == 1);
+    assert(driver.get_counters ().sends == 0);
+
+    // Reach the coalescing count; all the bytes go out.
+    nw = device.write (out + 4, sizeof(out) - 4);
+    assert(nw == static_cast<ssize_t> (sizeof(out) - 4));
+
+    uint8_t in[sizeof(out)];
+    std::size_t received = 0;
+    for (int i = 0; (i < 1000) && (received < sizeof(in)); ++i)
+      {
+        ssize_t nr = device.read (in + received, sizeof(in) - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+          }
+        std::this_thread::sleep_for (std::chrono::microseconds (100));
+      }
+    assert(received == sizeof(in));
+    assert(std::memcmp (in, out, sizeof(in)) == 0);
+
+    device.close ();
+  }
+
+  // The driver refuses the next transfer, started by the ISR when the
+  // previous one completes, here the wrapped part of the buffer; the
+  // error is counted and the bytes are sent with the next write().
+  void
+  check_send_error (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_send_chain_max (0);
+    uint8_t ring[64];
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { ring, sizeof(ring) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    os::dev::serial_ioctl::Line_config config
+      {
+        9600,
+        os::driver::serial::MODE_ASYNCHRONOUS
+            | os::driver::serial::DATA_BITS_8
+            | os::driver::serial::PARITY_NONE
+            | os::driver::serial::STOP_BITS_1
+            | os::driver::serial::FLOW_CONTROL_NONE,
+        os::dev::serial_ioctl::flow_none };
+    int ret = device.open (
+        nullptr, O_NONBLOCK | os::dev::serial_ioctl::oflag_line_config,
+        &config);
+    assert(ret == 0);
+
+    constexpr std::size_t count = 81;
+    uint8_t out[count];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+    uint8_t in[count];
+    std::size_t received = 0;
+    auto read_until = [&](std::size_t expected)
+      {
+        auto begin = std::chrono::steady_clock::now ();
+        while (received < expected)
+          {
+            ssize_t nr = device.read (in + received, expected - received);
+            if (nr > 0)
+              {
+                received += static_cast<std::size_t> (nr);
+              }
+            assert(
+                std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+          }
+      };
+
+    // Move the front of the transmit buffer near the end.
+    ssize_t nw = device.write (out, 40);
+    assert(nw == 40);
+    read_until (40);
+
+    // 24 bytes to the end of the buffer, then 16 from the beginning.
+    nw = device.write (out + 40, 40);
+    assert(nw == 40);
+    driver.set_send_errors (1);
+
+    os::dev::serial_ioctl::Statistics stats;
+    auto begin = std::chrono::steady_clock::now ();
+    for (;;)
+      {
+        ret = device.ioctl (os::dev::serial_ioctl::get_statistics, &stats);
+        assert(ret == 0);
+        if (stats.tx_errors > 0)
+          {
+            break;
+          }
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+    assert(stats.tx_errors == 1);
+    read_until (64);
+
+    nw = device.write (out + 80, 1);
+    assert(nw == 1);
+    read_until (count);
+    assert(std::memcmp (in, out, sizeof(in)) == 0);
+
+    device.close ();
+  }
+
+  // The transmit timeout, shorter than the transfer at 9600 bps;
+  // without a transmit buffer, the transfer is stopped before
+  // write() returns, the user buffer is no longer in use.
+  void
+  check_tx_timeout (bool is_buffered)
+  {
+    os::dev::Serial_loopback driver;
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, is_buffered ? &tx_buf : nullptr };
+
+    os::dev::serial_ioctl::Line_config config
+      {
+        9600,
+        os::driver::serial::MODE_ASYNCHRONOUS
+            | os::driver::serial::DATA_BITS_8
+            | os::driver::serial::PARITY_NONE
+            | os::driver::serial::STOP_BITS_1
+            | os::driver::serial::FLOW_CONTROL_NONE,
+        os::dev::serial_ioctl::flow_none };
+    int ret = device.open (nullptr, os::dev::serial_ioctl::oflag_line_config,
+                           &config);
+    assert(ret == 0);
+
+    os::dev::serial_ioctl::Timeouts timeouts
+      { 0, 10 };
+    ret = device.ioctl (os::dev::serial_ioctl::set_timeouts, &timeouts);
+    assert(ret == 0);
+
+    uint8_t out[100];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+
+    errno = 0;
+    ssize_t nw = device.write (out, sizeof(out));
+    if (is_buffered)
+      {
+        assert(nw == static_cast<ssize_t> (sizeof(out)));
+
+        // About 100 ms to send.
+        errno = 0;
+        ret = device.ioctl (os::dev::serial_ioctl::drain);
+        assert(ret == -1);
+        assert(errno == ETIMEDOUT);
+      }
+    else
+      {
+        assert((nw == -1) ? (errno == ETIMEDOUT)
+            : (nw < static_cast<ssize_t> (sizeof(out))));
+        assert(!driver.get_status ().is_tx_busy ());
+      }
+
+    device.close ();
+  }
+
+  // With Rx_mode::ping_pong, the receive window is capped at half
+  // of the buffer; with the idle line detection disabled, the reader
+  // sees exactly the first half of a longer burst.
+  void
+  check_ping_pong_window (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_rx_idle_chars (1000000);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+    device.set_rx_mode (Device::Rx_mode::ping_pong);
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    uint8_t out[200];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+    ssize_t nw = device.write (out, sizeof(out));
+    assert(nw == static_cast<ssize_t> (sizeof(out)));
+
+    auto begin = std::chrono::steady_clock::now ();
+    while (driver.get_counters ().rx_bytes < sizeof(out))
+      {
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+
+    uint8_t in[256];
+    ssize_t nr = device.read (in, sizeof(in));
+    assert(nr == static_cast<ssize_t> (sizeof(rx_storage) / 2));
+    assert(std::memcmp (in, out, static_cast<std::size_t> (nr)) == 0);
+    assert(device.get_rx_overrun_count () == 0);
+
+    device.close ();
+  }
+
+  // With Rx_mode::ping_pong and no reader, the bytes beyond the
+  // buffer size are discarded and counted; once the reader frees
+  // space, the driver receives into the buffer again, without losing
+  // the rest of the discard buffer.
+  void
+  check_ping_pong_overrun (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    uint8_t storage[64];
+    os::dev::ByteCircularBuffer rx_buf
+      { storage, sizeof(storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+    device.set_rx_mode (Device::Rx_mode::ping_pong);
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    // Not a multiple of the discard buffer, the last one is not full.
+    constexpr std::size_t lost = 36;
+    uint8_t out[sizeof(storage) + lost];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+    ssize_t nw = device.write (out, sizeof(out));
+    assert(nw == static_cast<ssize_t> (sizeof(out)));
+
+    // Accounted by the idle line event.
+    auto begin = std::chrono::steady_clock::now ();
+    while (device.get_rx_overrun_count () < lost)
+      {
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+    assert(device.get_rx_overrun_count () == lost);
+
+    uint8_t in[sizeof(storage)];
+    ssize_t nr = device.read (in, sizeof(in));
+    assert(nr == static_cast<ssize_t> (sizeof(storage)));
+    assert(std::memcmp (in, out, sizeof(in)) == 0);
+
+    // Received into the buffer, not into the discard buffer.
+    nw = device.write (out, 10);
+    assert(nw == 10);
+    std::size_t received = 0;
+    begin = std::chrono::steady_clock::now ();
+    while (received < 10)
+      {
+        nr = device.read (in + received, sizeof(in) - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+          }
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+    assert(received == 10);
+    assert(std::memcmp (in, out, received) == 0);
+    assert(device.get_rx_overrun_count () == lost);
+
+    device.close ();
+  }
+
+  // The driver refuses to receive, once when the ISR re-arms it after
+  // a receive completes, and once when the reader frees space; the
+  // device keeps receiving into the discard buffer, counts the
+  // errors, and the next bytes go to the buffer again.
+  void
+  check_receive_error (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    uint8_t storage[64];
+    os::dev::ByteCircularBuffer rx_buf
+      { storage, sizeof(storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+    device.set_rx_mode (Device::Rx_mode::ping_pong);
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    uint8_t out[100];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+    uint8_t in[sizeof(out)];
+    auto read_exactly = [&](std::size_t expected)
+      {
+        std::size_t received = 0;
+        auto begin = std::chrono::steady_clock::now ();
+        while (received < expected)
+          {
+            ssize_t nr = device.read (in + received, sizeof(in) - received);
+            if (nr > 0)
+              {
+                received += static_cast<std::size_t> (nr);
+              }
+            assert(
+                std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+          }
+        assert(received == expected);
+      };
+    auto wait_overruns = [&](std::size_t expected)
+      {
+        auto begin = std::chrono::steady_clock::now ();
+        while (device.get_rx_overrun_count () < expected)
+          {
+            assert(
+                std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+          }
+        assert(device.get_rx_overrun_count () == expected);
+      };
+    os::dev::serial_ioctl::Statistics stats;
+    // The size of the device discard buffer.
+    constexpr std::size_t discard = 8;
+
+    // Refused after the first half; the discard buffer takes the
+    // next bytes, then the second half is armed.
+    driver.set_receive_errors (1);
+    ssize_t nw = device.write (out, 40);
+    assert(nw == 40);
+    wait_overruns (discard);
+    read_exactly (32);
+    assert(std::memcmp (in, out, 32) == 0);
+    ret = device.ioctl (os::dev::serial_ioctl::get_statistics, &stats);
+    assert(ret == 0);
+    assert(stats.rx_errors == 1);
+
+    // Fill the buffer, the rest is discarded.
+    nw = device.write (out, 100);
+    assert(nw == 100);
+    wait_overruns (discard + 100 - sizeof(storage));
+
+    // Refused when the reader frees space; still receiving.
+    driver.set_receive_errors (1);
+    read_exactly (sizeof(storage));
+    assert(std::memcmp (in, out, sizeof(storage)) == 0);
+    ret = device.ioctl (os::dev::serial_ioctl::get_statistics, &stats);
+    assert(ret == 0);
+    assert(stats.rx_errors == 2);
+
+    // The first bytes complete the discard buffer, the rest are
+    // received into the buffer.
+    std::size_t lost = device.get_rx_overrun_count ();
+    nw = device.write (out, 10);
+    assert(nw == 10);
+    wait_overruns (lost + discard);
+    read_exactly (10 - discard);
+    assert(std::memcmp (in, out + discard, 2) == 0);
+
+    nw = device.write (out, 10);
+    assert(nw == 10);
+    read_exactly (10);
+    assert(std::memcmp (in, out, 10) == 0);
+    assert(
+        device.get_rx_overrun_count () == lost + discard);
+
+    device.close ();
+  }
+
+  // The flow control, with the device talking to itself: RTS drives
+  // CTS through the loopback plug, and the XON/XOFF sent are received
+  // back; when the reader stops, the receive buffer crosses the high
+  // water mark, the transmission pauses before the buffer is full,
+  // and resumes once the reader takes the bytes, below the low water
+  // mark. With XON/XOFF, the flow characters are not passed to the
+  // reader, so the data avoids them.
+  void
+  check_flow_control (uint8_t flow)
+  {
+    bool is_xon_xoff = (flow & os::dev::serial_ioctl::flow_xon_xoff) != 0;
+
+    os::dev::Serial_loopback driver;
+    // The half-transfer interrupt, to see the high water mark while
+    // a long receive is in progress.
+    driver.set_rx_progress (true);
+    // The margin above the high water mark also covers the host
+    // scheduling delays.
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage), 64, 16 };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    os::dev::serial_ioctl::Line_config config
+      {
+        115200,
+        os::driver::serial::MODE_ASYNCHRONOUS
+            | os::driver::serial::DATA_BITS_8
+            | os::driver::serial::PARITY_NONE
+            | os::driver::serial::STOP_BITS_1
+            | os::driver::serial::FLOW_CONTROL_NONE,
+        flow };
+    int ret = device.open (
+        nullptr, O_NONBLOCK | os::dev::serial_ioctl::oflag_line_config,
+        &config);
+    assert(ret == 0);
+    assert(driver.is_rts_active () == !is_xon_xoff);
+
+    constexpr std::size_t count = 200;
+    uint8_t out[count];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+        if ((out[i] == os::dev::serial_ioctl::xon)
+            || (out[i] == os::dev::serial_ioctl::xoff))
+          {
+            out[i] = ' ';
+          }
+      }
+
+    // Paced writes; while paused, the rest waits in the transmit buffer.
+    for (std::size_t sent = 0; sent < count; sent += 8)
+      {
+        ssize_t nw = device.write (out + sent, 8);
+        assert(nw == 8);
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+
+    // Wait for the line to stop.
+    std::size_t rx_bytes = driver.get_counters ().rx_bytes;
+    auto begin = std::chrono::steady_clock::now ();
+    for (;;)
+      {
+        std::this_thread::sleep_for (std::chrono::milliseconds (20));
+        std::size_t n = driver.get_counters ().rx_bytes;
+        if (n == rx_bytes)
+          {
+            break;
+          }
+        rx_bytes = n;
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+      }
+
+    // Paused, with the rest in the transmit buffer, nothing lost.
+    assert(rx_buf.isAboveHighWaterMark ());
+    assert(!rx_buf.isFull ());
+    assert(!tx_buf.isEmpty ());
+    assert(device.get_rx_overrun_count () == 0);
+    assert(driver.get_counters ().rx_dropped == 0);
+    if (!is_xon_xoff)
+      {
+        assert(!driver.is_rts_active ());
+      }
+
+    uint8_t in[count];
+    std::size_t received = 0;
+    begin = std::chrono::steady_clock::now ();
+    while (received < count)
+      {
+        ssize_t nr = device.read (in + received, count - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+          }
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+    assert(received == count);
+    assert(std::memcmp (in, out, count) == 0);
+    assert(device.get_rx_overrun_count () == 0);
+    if (is_xon_xoff)
+      {
+        // At least one XOFF and one XON went through the line.
+        assert(driver.get_counters ().rx_bytes >= count + 2);
+      }
+    else
+      {
+        assert(driver.get_counters ().rts_changes >= 3);
+      }
+
+    device.close ();
+  }
+
+  // Wait for one frame and read it; return the decoded length.
+  ssize_t
+  read_frame (Device& device, void* buf, std::size_t nbyte)
+  {
+    auto begin = std::chrono::steady_clock::now ();
+    for (;;)
+      {
+        ssize_t nr = device.read (buf, nbyte);
+        if (nr >= 0)
+          {
+            return nr;
+          }
+        assert(errno == EAGAIN);
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+  }
+
+  os::dev::serial_ioctl::Statistics
+  get_statistics (Device& device)
+  {
+    os::dev::serial_ioctl::Statistics stats;
+    int ret = device.ioctl (os::dev::serial_ioctl::get_statistics, &stats);
+    assert(ret == 0);
+    return stats;
+  }
+
+  // Wait until the device has received (and scanned for frames) this
+  // number of bytes since it was opened.
+  void
+  wait_rx_bytes (Device& device, std::size_t count)
+  {
+    auto begin = std::chrono::steady_clock::now ();
+    while (get_statistics (device).rx_bytes < count)
+      {
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+    assert(get_statistics (device).rx_bytes == count);
+  }
+
+  // The delimiter framing: each read() returns one frame, without the
+  // delimiter, empty frames are skipped, an incomplete frame is not
+  // returned, and a frame longer than the buffer is truncated; the
+  // zero-copy rx_peek_frame() returns the raw frame, in two segments
+  // when it wraps.
+  void
+  check_framing_delimiter (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    uint8_t storage[64];
+    os::dev::ByteCircularBuffer rx_buf
+      { storage, sizeof(storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    uint8_t* pbuf1;
+    std::size_t len1;
+    uint8_t* pbuf2;
+    std::size_t len2;
+    ssize_t nr = device.rx_peek_frame (&pbuf1, &len1, &pbuf2, &len2);
+    assert(nr == -1 && errno == EINVAL);
+
+    os::dev::serial_ioctl::Rx_framing framing
+      { os::dev::serial_ioctl::framing_cobs + 1, ';' };
+    int ret = device.ioctl (os::dev::serial_ioctl::set_rx_framing, &framing);
+    assert(ret == -1 && errno == EINVAL);
+    framing.mode = os::dev::serial_ioctl::framing_delimiter;
+    ret = device.ioctl (os::dev::serial_ioctl::set_rx_framing, &framing);
+    assert(ret == 0);
+
+    ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    ret = device.ioctl (os::dev::serial_ioctl::set_rx_framing, &framing);
+    assert(ret == -1 && errno == EBUSY);
+    os::dev::serial_ioctl::Rx_framing current
+      { };
+    ret = device.ioctl (os::dev::serial_ioctl::get_rx_framing, &current);
+    assert(ret == 0);
+    assert(current.mode == os::dev::serial_ioctl::framing_delimiter);
+    assert(current.delimiter == ';');
+
+    const char text[] = "one;two;;three;fo";
+    ssize_t nw = device.write (text, sizeof(text) - 1);
+    assert(nw == sizeof(text) - 1);
+    std::size_t sent = sizeof(text) - 1;
+
+    char in[64];
+    nr = read_frame (device, in, sizeof(in));
+    assert(nr == 3 && std::memcmp (in, "one", 3) == 0);
+    nr = read_frame (device, in, sizeof(in));
+    assert(nr == 3 && std::memcmp (in, "two", 3) == 0);
+    nr = read_frame (device, in, sizeof(in));
+    assert(nr == 5 && std::memcmp (in, "three", 5) == 0);
+
+    // "fo" waits for its delimiter.
+    wait_rx_bytes (device, sent);
+    nr = device.read (in, sizeof(in));
+    assert(nr == -1 && errno == EAGAIN);
+    nw = device.write ("ur;", 3);
+    assert(nw == 3);
+    sent += 3;
+    nr = read_frame (device, in, sizeof(in));
+    assert(nr == 4 && std::memcmp (in, "four", 4) == 0);
+
+    // The rest of a long frame is lost.
+    nw = device.write ("abcdefgh;xy;", 12);
+    assert(nw == 12);
+    sent += 12;
+    nr = read_frame (device, in, 4);
+    assert(nr == 4 && std::memcmp (in, "abcd", 4) == 0);
+    nr = read_frame (device, in, sizeof(in));
+    assert(nr == 2 && std::memcmp (in, "xy", 2) == 0);
+
+    // The next frame crosses the end of the buffer.
+    uint8_t out[40];
+    for (std::size_t i = 0; i < sizeof(out) - 1; ++i)
+      {
+        out[i] = static_cast<uint8_t> ('a' + i % 26);
+      }
+    out[sizeof(out) - 1] = ';';
+    nw = device.write (out, sizeof(out));
+    assert(nw == sizeof(out));
+    sent += sizeof(out);
+    wait_rx_bytes (device, sent);
+    nr = device.rx_peek_frame (&pbuf1, &len1, &pbuf2, &len2);
+    assert(nr == sizeof(out));
+    assert(len1 == sizeof(storage) - (sent - sizeof(out)) % sizeof(storage));
+    assert(len1 + len2 == sizeof(out));
+    assert(std::memcmp (pbuf1, out, len1) == 0);
+    assert(std::memcmp (pbuf2, out + len1, len2) == 0);
+    device.rx_consume_frame ();
+    nr = device.rx_peek_frame (&pbuf1, &len1, &pbuf2, &len2);
+    assert(nr == -1 && errno == EAGAIN);
+    assert(rx_buf.isEmpty ());
+
+    os::dev::serial_ioctl::Statistics stats = get_statistics (device);
+    assert(stats.rx_frame_errors == 0);
+    assert(stats.rx_frame_overruns == 0);
+
+    device.close ();
+  }
+
+  // The SLIP and COBS framing: the frames are decoded, SLIP frames
+  // start with an END too (an empty frame, skipped), and a malformed
+  // frame (invalid SLIP escape, incomplete COBS block) is discarded
+  // and counted, without losing the next one.
+  void
+  check_framing_codec (int mode)
+  {
+    bool is_slip = (mode == os::dev::serial_ioctl::framing_slip);
+
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    os::dev::serial_ioctl::Rx_framing framing
+      { mode, 0 };
+    int ret = device.ioctl (os::dev::serial_ioctl::set_rx_framing, &framing);
+    assert(ret == 0);
+    ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    // The bytes to escape in SLIP, and the zeros of COBS.
+    const uint8_t first[] =
+      { os::dev::serial_frame::slip_end, 'a', 0x00,
+          os::dev::serial_frame::slip_esc, 0x00 };
+    uint8_t second[100];
+    for (std::size_t i = 0; i < sizeof(second); ++i)
+      {
+        second[i] = static_cast<uint8_t> (i % 5);
+      }
+    const uint8_t bad_slip[] =
+      { os::dev::serial_frame::slip_end, 'x', os::dev::serial_frame::slip_esc,
+          'y', os::dev::serial_frame::slip_end };
+    // The block announces 4 bytes, only one follows.
+    const uint8_t bad_cobs[] =
+      { 0x05, 'x', 0x00 };
+
+    uint8_t out[200];
+    std::size_t len = 0;
+    std::size_t n =
+        is_slip ?
+            os::dev::serial_frame::slip_encode (first, sizeof(first),
+                                                out + len, sizeof(out) - len) :
+            os::dev::serial_frame::cobs_encode (first, sizeof(first),
+                                                out + len, sizeof(out) - len);
+    assert(n > 0);
+    len += n;
+    if (is_slip)
+      {
+        std::memcpy (out + len, bad_slip, sizeof(bad_slip));
+        len += sizeof(bad_slip);
+      }
+    else
+      {
+        std::memcpy (out + len, bad_cobs, sizeof(bad_cobs));
+        len += sizeof(bad_cobs);
+      }
+    n = is_slip ?
+        os::dev::serial_frame::slip_encode (second, sizeof(second), out + len,
+                                            sizeof(out) - len) :
+        os::dev::serial_frame::cobs_encode (second, sizeof(second), out + len,
+                                            sizeof(out) - len);
+    assert(n > 0);
+    len += n;
+
+    ssize_t nw = device.write (out, len);
+    assert(nw == static_cast<ssize_t> (len));
+
+    uint8_t in[sizeof(second)];
+    ssize_t nr = read_frame (device, in, sizeof(in));
+    assert(nr == sizeof(first));
+    assert(std::memcmp (in, first, sizeof(first)) == 0);
+    nr = read_frame (device, in, sizeof(in));
+    assert(nr == sizeof(second));
+    assert(std::memcmp (in, second, sizeof(second)) == 0);
+
+    wait_rx_bytes (device, len);
+    nr = device.read (in, sizeof(in));
+    assert(nr == -1 && errno == EAGAIN);
+    os::dev::serial_ioctl::Statistics stats = get_statistics (device);
+    assert(stats.rx_frame_errors == 1);
+    assert(rx_buf.isEmpty ());
+
+    device.close ();
+  }
+
+  // The idle framing: a frame ends when the line becomes idle, the
+  // driver rx_timeout event.
+  void
+  check_framing_idle (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    os::dev::serial_ioctl::Rx_framing framing
+      { os::dev::serial_ioctl::framing_idle, 0 };
+    int ret = device.ioctl (os::dev::serial_ioctl::set_rx_framing, &framing);
+    assert(ret == 0);
+    ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    char in[32];
+    ssize_t nw = device.write ("hello", 5);
+    assert(nw == 5);
+    wait_rx_bytes (device, 5);
+    nw = device.write ("world!", 6);
+    assert(nw == 6);
+    wait_rx_bytes (device, 11);
+
+    ssize_t nr = read_frame (device, in, sizeof(in));
+    assert(nr == 5 && std::memcmp (in, "hello", 5) == 0);
+    nr = read_frame (device, in, sizeof(in));
+    assert(nr == 6 && std::memcmp (in, "world!", 6) == 0);
+    nr = device.read (in, sizeof(in));
+    assert(nr == -1 && errno == EAGAIN);
+
+    device.close ();
+  }
+
+  // More frames than the device ring of frame ends; the extra ends
+  // are counted and not recorded, those frames merge with the next
+  // one recorded.
+  void
+  check_frame_overruns (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    os::dev::serial_ioctl::Rx_framing framing
+      { os::dev::serial_ioctl::framing_delimiter, '\n' };
+    int ret = device.ioctl (os::dev::serial_ioctl::set_rx_framing, &framing);
+    assert(ret == 0);
+    ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    // The size of the device ring (OS_INTEGER_POSIX_DRIVERS_SERIAL_RX_FRAMES).
+    constexpr std::size_t frames = 8;
+    char out[3 * (frames + 2)];
+    for (std::size_t i = 0; i < frames + 2; ++i)
+      {
+        out[3 * i] = 'f';
+        out[3 * i + 1] = static_cast<char> ('0' + i);
+        out[3 * i + 2] = '\n';
+      }
+    ssize_t nw = device.write (out, sizeof(out));
+    assert(nw == sizeof(out));
+    wait_rx_bytes (device, sizeof(out));
+    assert(get_statistics (device).rx_frame_overruns == 2);
+
+    char in[32];
+    for (std::size_t i = 0; i < frames; ++i)
+      {
+        ssize_t nr = read_frame (device, in, sizeof(in));
+        assert(nr == 2 && std::memcmp (in, out + 3 * i, 2) == 0);
+      }
+    ssize_t nr = device.read (in, sizeof(in));
+    assert(nr == -1 && errno == EAGAIN);
+
+    nw = device.write ("fa\n", 3);
+    assert(nw == 3);
+    nr = read_frame (device, in, sizeof(in));
+    assert(nr == 6 && std::memcmp (in, "f8f9fa", 6) == 0);
+    assert(get_statistics (device).rx_frame_overruns == 2);
+
+    device.close ();
+  }
+
+  void
+  notify_dispatch (void* arg)
+  {
+    static_cast<std::atomic<int>*> (arg)->fetch_add (1);
+  }
+
+  // The deferred event dispatch: without a notify function, the
+  // reading and writing thread processes the events the ISR does not,
+  // here the progress of the reception; with one, a handler (here the
+  // main loop) calls dispatch_events(), and the receive is re-armed
+  // from the ISR.
+  void
+  check_event_dispatch (bool with_notify)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_rx_progress (!with_notify);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    std::atomic<int> notified
+      { 0 };
+    if (with_notify)
+      {
+        device.set_event_dispatch (
+            Device::Event_dispatch::deferred,
+            os::driver::serial::Event::receive_complete, notify_dispatch,
+            &notified);
+      }
+    else
+      {
+        device.set_event_dispatch (Device::Event_dispatch::deferred);
+      }
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    constexpr std::size_t count = 2 * 1024;
+    static uint8_t in[count];
+    uint8_t chunk[64];
+    std::size_t sent = 0;
+    std::size_t received = 0;
+    int handled = 0;
+    auto last_rx = std::chrono::steady_clock::now ();
+    for (;;)
+      {
+        if (with_notify && (notified.load () != handled))
+          {
+            // The deferred handler.
+            handled = notified.load ();
+            device.dispatch_events ();
+          }
+
+        auto now = std::chrono::steady_clock::now ();
+        if (sent < count)
+          {
+            std::size_t n = count - sent;
+            n = (n < sizeof(chunk)) ? n : sizeof(chunk);
+            for (std::size_t i = 0; i < n; ++i)
+              {
+                chunk[i] = pattern (sent + i);
+              }
+            ssize_t nw = device.write (chunk, n);
+            if (nw > 0)
+              {
+                sent += static_cast<std::size_t> (nw);
+              }
+          }
+
+        ssize_t nr = device.read (in + received, count - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+            last_rx = now;
+          }
+
+        if ((received >= count)
+            || ((sent == count)
+                && (now - last_rx > std::chrono::milliseconds (200))))
+          {
+            break;
+          }
+        // Slower than the events, to merge them.
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+
+    os::dev::serial_ioctl::Statistics stats;
+    ret = device.ioctl (os::dev::serial_ioctl::get_statistics, &stats);
+    assert(ret == 0);
+    os::dev::Serial_loopback::Counters counters = driver.get_counters ();
+
+    // Each callback is either recorded or processed at once.
+    assert(stats.isr_deferred > 0);
+    assert(stats.isr_deferred <= counters.callbacks);
+    if (with_notify)
+      {
+        // Once per batch.
+        assert(notified.load () > 0);
+        assert(static_cast<std::size_t> (notified.load ())
+            <= stats.isr_deferred);
+      }
+
+    if ((counters.rx_dropped == 0) && (stats.rx_overruns == 0))
+      {
+        assert(received == count);
+        for (std::size_t i = 0; i < received; ++i)
+          {
+            assert(in[i] == pattern (i));
+          }
+      }
+
+    std::printf ("%-14s %5u callbacks, %5u deferred, %5u processed\n",
+                 with_notify ? "deferred-isr" : "deferred",
+                 static_cast<unsigned int> (counters.callbacks),
+                 static_cast<unsigned int> (stats.isr_deferred),
+                 static_cast<unsigned int> (stats.isr_count));
+
+    device.close ();
+  }
+
+  // Deferred dispatch without a notify function, and no thread in
+  // the device while the bytes are transferred; both the receive and
+  // the transmit wrap around their buffers, so the transfers stall if
+  // the completions wait for a dispatch. The idle line events are
+  // still deferred, the reader accounts the last bytes.
+  void
+  check_event_dispatch_unattended (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    uint8_t rx_ring[128];
+    uint8_t tx_ring[128];
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_ring, sizeof(rx_ring) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_ring, sizeof(tx_ring) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+    device.set_event_dispatch (Device::Event_dispatch::deferred);
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    constexpr std::size_t count = 100;
+    uint8_t out[count];
+    uint8_t in[count];
+    for (std::size_t round = 0; round < 2; ++round)
+      {
+        for (std::size_t i = 0; i < count; ++i)
+          {
+            out[i] = pattern (round * count + i);
+          }
+        ssize_t nw = device.write (out, count);
+        assert(nw == static_cast<ssize_t> (count));
+
+        // Nobody calls the device until all the bytes are received.
+        auto begin = std::chrono::steady_clock::now ();
+        while ((driver.get_counters ().rx_bytes < (round + 1) * count)
+            || !tx_buf.isEmpty ())
+          {
+            assert(
+                std::chrono::steady_clock::now () - begin
+                    < std::chrono::seconds (5));
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+          }
+        assert(driver.get_counters ().rx_dropped == 0);
+
+        ssize_t nr = device.read (in, sizeof(in));
+        assert(nr == static_cast<ssize_t> (count));
+        assert(std::memcmp (in, out, count) == 0);
+      }
+
+    assert(driver.get_counters ().rx_dropped == 0);
+    assert(device.get_rx_overrun_count () == 0);
+
+    device.close ();
+  }
+
+  // Deferred dispatch, with the device called less often than the
+  // driver callbacks; the peer is simulated by sending directly with
+  // the driver, short messages with the line idle in between, so
+  // the device has no transmit buffer. The events of a batch are
+  // processed together, the device runs much less often than the ISR.
+  void
+  check_event_batches (void)
+  {
+    os::dev::Serial_loopback driver;
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, nullptr };
+
+    std::atomic<int> notified
+      { 0 };
+    device.set_event_dispatch (Device::Event_dispatch::deferred,
+                               os::driver::serial::Event::receive_complete,
+                               notify_dispatch, &notified);
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    constexpr std::size_t count = 1024;
+    constexpr std::size_t chunk = 8;
+    static uint8_t out[count];
+    static uint8_t in[count];
+    for (std::size_t i = 0; i < count; ++i)
+      {
+        out[i] = pattern (i);
+      }
+
+    std::size_t received = 0;
+    auto begin = std::chrono::steady_clock::now ();
+    for (std::size_t sent = 0; (sent < count) || (received < count);)
+      {
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (10));
+        if ((sent < count)
+            && (driver.send (out + sent, chunk) == os::driver::RETURN_OK))
+          {
+            sent += chunk;
+          }
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+
+        if (((sent / chunk) % 10 == 0) || (sent == count))
+          {
+            // The handler, every 10 messages.
+            ssize_t nr = device.read (in + received, count - received);
+            if (nr > 0)
+              {
+                received += static_cast<std::size_t> (nr);
+              }
+          }
+      }
+    assert(std::memcmp (in, out, count) == 0);
+
+    os::dev::serial_ioctl::Statistics stats;
+    ret = device.ioctl (os::dev::serial_ioctl::get_statistics, &stats);
+    assert(ret == 0);
+    os::dev::Serial_loopback::Counters counters = driver.get_counters ();
+    assert(counters.rx_dropped == 0);
+    assert(stats.rx_overruns == 0);
+
+    // Most callbacks are only recorded, and processed in batches.
+    assert(stats.isr_deferred * 2 > counters.callbacks);
+    assert(stats.isr_count * 2 < counters.callbacks);
+
+    std::printf ("%-14s %5u callbacks, %5u deferred, %5u processed\n",
+                 "batches", static_cast<unsigned int> (counters.callbacks),
+                 static_cast<unsigned int> (stats.isr_deferred),
+                 static_cast<unsigned int> (stats.isr_count));
+
+    device.close ();
+  }
+
+  // The buffers as TByteCircularBuffer, the device calls their inline
+  // functions, with the mask; the stream is several times the buffer
+  // size, so both the transmit and the receive data wrap.
+  void
+  check_template_buffer (void)
+  {
+    using Buffer = os::dev::TByteCircularBuffer<128>;
+    using Template_device = os::dev::Buffered_serial_device<
+    os::dev::Serial_loopback::Critical_section, Buffer,
+    os::dev::Serial_loopback>;
+
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    Buffer rx_buf;
+    Buffer tx_buf;
+    Template_device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    constexpr std::size_t stream = 1000;
+    uint8_t chunk[100];
+    uint8_t in[256];
+    std::size_t sent = 0;
+    std::size_t received = 0;
+    auto begin = std::chrono::steady_clock::now ();
+    while (received < stream)
+      {
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        if ((sent < stream) && (sent == received))
+          {
+            // One chunk at a time, smaller than the receive buffer.
+            std::size_t n = stream - sent;
+            n = (n < sizeof(chunk)) ? n : sizeof(chunk);
+            for (std::size_t i = 0; i < n; ++i)
+              {
+                chunk[i] = pattern (sent + i);
+              }
+            ssize_t nw = device.write (chunk, n);
+            if (nw > 0)
+              {
+                sent += static_cast<std::size_t> (nw);
+              }
+          }
+
+        ssize_t nr = device.read (in, sizeof(in));
+        for (ssize_t i = 0; i < nr; ++i)
+          {
+            assert(in[i] == pattern (received + i));
+          }
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+          }
+        std::this_thread::sleep_for (std::chrono::microseconds (100));
+      }
+    assert(device.get_rx_overrun_count () == 0);
+
+    device.close ();
+  }
+
+  // readmsg() returns the stamps of the chunks the bytes came with;
+  // the two writes arrive as two chunks, each reported when the line
+  // becomes idle. A chunk read partially is returned again with the
+  // rest of its bytes.
+  void
+  check_rx_stamps (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    os::dev::Serial_rx_stamp ring[4];
+    device.set_rx_stamps (ring, 4);
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    uint8_t out[30];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+
+    os::rtos::clock::timestamp_t t0 = OS_POSIX_DRIVERS_SERIAL_RX_TIMESTAMP ();
+    ssize_t nw = device.write (out, 10);
+    assert(nw == 10);
+    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+    os::rtos::clock::timestamp_t t1 = OS_POSIX_DRIVERS_SERIAL_RX_TIMESTAMP ();
+    nw = device.write (out + 10, 20);
+    assert(nw == 20);
+    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+    os::rtos::clock::timestamp_t t2 = OS_POSIX_DRIVERS_SERIAL_RX_TIMESTAMP ();
+
+    // All the first chunk and part of the second.
+    uint8_t in[64];
+    os::dev::Serial_rx_stamp stamps[4];
+    std::size_t n = 4;
+    ssize_t nr = device.readmsg (in, 15, stamps, &n);
+    assert(nr == 15);
+    assert(n == 2);
+    assert(stamps[0].end == 10);
+    assert(stamps[0].flags == os::driver::serial::Event::rx_timeout);
+    assert((stamps[0].timestamp >= t0) && (stamps[0].timestamp <= t1));
+    assert(stamps[1].end == 30);
+    assert(stamps[1].flags == os::driver::serial::Event::rx_timeout);
+    assert((stamps[1].timestamp >= t1) && (stamps[1].timestamp <= t2));
+
+    // The rest of the second chunk; only one stamp fits.
+    n = 1;
+    nr = device.readmsg (in + 15, sizeof(in) - 15, stamps, &n);
+    assert(nr == 15);
+    assert(n == 1);
+    assert(stamps[0].end == 30);
+    assert(std::memcmp (in, out, sizeof(out)) == 0);
+
+    // Nothing left.
+    n = 4;
+    errno = 0;
+    nr = device.readmsg (in, sizeof(in), stamps, &n);
+    assert(nr == -1);
+    assert(errno == EAGAIN);
+    assert(n == 0);
+
+    device.close ();
+  }
+
+  // One thread polls two devices sharing a Serial_poll_event; the
+  // poll must wake up when the bytes written to the second one arrive,
+  // report only it, and report the hangup when its carrier drops,
+  // even if not requested.
+  void
+  check_poll (void)
+  {
+    os::dev::Serial_loopback driver0;
+    driver0.set_paced (false);
+    os::dev::ByteCircularBuffer rx_buf0
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf0
+      { tx_storage, sizeof(tx_storage) };
+    Device device0
+      { "loopback0", &driver0, &rx_buf0, &tx_buf0 };
+
+    os::dev::Serial_loopback driver1;
+    driver1.set_paced (false);
+    driver1.set_dcd (true);
+    uint8_t rx_storage1[64];
+    uint8_t tx_storage1[64];
+    os::dev::ByteCircularBuffer rx_buf1
+      { rx_storage1, sizeof(rx_storage1) };
+    os::dev::ByteCircularBuffer tx_buf1
+      { tx_storage1, sizeof(tx_storage1) };
+    Device device1
+      { "loopback1", &driver1, &rx_buf1, &tx_buf1 };
+
+    os::dev::Serial_poll_event event
+      { "poll" };
+    device0.set_poll_event (&event);
+    device1.set_poll_event (&event);
+
+    int ret = device0.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+    ret = device1.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    // Both can be written, none can be read.
+    assert(device0.get_poll_events () == os::dev::serial_poll::out);
+    assert(device1.get_poll_events () == os::dev::serial_poll::out);
+
+    os::dev::Serial_pollfd fds[2] =
+      {
+        { &device0, os::dev::serial_poll::in | os::dev::serial_poll::out, 0 },
+        { &device1, os::dev::serial_poll::in, 0 } };
+    int n = os::dev::poll_serial (fds, 2, event, 10);
+    assert(n == 1);
+    assert(fds[0].revents == os::dev::serial_poll::out);
+    assert(fds[1].revents == 0);
+
+    // Nothing to read, the poll times out.
+    fds[0].events = os::dev::serial_poll::in;
+    n = os::dev::poll_serial (fds, 2, event, 10);
+    assert(n == 0);
+
+    uint8_t out[10];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+    std::thread writer
+      { [&]
+        {
+          std::this_thread::sleep_for (std::chrono::milliseconds (20));
+          device1.write (out, sizeof(out));
+        } };
+    auto begin = std::chrono::steady_clock::now ();
+    n = os::dev::poll_serial (fds, 2, event, 1000);
+    auto elapsed = std::chrono::steady_clock::now () - begin;
+    writer.join ();
+    assert(n == 1);
+    assert(fds[0].revents == 0);
+    assert(fds[1].revents == os::dev::serial_poll::in);
+    assert(elapsed < std::chrono::milliseconds (500));
+
+    uint8_t in[16];
+    ssize_t nr = device1.read (in, sizeof(in));
+    assert(nr == static_cast<ssize_t> (sizeof(out)));
+    assert(std::memcmp (in, out, sizeof(out)) == 0);
+    assert((device1.get_poll_events () & os::dev::serial_poll::in) == 0);
+
+    // The carrier drops; hangup is reported without being requested.
+    std::thread hangup
+      { [&]
+        {
+          std::this_thread::sleep_for (std::chrono::milliseconds (20));
+          driver1.set_dcd (false);
+        } };
+    begin = std::chrono::steady_clock::now ();
+    n = os::dev::poll_serial (fds, 2, event, 1000);
+    elapsed = std::chrono::steady_clock::now () - begin;
+    hangup.join ();
+    assert(n == 1);
+    assert(fds[0].revents == 0);
+    assert(fds[1].revents == os::dev::serial_poll::hangup);
+    assert(elapsed < std::chrono::milliseconds (500));
+
+    device1.close ();
+    device0.close ();
+  }
+
+  // A blocking read() below the receive threshold returns only when
+  // the gap timeout expires, or earlier when the threshold is reached;
+  // the read timeout, if shorter, also ends the gap wait. The idle
+  // line detection is disabled, the ping-pong receive reports the
+  // bytes 16 at a time.
+  void
+  check_rx_threshold (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_rx_idle_chars (1000000);
+    uint8_t rx_storage32[32];
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage32, sizeof(rx_storage32) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+    device.set_rx_mode (Device::Rx_mode::ping_pong);
+
+    int ret = device.open (nullptr, 0);
+    assert(ret == 0);
+
+    os::dev::serial_ioctl::Rx_threshold threshold
+      { 24, 50 };
+    ret = device.ioctl (os::dev::serial_ioctl::set_rx_threshold, &threshold);
+    assert(ret == 0);
+
+    uint8_t out[32];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+    uint8_t in[64];
+
+    // Below the threshold, woken up only by the gap.
+    ssize_t nw = device.write (out, 16);
+    assert(nw == 16);
+    auto begin = std::chrono::steady_clock::now ();
+    ssize_t nr = device.read (in, sizeof(in));
+    auto elapsed = std::chrono::steady_clock::now () - begin;
+    assert(nr == 16);
+    assert(std::memcmp (in, out, 16) == 0);
+    assert(elapsed >= std::chrono::milliseconds (40));
+
+    // The threshold reached, before the gap.
+    nw = device.write (out, sizeof(out));
+    assert(nw == static_cast<ssize_t> (sizeof(out)));
+    begin = std::chrono::steady_clock::now ();
+    nr = device.read (in, sizeof(in));
+    elapsed = std::chrono::steady_clock::now () - begin;
+    assert(nr == static_cast<ssize_t> (sizeof(out)));
+    assert(std::memcmp (in, out, sizeof(out)) == 0);
+    assert(elapsed < std::chrono::milliseconds (40));
+
+    // The read timeout shorter than the gap.
+    threshold.gap_timeout = 500;
+    ret = device.ioctl (os::dev::serial_ioctl::set_rx_threshold, &threshold);
+    assert(ret == 0);
+    os::dev::serial_ioctl::Timeouts timeouts
+      { 10, 0 };
+    ret = device.ioctl (os::dev::serial_ioctl::set_timeouts, &timeouts);
+    assert(ret == 0);
+
+    nw = device.write (out, 16);
+    assert(nw == 16);
+    begin = std::chrono::steady_clock::now ();
+    nr = device.read (in, sizeof(in));
+    elapsed = std::chrono::steady_clock::now () - begin;
+    assert(nr == 16);
+    assert(std::memcmp (in, out, 16) == 0);
+    assert(elapsed < std::chrono::milliseconds (250));
+
+    device.close ();
+  }
+
+  // The line configuration given to open(), and changed on the open
+  // device; the bytes received at the old rate, not yet reported by
+  // the driver, are kept and wake up the blocked reader. With
+  // O_NONBLOCK and bytes still to send, the change fails.
+  void
+  check_line_config (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_rx_idle_chars (1000000);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    os::dev::serial_ioctl::Line_config config
+      {
+        9600,
+        os::driver::serial::MODE_ASYNCHRONOUS
+            | os::driver::serial::DATA_BITS_8
+            | os::driver::serial::PARITY_NONE
+            | os::driver::serial::STOP_BITS_1
+            | os::driver::serial::FLOW_CONTROL_NONE,
+        os::dev::serial_ioctl::flow_none };
+    int ret = device.open (nullptr, os::dev::serial_ioctl::oflag_line_config,
+                           &config);
+    assert(ret == 0);
+
+    os::dev::serial_ioctl::Line_config current;
+    ret = device.ioctl (os::dev::serial_ioctl::get_line_config, &current);
+    assert(ret == 0);
+    assert(current.baud_rate == 9600);
+    assert(current.mode == config.mode);
+    assert(current.flow_control == os::dev::serial_ioctl::flow_none);
+
+    os::dev::serial_ioctl::Timeouts timeouts
+      { 2000, 2000 };
+    ret = device.ioctl (os::dev::serial_ioctl::set_timeouts, &timeouts);
+    assert(ret == 0);
+
+    uint8_t out[100];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+    uint8_t in[256];
+
+    // About 10 ms at 9600 bps; the idle line is not detected, the
+    // bytes stay in the driver until the receive is stopped.
+    ssize_t nr = 0;
+    std::thread reader
+      { [&]
+        {
+          nr = device.read (in, sizeof(in));
+        } };
+    ssize_t nw = device.write (out, 10);
+    assert(nw == 10);
+    ret = device.ioctl (os::dev::serial_ioctl::drain);
+    assert(ret == 0);
+    auto begin = std::chrono::steady_clock::now ();
+    while (driver.get_counters ().rx_bytes < 10)
+      {
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (1));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+
+    config.baud_rate = 115200;
+    ret = device.ioctl (os::dev::serial_ioctl::set_line_config, &config);
+    assert(ret == 0);
+    reader.join ();
+    assert(nr == 10);
+    assert(std::memcmp (in, out, 10) == 0);
+
+    ret = device.ioctl (os::dev::serial_ioctl::get_line_config, &current);
+    assert(ret == 0);
+    assert(current.baud_rate == 115200);
+
+    // About 9 ms at the new rate, 100 ms at the old one.
+    begin = std::chrono::steady_clock::now ();
+    nw = device.write (out, sizeof(out));
+    assert(nw == static_cast<ssize_t> (sizeof(out)));
+    ret = device.ioctl (os::dev::serial_ioctl::drain);
+    assert(ret == 0);
+    assert(
+        std::chrono::steady_clock::now () - begin
+            < std::chrono::milliseconds (60));
+
+    // Bytes still to send, without waiting.
+    ret = device.fcntl (F_SETFL, O_NONBLOCK);
+    assert(ret == 0);
+    nw = device.write (out, sizeof(out));
+    assert(nw == static_cast<ssize_t> (sizeof(out)));
+    config.baud_rate = 9600;
+    errno = 0;
+    ret = device.ioctl (os::dev::serial_ioctl::set_line_config, &config);
+    assert(ret == -1);
+    assert(errno == EAGAIN);
+    ret = device.ioctl (os::dev::serial_ioctl::get_line_config, &current);
+    assert(ret == 0);
+    assert(current.baud_rate == 115200);
+
+    device.close ();
+  }
+
+  // O_NONBLOCK changed with F_SETFL on the open device; write() and
+  // writev() do not add to a transmit buffer above its high water
+  // mark, without waiting they fail with EAGAIN, otherwise they wait
+  // for it to drain. A blocking read() times out instead.
+  void
+  check_nonblocking (void)
+  {
+    os::dev::Serial_loopback driver;
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage), 64 };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    os::dev::serial_ioctl::Line_config config
+      {
+        9600,
+        os::driver::serial::MODE_ASYNCHRONOUS
+            | os::driver::serial::DATA_BITS_8
+            | os::driver::serial::PARITY_NONE
+            | os::driver::serial::STOP_BITS_1
+            | os::driver::serial::FLOW_CONTROL_NONE,
+        os::dev::serial_ioctl::flow_none };
+    int ret = device.open (
+        nullptr, O_NONBLOCK | os::dev::serial_ioctl::oflag_line_config,
+        &config);
+    assert(ret == 0);
+    assert((device.fcntl (F_GETFL) & O_NONBLOCK) != 0);
+
+    os::dev::serial_ioctl::Timeouts timeouts
+      { 500, 2000 };
+    ret = device.ioctl (os::dev::serial_ioctl::set_timeouts, &timeouts);
+    assert(ret == 0);
+
+    uint8_t out[120];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+    struct iovec iov[2];
+    iov[0].iov_base = out + 100;
+    iov[0].iov_len = 5;
+    iov[1].iov_base = out + 105;
+    iov[1].iov_len = 5;
+
+    uint8_t in[256];
+    errno = 0;
+    ssize_t nr = device.read (in, sizeof(in));
+    assert(nr == -1);
+    assert(errno == EAGAIN);
+
+    // About 100 ms to send, above the high water mark meanwhile.
+    ssize_t nw = device.write (out, 100);
+    assert(nw == 100);
+    errno = 0;
+    nw = device.write (out + 100, 10);
+    assert(nw == -1);
+    assert(errno == EAGAIN);
+    errno = 0;
+    nw = device.writev (iov, 2);
+    assert(nw == -1);
+    assert(errno == EAGAIN);
+
+    ret = device.fcntl (F_SETFL, 0);
+    assert(ret == 0);
+    assert((device.fcntl (F_GETFL) & O_NONBLOCK) == 0);
+
+    nw = device.writev (iov, 2);
+    assert(nw == 10);
+    nw = device.write (out + 110, 10);
+    assert(nw == 10);
+
+    std::size_t received = 0;
+    while (received < sizeof(out))
+      {
+        nr = device.read (in + received, sizeof(in) - received);
+        assert(nr > 0);
+        received += static_cast<std::size_t> (nr);
+      }
+    assert(received == sizeof(out));
+    assert(std::memcmp (in, out, sizeof(out)) == 0);
+
+    errno = 0;
+    nr = device.read (in, sizeof(in));
+    assert(nr == -1);
+    assert(errno == ETIMEDOUT);
+
+    device.close ();
+  }
+
+  // Read count bytes with blocking reads.
+  std::size_t
+  read_all (Device& device, uint8_t* buf, std::size_t count)
+  {
+    std::size_t received = 0;
+    while (received < count)
+      {
+        ssize_t nr = device.read (buf + received, count - received);
+        assert(nr > 0);
+        received += static_cast<std::size_t> (nr);
+      }
+    return received;
+  }
+
+  // Zero-copy transmit; fill the reserved segments in place and
+  // commit them, first in one segment, then wrapped around the end
+  // of the transmit buffer, in two.
+  void
+  check_tx_reserve (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    uint8_t tx_storage1[64];
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage1, sizeof(tx_storage1) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    int ret = device.open (nullptr, 0);
+    assert(ret == 0);
+
+    uint8_t* buf1;
+    uint8_t* buf2;
+    std::size_t len1;
+    std::size_t len2;
+    ssize_t n = device.tx_reserve (&buf1, &len1, &buf2, &len2);
+    assert(n == sizeof(tx_storage1));
+    assert(buf1 == tx_storage1);
+    assert(len1 == sizeof(tx_storage1));
+    assert(len2 == 0);
+
+    for (std::size_t i = 0; i < 40; ++i)
+      {
+        buf1[i] = pattern (i);
+      }
+    n = device.tx_commit (40);
+    assert(n == 40);
+    ret = device.ioctl (os::dev::serial_ioctl::drain);
+    assert(ret == 0);
+
+    uint8_t in[70];
+    assert(read_all (device, in, 40) == 40);
+
+    // The back is now at 40, the free space wraps.
+    n = device.tx_reserve (&buf1, &len1, &buf2, &len2);
+    assert(n == sizeof(tx_storage1));
+    assert(buf1 == tx_storage1 + 40);
+    assert(len1 == sizeof(tx_storage1) - 40);
+    assert(buf2 == tx_storage1);
+    assert(len2 == 40);
+
+    for (std::size_t i = 0; i < 30; ++i)
+      {
+        if (i < len1)
+          {
+            buf1[i] = pattern (40 + i);
+          }
+        else
+          {
+            buf2[i - len1] = pattern (40 + i);
+          }
+      }
+    n = device.tx_commit (30);
+    assert(n == 30);
+    ret = device.ioctl (os::dev::serial_ioctl::drain);
+    assert(ret == 0);
+
+    assert(read_all (device, in + 40, 30) == 30);
+    for (std::size_t i = 0; i < sizeof(in); ++i)
+      {
+        assert(in[i] == pattern (i));
+      }
+    assert(driver.get_counters ().rx_bytes == sizeof(in));
+
+    device.close ();
+
+    // Without a transmit buffer there is nothing to reserve.
+    os::dev::Serial_loopback driver2;
+    Device device2
+      { "loopback2", &driver2, &rx_buf, nullptr };
+    ret = device2.open (nullptr, 0);
+    assert(ret == 0);
+    errno = 0;
+    n = device2.tx_reserve (&buf1, &len1, &buf2, &len2);
+    assert(n == -1);
+    assert(errno == EINVAL);
+    errno = 0;
+    n = device2.tx_commit (1);
+    assert(n == -1);
+    assert(errno == EINVAL);
+    device2.close ();
+  }
+
+  // read_checksum() and write_checksum() update the checksum with
+  // the bytes transferred, also when less than requested, through the
+  // transmit buffer or sent directly from the user buffer.
+  void
+  check_checksum (void)
+  {
+    const uint8_t check[] =
+      { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    constexpr uint32_t check_crc32 = 0xCBF43926;
+
+    os::dev::Crc32 partial;
+    partial.update (check, 4);
+    const uint32_t partial_crc32 = partial.value ();
+
+    // Paced, to keep the bytes in the transmit buffer while sent.
+    os::dev::Serial_loopback driver;
+    uint8_t tx_storage1[4];
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage1, sizeof(tx_storage1) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    // Only the bytes that fit in the transmit buffer.
+    os::dev::Crc32 txsum;
+    ssize_t nw = device.write_checksum (check, sizeof(check), txsum);
+    assert(nw == 4);
+    assert(txsum.value () == partial_crc32);
+
+    ret = device.fcntl (F_SETFL, 0);
+    assert(ret == 0);
+    nw = device.write_checksum (check + 4, sizeof(check) - 4, txsum);
+    assert(nw == sizeof(check) - 4);
+    assert(txsum.value () == check_crc32);
+
+    // The first read gets exactly 4 bytes, then asks for more than
+    // there are.
+    uint8_t in[64];
+    os::dev::Crc32 rxsum;
+    ssize_t nr = device.read_checksum (in, 4, rxsum);
+    assert(nr == 4);
+    assert(rxsum.value () == partial_crc32);
+    std::size_t received = 4;
+    while (received < sizeof(check))
+      {
+        nr = device.read_checksum (in + received, sizeof(in) - received,
+                                   rxsum);
+        assert(nr > 0);
+        received += static_cast<std::size_t> (nr);
+      }
+    assert(received == sizeof(check));
+    assert(std::memcmp (in, check, sizeof(check)) == 0);
+    assert(rxsum.value () == check_crc32);
+
+    device.close ();
+
+    // Without a transmit buffer.
+    os::dev::Serial_loopback driver2;
+    driver2.set_paced (false);
+    Device device2
+      { "loopback2", &driver2, &rx_buf, nullptr };
+    ret = device2.open (nullptr, 0);
+    assert(ret == 0);
+
+    txsum.reset ();
+    nw = device2.write_checksum (check, sizeof(check), txsum);
+    assert(nw == sizeof(check));
+    assert(txsum.value () == check_crc32);
+
+    rxsum.reset ();
+    received = 0;
+    while (received < sizeof(check))
+      {
+        nr = device2.read_checksum (in + received, sizeof(in) - received,
+                                    rxsum);
+        assert(nr > 0);
+        received += static_cast<std::size_t> (nr);
+      }
+    assert(received == sizeof(check));
+    assert(rxsum.value () == check_crc32);
+
+    device2.close ();
+  }
+
+} /* namespace */
+
+// ----------------------------------------------------------------------------
+
+int
+main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
+{
+  const Scenario scenarios[] =
+    {
+      // Unthrottled reader, with and without coalescing.
+      { "bytes", 115200, 1, 0, 0, 0 },
+      { "chunks", 460800, 64, 0, 0, 0 },
+      { "chunks", 921600, 64, 0, 0, 0 },
+      { "small", 921600, 16, 0, 0, 0 },
+      { "coalesce", 921600, 16, 0, 64, 0 },
+
+      // Chunks not dividing the buffer size, the data wraps; with
+      // send_chain(), one transfer instead of two at each wrap.
+      { "wrapped", 921600, 100, 0, 0, 0 },
+      { "wrapped-dma", 921600, 100, 0, 0, 2 },
+      { "coalesce-dma", 921600, 16, 0, 64, 2 },
+
+      // Reader limited to 16 KB/s; overflows above about 160000 bps.
+      { "slow-reader", 115200, 64, 16, 0, 0 },
+      { "slow-reader", 230400, 64, 16, 0, 0 },
+      { "slow-reader", 921600, 64, 16, 0, 0 }, };
+
+  for (const Scenario& sc : scenarios)
+    {
+      run (sc);
+    }
+
+  check_writev (0);
+  check_writev (2);
+  check_writev (os::dev::Serial_loopback::max_chain_segments);
+  check_writev_buffered ();
+
+  check_flush_error ();
+  check_send_error ();
+
+  check_tx_timeout (false);
+  check_tx_timeout (true);
+
+  check_ping_pong_window ();
+  check_ping_pong_overrun ();
+  check_receive_error ();
+
+  check_flow_control (os::dev::serial_ioctl::flow_rts_cts);
+  check_flow_control (os::dev::serial_ioctl::flow_xon_xoff);
+
+  check_framing_delimiter ();
+  check_framing_codec (os::dev::serial_ioctl::framing_slip);
+  check_framing_codec (os::dev::serial_ioctl::framing_cobs);
+  check_framing_idle ();
+  check_frame_overruns ();
+
+  check_rx_progress (false);
+  check_rx_progress (true);
+
+  check_event_dispatch (false);
+  check_event_dispatch (true);
+  check_event_dispatch_unattended ();
+  check_event_batches ();
+
+  check_template_buffer ();
+
+  check_rx_stamps ();
+
+  check_poll ();
+
+  check_rx_threshold ();
+
+  check_line_config ();
+
+  check_nonblocking ();
+
+  check_tx_reserve ();
+
+  check_checksum ();
+
+  os::trace::puts ("'test-loopback-debug' succeeded.");
+  return 0;
+}
+
@@ -0,0 +1,316 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "posix-drivers/ByteBlockPool.h"
+#include "posix-drivers/PooledByteCircularBuffer.h"
+#include "posix-drivers/crc.h"
+#include "posix-drivers/buffered-serial-device.h"
+#include "posix-drivers/serial-loopback.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cassert>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+// ----------------------------------------------------------------------------
+
+using namespace os::dev;
+
+int
+main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
+{
+  // Pool of 6 blocks of 4 bytes.
+  TByteBlockPool<4, 6> pool;
+  assert(pool.blockSize () == 4);
+  assert(pool.count () == 6);
+  assert(pool.getFreeCount () == 6);
+
+  ByteBlockPool::index_t b1 = pool.allocate ();
+  ByteBlockPool::index_t b2 = pool.allocate ();
+  assert(b1 != ByteBlockPool::none && b2 != ByteBlockPool::none);
+  assert(b1 != b2);
+  assert(pool.next (b1) == ByteBlockPool::none);
+  assert(pool.getFreeCount () == 4);
+  pool.release (b1);
+  pool.release (b2);
+  assert(pool.getFreeCount () == 6);
+  assert(pool.getMinFreeCount () == 4);
+  pool.resetMinFreeCount ();
+  assert(pool.getMinFreeCount () == 6);
+
+  // Empty buffer, no blocks taken.
+  PooledByteCircularBuffer cb
+    { pool, 4 };
+  assert(cb.size () == 16);
+  assert(cb.length () == 0);
+  assert(cb.isEmpty ());
+  assert(!cb.isFull ());
+  assert(cb.getBlockCount () == 0);
+
+  uint8_t ch[20];
+  assert(cb.popFront (&ch[0]) == 0);
+  assert(cb.popFront (ch, 5) == 0);
+  assert(cb.advanceFront (2) == 0);
+
+  uint8_t* pb;
+  assert(cb.getFrontContiguousBuffer (&pb) == 0);
+
+  // Grow a block at a time.
+  assert(cb.pushBack ((uint8_t*) "abcdef", 6) == 6);
+  assert(cb.getBlockCount () == 2);
+  assert(pool.getFreeCount () == 4);
+  assert(cb.length () == 6);
+
+  assert(cb.getFrontContiguousBuffer (&pb) == 4);
+  assert(std::memcmp (pb, "abcd", 4) == 0);
+
+  uint8_t* pb2;
+  std::size_t len1;
+  std::size_t len2;
+  assert(cb.peekFront (&pb, &len1, &pb2, &len2) == 6);
+  assert(len1 == 4 && len2 == 2);
+  assert(pb2[0] == 'e' && pb2[1] == 'f');
+
+  // Up to the maximum number of blocks.
+  assert(cb.pushBack ((uint8_t*) "ghijklmnopqrst", 14) == 10);
+  assert(cb.getBlockCount () == 4);
+  assert(cb.isFull ());
+  assert(cb.pushBack ('?') == 0);
+  assert(cb.getBackContiguousBuffer (&pb) == 0);
+
+  // Scan across blocks.
+  assert(cb.find ('a') == 0);
+  assert(cb.find ('f') == 5);
+  assert(cb.find ('k', 3) == 10);
+  assert(cb.find ('p') == 15);
+  assert(cb.find ('b', 2) == PooledByteCircularBuffer::npos);
+  assert(cb.count ('h') == 1);
+  assert(cb.count ('?') == 0);
+
+  // Overwrite the last byte, as the continuous receive does.
+  cb.retreatBack ();
+  assert(cb.length () == 15);
+  assert(cb.getBackContiguousBuffer (&pb) == 1);
+  *pb = 'P';
+  assert(cb.advanceBack (1) == 1);
+
+  // Consumed blocks return to the pool.
+  assert(cb.popFront (ch, 5) == 5);
+  assert(std::memcmp (ch, "abcde", 5) == 0);
+  assert(cb.getBlockCount () == 3);
+  assert(pool.getFreeCount () == 3);
+  assert(!cb.isFull ());
+
+  std::memset (ch, '?', sizeof(ch));
+  assert(cb.popFront (ch, 20) == 11);
+  assert(std::memcmp (ch, "fghijklmnoP", 11) == 0);
+  assert(ch[11] == '?');
+  assert(cb.isEmpty ());
+
+  // The last block is kept, the driver may be receiving into it.
+  assert(cb.getBlockCount () == 1);
+  assert(pool.getFreeCount () == 5);
+
+  // When full and consumed, it is reused.
+  assert(cb.getBackContiguousBuffer (&pb) == 4);
+  assert(cb.getBlockCount () == 1);
+
+  // Zero-copy receive, as the driver does.
+  assert(cb.advanceBack (3) == 3);
+  assert(cb.length () == 3);
+  assert(cb.getBackContiguousBuffer (&pb) == 1);
+  assert(cb.advanceBack (2) == 1);
+  assert(cb.getBackContiguousBuffer (&pb) == 4);
+  assert(cb.getBlockCount () == 2);
+  assert(cb.reserveBack (&pb, &len1, &pb2, &len2) == 4);
+  assert(len1 == 4 && len2 == 0);
+  assert(cb.advanceFront (4) == 4);
+  assert(cb.getBlockCount () == 1);
+
+  // Once empty, the last block can be released, when the driver does
+  // not refer to it.
+  cb.trim ();
+  assert(cb.getBlockCount () == 0);
+  assert(pool.getFreeCount () == 6);
+  cb.trim ();
+  assert(cb.pushBack ((uint8_t*) "xyz", 3) == 3);
+  cb.trim ();
+  assert(cb.getBlockCount () == 1);
+  assert(cb.popFront (ch, 3) == 3);
+  assert(std::memcmp (ch, "xyz", 3) == 0);
+
+  // The pool is shared; the other buffer is full when the pool
+  // is exhausted.
+  cb.clear ();
+  assert(pool.getFreeCount () == 6);
+  PooledByteCircularBuffer other
+    { pool, 6, 8, 2 };
+  assert(cb.pushBack ((uint8_t*) "0123456789ABCDEF", 16) == 16);
+  assert(other.pushBack ((uint8_t*) "0123456789", 10) == 8);
+  assert(other.isFull ());
+  assert(other.isAboveHighWaterMark ());
+  assert(pool.getFreeCount () == 0);
+  assert(cb.advanceFront (8) == 8);
+  assert(!other.isFull ());
+  assert(other.pushBack ((uint8_t*) "89", 2) == 2);
+  assert(other.popFront (ch, 7) == 7);
+  assert(other.isBelowLowWaterMark () == false);
+  assert(other.advanceFront (2) == 2);
+  assert(other.isBelowLowWaterMark ());
+  other.clear ();
+  cb.clear ();
+  assert(pool.getFreeCount () == 6);
+
+  // Two buffers competing for the pool; a push is short only when
+  // the buffer reached its blocks or the pool is exhausted, the bytes
+  // are never mixed and no block is lost.
+  {
+    PooledByteCircularBuffer* bufs[2] =
+      { &cb, &other };
+    uint8_t pushed[2] =
+      { 0, 0 };
+    uint8_t popped[2] =
+      { 0, 0 };
+    std::size_t exhausted[2] =
+      { 0, 0 };
+    uint32_t seed = 1;
+    for (int i = 0; i < 2000; ++i)
+      {
+        seed = seed * 1103515245 + 12345;
+        std::size_t k = (seed >> 16) & 1;
+        std::size_t n = ((seed >> 20) % 9) + 1;
+        PooledByteCircularBuffer& buf = *bufs[k];
+
+        uint8_t data[9];
+        for (std::size_t j = 0; j < n; ++j)
+          {
+            data[j] = static_cast<uint8_t> (pushed[k] + j);
+          }
+        std::size_t done = buf.pushBack (data, n);
+        pushed[k] = static_cast<uint8_t> (pushed[k] + done);
+        if (done < n)
+          {
+            assert(buf.isFull ());
+            if (pool.getFreeCount () == 0)
+              {
+                ++exhausted[k];
+              }
+            else
+              {
+                assert(buf.getBlockCount () == ((k == 0) ? 4 : 6));
+              }
+          }
+
+        // Drain the other one a bit slower.
+        PooledByteCircularBuffer& rbuf = *bufs[1 - k];
+        std::size_t m = ((seed >> 24) % 8) + 1;
+        done = rbuf.popFront (data, m);
+        for (std::size_t j = 0; j < done; ++j)
+          {
+            assert(data[j] == popped[1 - k]);
+            popped[1 - k] = static_cast<uint8_t> (popped[1 - k] + 1);
+          }
+        if (rbuf.isEmpty () && ((seed >> 28) & 1))
+          {
+            rbuf.trim ();
+          }
+
+        assert(
+            pool.getFreeCount () + cb.getBlockCount ()
+                + other.getBlockCount () == pool.count ());
+        assert(cb.getBlockCount () <= 4 && other.getBlockCount () <= 6);
+      }
+    assert(exhausted[0] > 0 && exhausted[1] > 0);
+    assert(pool.getMinFreeCount () == 0);
+    other.clear ();
+    cb.clear ();
+    assert(pool.getFreeCount () == 6);
+  }
+
+  // A device sharing the pool for both directions; once sent, the
+  // transmit buffer returns its blocks, the receive buffer keeps one
+  // block while open, since a receive is always armed into it.
+  {
+    using Device = Buffered_serial_device<Serial_loopback::Critical_section,
+    PooledByteCircularBuffer>;
+
+    Serial_loopback driver;
+    driver.set_paced (false);
+    PooledByteCircularBuffer rx_buf
+      { pool, 4 };
+    PooledByteCircularBuffer tx_buf
+      { pool, 2 };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+    assert(device.open (nullptr, O_NONBLOCK) == 0);
+    assert(rx_buf.getBlockCount () == 1);
+
+    assert(device.write ("0123456789", 10) == 8);
+    std::size_t received = 0;
+    auto begin = std::chrono::steady_clock::now ();
+    while ((received < 8) || (tx_buf.getBlockCount () != 0))
+      {
+        ssize_t nr = device.read (ch + received, sizeof(ch) - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+          }
+        assert(
+            std::chrono::steady_clock::now () - begin
+                < std::chrono::seconds (5));
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+    assert(received == 8);
+    assert(std::memcmp (ch, "01234567", 8) == 0);
+    assert(rx_buf.isEmpty ());
+    assert(rx_buf.getBlockCount () == 1);
+    assert(pool.getFreeCount () == 5);
+
+    device.close ();
+    assert(pool.getFreeCount () == 6);
+  }
+
+  // Checksums while copying, across blocks.
+  const uint8_t* check = (const uint8_t*) "123456789";
+  Crc32 txsum;
+  assert(cb.pushBack (check, 9, txsum) == 9);
+  assert(txsum.value () == 0xCBF43926);
+  Crc32 rxsum;
+  assert(cb.popFront (ch, 9, rxsum) == 9);
+  assert(rxsum.value () == 0xCBF43926);
+  assert(std::memcmp (ch, check, 9) == 0);
+
+  // The maximum length.
+  assert(cb.getMaxLength () == 9);
+  cb.resetMaxLength ();
+  assert(cb.getMaxLength () == 0);
+
+  os::trace::puts ("'test-pool-debug' succeeded.");
+  return 0;
+}
+
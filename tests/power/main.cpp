@@ -0,0 +1,295 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Test the idle power policy of Buffered_serial_device, against the
+// simulated loopback driver: after a quiet period the driver goes to
+// low power, with the receive still armed; both a write() and the
+// received bytes restore the full power, before anything is sent.
+
+#define OS_INCLUDE_POSIX_DRIVERS_SERIAL_STATISTICS
+
+#include "posix-drivers/buffered-serial-device.h"
+#include "posix-drivers/serial-loopback.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+// ----------------------------------------------------------------------------
+
+namespace
+{
+  using Device = os::dev::Buffered_serial_device<
+  os::dev::Serial_loopback::Critical_section>;
+
+  // In clock ticks.
+  constexpr os::rtos::clock::duration_t idle_timeout = 20;
+
+  uint8_t rx_storage[512];
+  uint8_t tx_storage[256];
+
+  // Wait for the driver to reach the power state; return false if
+  // not reached in time.
+  bool
+  wait_power (os::dev::Serial_loopback& driver, os::driver::Power state,
+              std::chrono::milliseconds timeout)
+  {
+    auto begin = std::chrono::steady_clock::now ();
+    while (driver.get_power () != state)
+      {
+        if (std::chrono::steady_clock::now () - begin > timeout)
+          {
+            return false;
+          }
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      }
+    return true;
+  }
+
+  // Read the expected bytes, polling; return the number of bytes read.
+  std::size_t
+  read_all (Device& device, uint8_t* buf, std::size_t count)
+  {
+    std::size_t received = 0;
+    auto begin = std::chrono::steady_clock::now ();
+    while (received < count)
+      {
+        ssize_t nr = device.read (buf + received, count - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+          }
+        else if (std::chrono::steady_clock::now () - begin
+            > std::chrono::milliseconds (500))
+          {
+            break;
+          }
+        std::this_thread::sleep_for (std::chrono::microseconds (100));
+      }
+    return received;
+  }
+
+  os::dev::serial_ioctl::Statistics
+  get_statistics (Device& device)
+  {
+    os::dev::serial_ioctl::Statistics stats;
+    int ret = device.ioctl (os::dev::serial_ioctl::get_statistics, &stats);
+    assert(ret == 0);
+    return stats;
+  }
+
+  void
+  open_with_policy (Device& device, os::rtos::clock::duration_t timeout)
+  {
+    os::dev::serial_ioctl::Power_policy policy;
+    policy.idle_timeout = timeout;
+    int ret = device.ioctl (os::dev::serial_ioctl::set_power_policy, &policy);
+    assert(ret == 0);
+
+    ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+  }
+
+  // The ioctl() requests, and the wake up by write().
+  void
+  check_write_wake (void)
+  {
+    os::dev::Serial_loopback driver;
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    int ret;
+    os::dev::serial_ioctl::Power_policy policy;
+
+    // Disabled by default.
+    ret = device.ioctl (os::dev::serial_ioctl::get_power_policy, &policy);
+    assert(ret == 0);
+    assert(policy.idle_timeout == 0);
+
+    errno = 0;
+    ret = device.ioctl (
+        os::dev::serial_ioctl::set_power_policy,
+        static_cast<os::dev::serial_ioctl::Power_policy*> (nullptr));
+    assert(ret == -1);
+    assert(errno == EINVAL);
+
+    // Set before open, applied by open().
+    open_with_policy (device, idle_timeout);
+    ret = device.ioctl (os::dev::serial_ioctl::get_power_policy, &policy);
+    assert(ret == 0);
+    assert(policy.idle_timeout == idle_timeout);
+
+    // Quiet line.
+    assert(
+        wait_power (driver, os::driver::Power::low,
+                    std::chrono::milliseconds (1000)));
+    os::dev::serial_ioctl::Statistics stats = get_statistics (device);
+    assert(stats.power_low_entries == 1);
+    assert(stats.power_wakeups == 0);
+
+    // Woken up by write(), before sending.
+    const char msg[] = "wake up";
+    uint8_t in[sizeof(msg)];
+    ssize_t nw = device.write (msg, sizeof(msg));
+    assert(nw == static_cast<ssize_t> (sizeof(msg)));
+    stats = get_statistics (device);
+    assert(stats.power_wakeups == 1);
+    assert(read_all (device, in, sizeof(msg)) == sizeof(msg));
+    assert(std::memcmp (in, msg, sizeof(msg)) == 0);
+    assert(driver.get_counters ().low_power_sends == 0);
+
+    // Quiet again.
+    assert(
+        wait_power (driver, os::driver::Power::low,
+                    std::chrono::milliseconds (1000)));
+
+    // Disabled on an open device, back to full power and staying there.
+    policy.idle_timeout = 0;
+    ret = device.ioctl (os::dev::serial_ioctl::set_power_policy, &policy);
+    assert(ret == 0);
+    assert(driver.get_power () == os::driver::Power::full);
+    std::this_thread::sleep_for (std::chrono::milliseconds (5 * idle_timeout));
+    assert(driver.get_power () == os::driver::Power::full);
+
+    ret = device.close ();
+    assert(ret == 0);
+  }
+
+  // The driver refuses to wake up; the device stays at low power,
+  // counts the error and retries at the next access, here the event
+  // of the send completion.
+  void
+  check_wake_error (void)
+  {
+    os::dev::Serial_loopback driver;
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    open_with_policy (device, idle_timeout);
+    assert(
+        wait_power (driver, os::driver::Power::low,
+                    std::chrono::milliseconds (1000)));
+
+    // Both calls of write() fail.
+    driver.set_power_errors (2);
+    const char msg[] = "wake up";
+    uint8_t in[sizeof(msg)];
+    ssize_t nw = device.write (msg, sizeof(msg));
+    assert(nw == static_cast<ssize_t> (sizeof(msg)));
+    os::dev::serial_ioctl::Statistics stats = get_statistics (device);
+    assert(stats.power_wake_errors == 2);
+    assert(driver.get_counters ().low_power_sends == 1);
+
+    assert(read_all (device, in, sizeof(msg)) == sizeof(msg));
+    assert(std::memcmp (in, msg, sizeof(msg)) == 0);
+    stats = get_statistics (device);
+    assert(stats.power_wake_errors == 2);
+    assert(stats.power_wakeups == 1);
+
+    int ret = device.close ();
+    assert(ret == 0);
+  }
+
+  void
+  notify_nothing (void* arg __attribute__((unused)))
+  {
+    ;
+  }
+
+  // The wake up by the received bytes; the peer is simulated by
+  // sending directly with the driver, at low power, so the device
+  // has no transmit buffer, to ignore the send completion. With the
+  // deferred dispatch, the handler never runs and nobody reads until
+  // the full power is restored.
+  void
+  check_rx_wake (bool is_deferred)
+  {
+    os::dev::Serial_loopback driver;
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, nullptr };
+    if (is_deferred)
+      {
+        device.set_event_dispatch (Device::Event_dispatch::deferred, 0,
+                                   notify_nothing, nullptr);
+      }
+
+    open_with_policy (device, idle_timeout);
+    assert(
+        wait_power (driver, os::driver::Power::low,
+                    std::chrono::milliseconds (1000)));
+
+    const char peer[] = "from the peer";
+    uint8_t in[sizeof(peer)];
+    os::driver::return_t status = driver.send (peer, sizeof(peer));
+    assert(status == os::driver::RETURN_OK);
+    if (is_deferred)
+      {
+        assert(
+            wait_power (driver, os::driver::Power::full,
+                        std::chrono::milliseconds (1000)));
+      }
+    assert(read_all (device, in, sizeof(peer)) == sizeof(peer));
+    assert(std::memcmp (in, peer, sizeof(peer)) == 0);
+    os::dev::serial_ioctl::Statistics stats = get_statistics (device);
+    assert(stats.power_low_entries >= 1);
+    assert(stats.power_wakeups == 1);
+    assert(driver.get_counters ().low_power_sends == 1);
+
+    // Closed at full power.
+    int ret = device.close ();
+    assert(ret == 0);
+    assert(driver.get_power () == os::driver::Power::full);
+  }
+
+} /* namespace */
+
+// ----------------------------------------------------------------------------
+
+int
+main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
+{
+  check_write_wake ();
+  check_rx_wake (false);
+  check_rx_wake (true);
+  check_wake_error ();
+
+  os::trace::puts ("'test-power-debug' succeeded.");
+  return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "posix-drivers/serial-frame.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cassert>
+#include <cstring>
+
+// ----------------------------------------------------------------------------
+
+using namespace os::dev;
+
+int
+main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
+{
+  uint8_t enc[32];
+  uint8_t dec[32];
+  std::size_t len;
+
+  // SLIP, with the special characters escaped.
+  const uint8_t sdata[] =
+    { 'a', serial_frame::slip_end, 'b', serial_frame::slip_esc };
+  len = serial_frame::slip_encode (sdata, sizeof(sdata), enc, sizeof(enc));
+  assert(len == 8);
+  assert(enc[0] == serial_frame::slip_end);
+  assert(enc[2] == serial_frame::slip_esc);
+  assert(enc[3] == serial_frame::slip_esc_end);
+  assert(enc[7] == serial_frame::slip_end);
+  assert(serial_frame::slip_encode (sdata, sizeof(sdata), enc, 7) == 0);
+
+  // Decoded in two segments, split inside the escape sequence.
+    {
+      Serial_frame_decoder d
+        { serial_ioctl::framing_slip, 0, dec, sizeof(dec) };
+      d.decode (enc, 3);
+      d.decode (enc + 3, len - 3);
+      assert(!d.is_malformed ());
+      assert(!d.is_truncated ());
+      assert(d.length () == sizeof(sdata));
+      assert(std::memcmp (dec, sdata, sizeof(sdata)) == 0);
+    }
+
+  // Invalid escape.
+    {
+      const uint8_t bad[] =
+        { serial_frame::slip_esc, 'x', serial_frame::slip_end };
+      Serial_frame_decoder d
+        { serial_ioctl::framing_slip, 0, dec, sizeof(dec) };
+      d.decode (bad, sizeof(bad));
+      assert(d.is_malformed ());
+    }
+
+  // COBS, with zeros, at the beginning and at the end.
+  const uint8_t cdata[] =
+    { 0, 'a', 'b', 0, 0, 'c', 0 };
+  len = serial_frame::cobs_encode (cdata, sizeof(cdata), enc, sizeof(enc));
+  assert(len == 9);
+  assert(enc[0] == 1);
+  assert(enc[1] == 3);
+  assert(enc[len - 1] == 0);
+  assert(std::memchr (enc, 0, len - 1) == nullptr);
+
+    {
+      Serial_frame_decoder d
+        { serial_ioctl::framing_cobs, 0, dec, sizeof(dec) };
+      d.decode (enc, 4);
+      d.decode (enc + 4, len - 4);
+      assert(!d.is_malformed ());
+      assert(d.length () == sizeof(cdata));
+      assert(std::memcmp (dec, cdata, sizeof(cdata)) == 0);
+    }
+
+  // Truncated block.
+    {
+      const uint8_t bad[] =
+        { 4, 'a', 0 };
+      Serial_frame_decoder d
+        { serial_ioctl::framing_cobs, 0, dec, sizeof(dec) };
+      d.decode (bad, sizeof(bad));
+      assert(d.is_malformed ());
+    }
+
+  // COBS, a block of 254 non-zero bytes.
+    {
+      uint8_t big[300];
+      uint8_t bigenc[310];
+      uint8_t bigdec[300];
+      for (std::size_t i = 0; i < sizeof(big); ++i)
+        {
+          big[i] = static_cast<uint8_t> ((i % 255) + 1);
+        }
+      len = serial_frame::cobs_encode (big, sizeof(big), bigenc,
+                                       sizeof(bigenc));
+      assert(len == sizeof(big) + 3);
+      assert(bigenc[0] == 0xFF);
+
+      Serial_frame_decoder d
+        { serial_ioctl::framing_cobs, 0, bigdec, sizeof(bigdec) };
+      d.decode (bigenc, len);
+      assert(!d.is_malformed ());
+      assert(d.length () == sizeof(big));
+      assert(std::memcmp (bigdec, big, sizeof(big)) == 0);
+    }
+
+  // Delimiter, removed; destination too short.
+    {
+      Serial_frame_decoder d
+        { serial_ioctl::framing_delimiter, '\n', dec, 3 };
+      d.decode ((const uint8_t*) "abcd\n", 5);
+      assert(d.length () == 3);
+      assert(d.is_truncated ());
+      assert(!d.is_malformed ());
+      assert(dec[2] == 'c');
+    }
+
+  assert(serial_frame::get_end_delimiter (serial_ioctl::framing_cobs, 'x') == 0);
+  assert(
+      serial_frame::get_end_delimiter (serial_ioctl::framing_delimiter, 'x')
+          == 'x');
+
+  os::trace::puts ("'test-sframe-debug' succeeded.");
+  return 0;
+}
@@ -0,0 +1,300 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "posix-drivers/SpscByteCircularBuffer.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cassert>
+#include <cstring>
+
+// ----------------------------------------------------------------------------
+
+int
+main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
+{
+  uint8_t buff[5];
+  os::dev::SpscByteCircularBuffer cb
+    { buff, 5 };
+
+  // Empty buffer.
+  assert(cb.size () == 5);
+  assert(cb.length () == 0);
+  assert(cb.isEmpty ());
+  assert(!cb.isFull ());
+
+  // Low water marks.
+  assert(cb.isBelowLowWaterMark ());
+  assert(!cb.isAboveLowWaterMark ());
+
+  // No more pops.
+  uint8_t ch[6];
+  assert(cb.popFront (&ch[0]) == 0);
+  assert(cb.popFront (ch, 5) == 0);
+  assert(cb.advanceFront (2) == 0);
+
+  uint8_t* pb;
+  assert(cb.getFrontContiguousBuffer (&pb) == 0);
+  pb = nullptr;
+  assert(cb.getBackContiguousBuffer (&pb) == 5);
+  assert(pb == &buff[0]);
+
+  // Full buffer.
+  assert(cb.pushBack ((uint8_t* )"012345", 5) == 5);
+  assert(cb.isFull ());
+  assert(!cb.isEmpty ());
+
+  // No more pushes
+  assert(cb.pushBack ('?') == 0);
+  assert(cb.pushBack ((uint8_t* )"012345", 5) == 0);
+  assert(cb.advanceBack (2) == 0);
+
+  // High water marks.
+  assert(cb.isAboveHighWaterMark ());
+  assert(!cb.isBelowHighWaterMark ());
+
+  // Array operator.
+  assert(cb[2] == '2');
+
+  // Maximum length.
+  assert(cb.getMaxLength () == 5);
+
+  // Clear.
+  cb.clear ();
+  assert(cb.isEmpty ());
+  assert(cb.getMaxLength () == 0);
+
+  //  0 1 2 3 4
+  // | |x|x| | |
+  // +-+-+-+-+-+
+  //    f   b
+
+  assert(cb.pushBack ((uint8_t* )"abc", 3) == 3);
+  assert(cb.popFront (&ch[0]) == 1);
+  assert(ch[0] == 'a');
+
+  assert(cb.length () == 2);
+
+  assert(!cb.isBelowLowWaterMark ());
+  assert(cb.isAboveLowWaterMark ());
+
+  assert(!cb.isAboveHighWaterMark ());
+  assert(cb.isBelowHighWaterMark ());
+
+  pb = nullptr;
+  assert(cb.getFrontContiguousBuffer (&pb) == 2);
+  assert(pb == &buff[1]);
+
+  pb = nullptr;
+  assert(cb.getBackContiguousBuffer (&pb) == 2);
+  assert(pb == &buff[3]);
+
+  //  0 1 2 3 4
+  // | |x|x|x| |
+  // +-+-+-+-+-+
+  //    f     b
+
+  assert(cb.pushBack ('d') == 1);
+
+  pb = nullptr;
+  assert(cb.getFrontContiguousBuffer (&pb) == 3);
+  assert(pb == &buff[1]);
+
+  pb = nullptr;
+  assert(cb.getBackContiguousBuffer (&pb) == 1);
+  assert(pb == &buff[4]);
+
+  //  0 1 2 3 4
+  // | | | |x| |
+  // +-+-+-+-+-+
+  //        f b
+
+  assert(cb.popFront (&ch[0]) == 1);
+  assert(ch[0] == 'b');
+
+  assert(cb.popFront (&ch[0]) == 1);
+  assert(ch[0] == 'c');
+
+  pb = nullptr;
+  assert(cb.getFrontContiguousBuffer (&pb) == 1);
+  assert(pb == &buff[3]);
+
+  pb = nullptr;
+  assert(cb.getBackContiguousBuffer (&pb) == 1);
+  assert(pb == &buff[4]);
+
+  //  0 1 2 3 4
+  // | | | |x|x|
+  // +-+-+-+-+-+
+  //  b     f
+
+  assert(cb.pushBack ('e') == 1);
+
+  pb = nullptr;
+  assert(cb.getFrontContiguousBuffer (&pb) == 2);
+  assert(pb == &buff[3]);
+
+  pb = nullptr;
+  assert(cb.getBackContiguousBuffer (&pb) == 3);
+  assert(pb == &buff[0]);
+
+  //  0 1 2 3 4
+  // | | | |x|x|
+  // +-+-+-+-+-+
+  //  b     f
+
+  assert(cb.pushBack ('f') == 1);
+
+  pb = nullptr;
+  assert(cb.getFrontContiguousBuffer (&pb) == 2);
+  assert(pb == &buff[3]);
+
+  pb = nullptr;
+  assert(cb.getBackContiguousBuffer (&pb) == 2);
+  assert(pb == &buff[1]);
+
+  // pushBack/popFront buffer
+  cb.clear ();
+  assert(cb.pushBack ((uint8_t* )"xy", 1) == 1);
+  assert(cb.pushBack ((uint8_t* )"yz", 2) == 2);
+  assert(cb.pushBack ((uint8_t* )"defghi", 5) == 2);
+
+  cb.clear ();
+  assert(cb.pushBack ((uint8_t* )"xy", 1) == 1);
+  assert(cb.pushBack ((uint8_t* )"yz", 2) == 2);
+  assert(cb.advanceFront (2) == 2);
+  assert(cb.pushBack ((uint8_t* )"defghi", 6) == 4);
+
+  std::memset (ch, '?', sizeof(ch));
+  assert(cb.popFront (ch, 1) == 1);
+  assert(ch[0] == 'z');
+  assert(ch[1] == '?');
+  assert(cb.popFront (ch, 6) == 4);
+  assert(ch[0] == 'd');
+  assert(ch[3] == 'g');
+  assert(ch[4] == '?');
+
+  // Zero-copy access, wrapped data.
+  cb.clear ();
+  assert(cb.pushBack ((uint8_t* )"abcd", 4) == 4);
+  assert(cb.advanceFront (3) == 3);
+  assert(cb.pushBack ((uint8_t* )"xyz", 3) == 3);
+
+  uint8_t* pb2;
+  std::size_t len1;
+  std::size_t len2;
+  assert(cb.peekFront (&pb, &len1, &pb2, &len2) == 4);
+  assert(pb == &buff[3]);
+  assert(len1 == 2);
+  assert(pb2 == &buff[0]);
+  assert(len2 == 2);
+  assert(pb[0] == 'd' && pb[1] == 'x' && pb2[0] == 'y' && pb2[1] == 'z');
+
+  // Scan, wrapped data.
+  assert(cb.find ('d') == 0);
+  assert(cb.find ('y') == 2);
+  assert(cb.find ('z', 3) == 3);
+  assert(cb.find ('x', 2) == os::dev::SpscByteCircularBuffer::npos);
+  assert(cb.find ('d', 4) == os::dev::SpscByteCircularBuffer::npos);
+  assert(cb.count ('y') == 1);
+  assert(cb.count ('?') == 0);
+
+  assert(cb.reserveBack (&pb, &len1, &pb2, &len2) == 1);
+  assert(pb == &buff[2]);
+  assert(len1 == 1);
+  assert(len2 == 0);
+
+  // Consume and commit.
+  assert(cb.advanceFront (4) == 4);
+  assert(cb.reserveBack (&pb, &len1, &pb2, &len2) == 5);
+  assert(len1 == 3);
+  assert(len2 == 2);
+  pb[0] = 'r';
+  assert(cb.advanceBack (1) == 1);
+  assert(cb.getMaxLength () == 4);
+  assert(cb.popFront (&ch[0]) == 1);
+  assert(ch[0] == 'r');
+
+  cb.resetMaxLength ();
+  assert(cb.getMaxLength () == 0);
+  assert(cb.pushBack ((uint8_t* )"st", 2) == 2);
+  assert(cb.getMaxLength () == 2);
+
+  // Scan, a word at a time, wrapped data.
+  uint8_t lbuff[64];
+  uint8_t line[60];
+  os::dev::SpscByteCircularBuffer lcb
+    { lbuff, sizeof(lbuff) };
+  std::memset (line, '.', sizeof(line));
+  line[55] = '\n';
+  assert(lcb.pushBack (line, 60) == 60);
+  assert(lcb.advanceFront (50) == 50);
+  std::memset (line, '.', sizeof(line));
+  line[20] = '\n';
+  line[35] = '\n';
+  assert(lcb.pushBack (line, 40) == 40);
+  assert(lcb.length () == 50);
+
+  assert(lcb.find ('\n') == 5);
+  assert(lcb.find ('\n', 6) == 30);
+  assert(lcb.find ('\n', 31) == 45);
+  assert(lcb.find ('\n', 46) == os::dev::SpscByteCircularBuffer::npos);
+  assert(lcb.find ('?') == os::dev::SpscByteCircularBuffer::npos);
+  assert(lcb.count ('\n') == 3);
+  assert(lcb.count ('.') == 47);
+
+  // History before the back, wrapped; the stream is "abcdefghij",
+  // the last 8 bytes are still in the storage.
+  uint8_t hbuff[8];
+  os::dev::SpscByteCircularBuffer hcb
+    { hbuff, sizeof(hbuff) };
+  assert(hcb.pushBack ((uint8_t* )"abcdef", 6) == 6);
+  assert(hcb.advanceFront (6) == 6);
+  assert(hcb.pushBack ((uint8_t* )"ghij", 4) == 4);
+
+  assert(hcb.copyBeforeBack (6, ch, 6) == 6);
+  assert(std::memcmp (ch, "efghij", 6) == 0);
+  assert(hcb.copyBeforeBack (8, ch, 3) == 3);
+  assert(std::memcmp (ch, "cde", 3) == 0);
+  assert(hcb.copyBeforeBack (20, ch, 6) == 6);
+  assert(std::memcmp (ch, "cdefgh", 6) == 0);
+  assert(hcb.copyBeforeBack (2, ch, 6) == 2);
+  assert(std::memcmp (ch, "ij", 2) == 0);
+  assert(hcb.copyBeforeBack (0, ch, 6) == 0);
+
+  const uint8_t* hpb;
+  const uint8_t* hpb2;
+  assert(hcb.peekBeforeBack (6, 6, &hpb, &len1, &hpb2, &len2) == 6);
+  assert(len1 == 4 && std::memcmp (hpb, "efgh", 4) == 0);
+  assert(len2 == 2 && std::memcmp (hpb2, "ij", 2) == 0);
+  assert(hcb.peekBeforeBack (8, 3, &hpb, &len1, &hpb2, &len2) == 3);
+  assert(len1 == 3 && len2 == 0 && std::memcmp (hpb, "cde", 3) == 0);
+
+  // cb.dump();
+  os::trace::puts ("'test-spscbuff-debug' succeeded.");
+  return 0;
+}
+
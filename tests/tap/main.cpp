@@ -0,0 +1,307 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Test the receive tap of Buffered_serial_device, against the
+// simulated loopback driver: the main reader reads all the bytes,
+// the tap reads slower than the line, and either loses the oldest
+// bytes (drop) or holds the reception (stall); in both cases it sees
+// the same stream as the main reader.
+
+#include "posix-drivers/buffered-serial-device.h"
+#include "posix-drivers/serial-loopback.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+
+// ----------------------------------------------------------------------------
+
+namespace
+{
+  using Device = os::dev::Buffered_serial_device<
+  os::dev::Serial_loopback::Critical_section>;
+
+  constexpr std::size_t total = 4 * 1024;
+
+  uint8_t rx_storage[512];
+  uint8_t tx_storage[256];
+
+  // As read by the main reader, and by the tap, at the stream position.
+  uint8_t stream[total];
+  uint8_t tapped[total];
+  bool is_tapped[total];
+
+  inline uint8_t
+  pattern (std::size_t pos)
+  {
+    return static_cast<uint8_t> (pos * 7 + 1);
+  }
+
+  void
+  run (Device::Rx_tap_policy policy)
+  {
+    os::dev::Serial_loopback driver;
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    // No tap.
+    errno = 0;
+    assert(device.rx_tap_read (tapped, sizeof(tapped)) == -1);
+    assert(errno == EINVAL);
+
+    device.set_rx_tap (policy);
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    std::memset (stream, 0, sizeof(stream));
+    std::memset (tapped, 0, sizeof(tapped));
+    std::memset (is_tapped, 0, sizeof(is_tapped));
+
+    uint8_t chunk[64];
+    std::size_t sent = 0;
+    std::size_t received = 0;
+    std::size_t tap_received = 0;
+
+    auto begin = std::chrono::steady_clock::now ();
+    auto last_rx = begin;
+    auto last_tap = begin;
+    for (;;)
+      {
+        auto now = std::chrono::steady_clock::now ();
+
+        if (sent < total)
+          {
+            std::size_t n = total - sent;
+            n = (n < sizeof(chunk)) ? n : sizeof(chunk);
+            for (std::size_t i = 0; i < n; ++i)
+              {
+                chunk[i] = pattern (sent + i);
+              }
+            ssize_t ns = device.write (chunk, n);
+            if (ns > 0)
+              {
+                sent += static_cast<std::size_t> (ns);
+              }
+          }
+
+        ssize_t nr = device.read (stream + received, total - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+            last_rx = now;
+          }
+
+        // The tap takes up to 32 bytes every 5 ms, about half
+        // the line rate.
+        if (now - last_tap >= std::chrono::milliseconds (5))
+          {
+            std::size_t pos = tap_received + device.get_rx_tap_drop_count ();
+            std::size_t n = total - pos;
+            n = (n < 32) ? n : 32;
+            // The drops are counted before the bytes are copied.
+            uint8_t buf[32];
+            ssize_t nt = device.rx_tap_read (buf, n);
+            assert(nt >= 0);
+            pos = tap_received + device.get_rx_tap_drop_count ();
+            std::memcpy (tapped + pos, buf, static_cast<std::size_t> (nt));
+            std::memset (is_tapped + pos, true, static_cast<std::size_t> (nt));
+            tap_received += static_cast<std::size_t> (nt);
+            last_tap = now;
+          }
+
+        if ((received >= total)
+            || ((sent == total)
+                && (now - last_rx > std::chrono::milliseconds (100))))
+          {
+            break;
+          }
+
+        std::this_thread::sleep_for (std::chrono::microseconds (50));
+      }
+
+    // What the tap did not see yet.
+    for (;;)
+      {
+        std::size_t pos = tap_received + device.get_rx_tap_drop_count ();
+        uint8_t buf[32];
+        ssize_t nt = device.rx_tap_read (buf, sizeof(buf));
+        assert(nt >= 0);
+        if (nt == 0)
+          {
+            break;
+          }
+        pos = tap_received + device.get_rx_tap_drop_count ();
+        assert(pos + static_cast<std::size_t> (nt) <= total);
+        std::memcpy (tapped + pos, buf, static_cast<std::size_t> (nt));
+        std::memset (is_tapped + pos, true, static_cast<std::size_t> (nt));
+        tap_received += static_cast<std::size_t> (nt);
+      }
+
+    std::size_t overruns = device.get_rx_overrun_count ();
+    std::size_t drops = device.get_rx_tap_drop_count ();
+    std::printf ("%-5s: %5u received, %5u overruns, %5u tapped, %5u dropped\n",
+                 (policy == Device::Rx_tap_policy::drop) ? "drop" : "stall",
+                 static_cast<unsigned int> (received),
+                 static_cast<unsigned int> (overruns),
+                 static_cast<unsigned int> (tap_received),
+                 static_cast<unsigned int> (drops));
+
+    // The same stream, each byte either seen by the tap or dropped.
+    assert(tap_received + drops == received);
+    for (std::size_t i = 0; i < received; ++i)
+      {
+        assert(!is_tapped[i] || (tapped[i] == stream[i]));
+      }
+
+    if (policy == Device::Rx_tap_policy::stall)
+      {
+        // Nothing lost by the tap, the reception was held.
+        assert(drops == 0);
+      }
+    else if (overruns == 0)
+      {
+        // The main reader is not affected by the tap.
+        assert(received == total);
+        for (std::size_t i = 0; i < received; ++i)
+          {
+            assert(stream[i] == pattern (i));
+          }
+      }
+
+    device.close ();
+  }
+
+  template<typename Predicate_T>
+    void
+    wait_for (Predicate_T predicate)
+    {
+      auto begin = std::chrono::steady_clock::now ();
+      while (!predicate ())
+        {
+          assert(
+              std::chrono::steady_clock::now () - begin
+                  < std::chrono::seconds (5));
+          std::this_thread::sleep_for (std::chrono::milliseconds (1));
+        }
+    }
+
+  // With the stall policy, a full buffer that the main reader emptied
+  // but the tap did not see holds the reception; once the tap reads,
+  // the next bytes go to the buffer again, none is lost.
+  void
+  check_stall_recovery (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    uint8_t storage[64];
+    os::dev::ByteCircularBuffer rx_buf
+      { storage, sizeof(storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+    device.set_rx_tap (Device::Rx_tap_policy::stall);
+
+    int ret = device.open (nullptr, O_NONBLOCK);
+    assert(ret == 0);
+
+    uint8_t out[sizeof(storage)];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = pattern (i);
+      }
+    uint8_t in[sizeof(storage)];
+    uint8_t tap[sizeof(storage)];
+
+    // Fill the buffer; the main reader takes all the bytes.
+    ssize_t nw = device.write (out, sizeof(out));
+    assert(nw == static_cast<ssize_t> (sizeof(out)));
+    std::size_t received = 0;
+    wait_for ([&]
+      {
+        ssize_t nr = device.read (in + received, sizeof(in) - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+          }
+        return received == sizeof(in);
+      });
+    assert(std::memcmp (in, out, sizeof(in)) == 0);
+
+    // Held for the tap.
+    ssize_t nt = device.rx_tap_read (tap, sizeof(tap));
+    assert(nt == static_cast<ssize_t> (sizeof(tap)));
+    assert(std::memcmp (tap, out, sizeof(tap)) == 0);
+
+    // Received again, by both.
+    constexpr std::size_t more = 20;
+    nw = device.write (out, more);
+    assert(nw == static_cast<ssize_t> (more));
+    received = 0;
+    wait_for ([&]
+      {
+        ssize_t nr = device.read (in + received, more - received);
+        if (nr > 0)
+          {
+            received += static_cast<std::size_t> (nr);
+          }
+        return received == more;
+      });
+    assert(std::memcmp (in, out, more) == 0);
+
+    nt = device.rx_tap_read (tap, sizeof(tap));
+    assert(nt == static_cast<ssize_t> (more));
+    assert(std::memcmp (tap, out, more) == 0);
+
+    assert(device.get_rx_overrun_count () == 0);
+    assert(device.get_rx_tap_drop_count () == 0);
+
+    device.close ();
+  }
+
+} /* namespace */
+
+// ----------------------------------------------------------------------------
+
+int
+main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
+{
+  run (Device::Rx_tap_policy::drop);
+  run (Device::Rx_tap_policy::stall);
+  check_stall_recovery ();
+
+  os::trace::puts ("'test-tap-debug' succeeded.");
+  return 0;
+}
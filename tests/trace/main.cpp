@@ -0,0 +1,223 @@
+/*
+ * This file is part of the µOS++ distribution.
+ *   (https://github.com/micro-os-plus)
+ * Copyright (c) 2016 Liviu Ionescu.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Test the idle power policy of Buffered_serial_device, against the
+// simulated loopback driver: after a quiet period the driver goes to
+// Test the event trace of Buffered_serial_device, against the
+// simulated loopback driver: a blocked read() and a write() record
+// the waits, the driver calls and callbacks and the bytes returned.
+// All sources must be compiled with OS_INCLUDE_POSIX_DRIVERS_SERIAL_TRACE
+// defined, the ring is in serial-trace.cpp.
+
+#if !defined(OS_INCLUDE_POSIX_DRIVERS_SERIAL_TRACE)
+#error "Define OS_INCLUDE_POSIX_DRIVERS_SERIAL_TRACE for all sources."
+#endif
+
+#include "posix-drivers/buffered-serial-device.h"
+#include "posix-drivers/serial-loopback.h"
+#include <cmsis-plus/diag/trace.h>
+
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+
+// ----------------------------------------------------------------------------
+
+namespace
+{
+  using Device = os::dev::Buffered_serial_device<
+  os::dev::Serial_loopback::Critical_section>;
+
+  namespace serial_trace = os::dev::serial_trace;
+
+  uint8_t rx_storage[256];
+  uint8_t tx_storage[256];
+
+  uint32_t
+  trace_count (void)
+  {
+    return serial_trace::next.load ();
+  }
+
+  // The ring keeps the last records, overwriting the oldest.
+  void
+  check_ring (void)
+  {
+    int dummy;
+    serial_trace::clear ();
+    assert(trace_count () == 0);
+
+    for (uint32_t i = 0; i < serial_trace::size + 3; ++i)
+      {
+        OS_POSIX_DRIVERS_SERIAL_TRACE (&dummy, serial_trace::send, i);
+      }
+    assert(trace_count () == serial_trace::size + 3);
+    for (uint32_t i = 3; i < serial_trace::size + 3; ++i)
+      {
+        const serial_trace::Record& r = serial_trace::records[i
+            & (serial_trace::size - 1)];
+        assert(r.device == &dummy);
+        assert(r.point == serial_trace::send);
+        assert(r.arg == i);
+      }
+
+    serial_trace::clear ();
+    assert(trace_count () == 0);
+  }
+
+  // A read() blocked until the bytes arrive, and the write() that
+  // sends them.
+  void
+  check_device (void)
+  {
+    os::dev::Serial_loopback driver;
+    driver.set_paced (false);
+    os::dev::ByteCircularBuffer rx_buf
+      { rx_storage, sizeof(rx_storage) };
+    os::dev::ByteCircularBuffer tx_buf
+      { tx_storage, sizeof(tx_storage) };
+    Device device
+      { "loopback", &driver, &rx_buf, &tx_buf };
+
+    int ret = device.open (nullptr, 0);
+    assert(ret == 0);
+
+    os::dev::serial_ioctl::Timeouts timeouts
+      { 1000, 1000 };
+    ret = device.ioctl (os::dev::serial_ioctl::set_timeouts, &timeouts);
+    assert(ret == 0);
+
+    serial_trace::clear ();
+
+    uint8_t out[10];
+    for (std::size_t i = 0; i < sizeof(out); ++i)
+      {
+        out[i] = static_cast<uint8_t> ('0' + i);
+      }
+    uint8_t in[sizeof(out)];
+    std::size_t received = 0;
+    std::thread reader
+      { [&]
+        {
+          while (received < sizeof(in))
+            {
+              ssize_t nr = device.read (in + received,
+                  sizeof(in) - received);
+              assert(nr > 0);
+              received += static_cast<std::size_t> (nr);
+            }
+        } };
+
+    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+    ssize_t nw = device.write (out, sizeof(out));
+    assert(nw == sizeof(out));
+    reader.join ();
+    ret = device.ioctl (os::dev::serial_ioctl::drain);
+    assert(ret == 0);
+
+    uint32_t end = trace_count ();
+    assert(end <= serial_trace::size);
+
+    uint32_t counts[serial_trace::points_count] =
+      { };
+    uint32_t sent = 0;
+    uint32_t returned = 0;
+    bool is_rx_waiting = false;
+    int isr_depth = 0;
+    for (uint32_t i = 0; i < end; ++i)
+      {
+        const serial_trace::Record& r = serial_trace::records[i];
+        assert(r.device == &device);
+        assert(r.point < serial_trace::points_count);
+        ++counts[r.point];
+
+        switch (r.point)
+          {
+          case serial_trace::isr_enter:
+            ++isr_depth;
+            break;
+          case serial_trace::isr_exit:
+            --isr_depth;
+            assert(isr_depth >= 0);
+            break;
+          case serial_trace::send:
+            sent += r.arg;
+            break;
+          case serial_trace::rx_wait:
+            // The read timeout.
+            assert(r.arg == 1000);
+            is_rx_waiting = true;
+            break;
+          case serial_trace::rx_wakeup:
+            // Woken by the bytes, not by the timeout.
+            assert(is_rx_waiting);
+            assert(r.arg == 0);
+            is_rx_waiting = false;
+            break;
+          case serial_trace::read_return:
+            // The reader is not blocked when returning.
+            assert(!is_rx_waiting);
+            returned += r.arg;
+            break;
+          default:
+            break;
+          }
+      }
+    assert(isr_depth == 0);
+    assert(!is_rx_waiting);
+
+    // The reader blocked before the write().
+    assert(serial_trace::records[0].point == serial_trace::rx_wait);
+    assert(counts[serial_trace::rx_wakeup] >= 1);
+    assert(counts[serial_trace::isr_enter] >= 1);
+    assert(counts[serial_trace::rx_post] >= 1);
+    assert(counts[serial_trace::tx_post] >= 1);
+    assert(sent == sizeof(out));
+    assert(returned == sizeof(out));
+
+    serial_trace::dump ();
+
+    device.close ();
+  }
+
+} /* namespace */
+
+// ----------------------------------------------------------------------------
+
+int
+main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
+{
+  check_ring ();
+
+  check_device ();
+
+  os::trace::puts ("'test-trace-debug' succeeded.");
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
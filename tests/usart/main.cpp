@@ -25,39 +25,10 @@
  * OTHER DEALINGS IN THE SOFTWARE.
  */
 
-#include "posix-drivers/CmsisUsartCharDevice.h"
-#include "posix-drivers/TBufferedCmsisUsartCharDevice.h"
-#include "posix-io/FileDescriptorsManager.h"
-#include "posix-io/CharDevicesRegistry.h"
+#include "posix-drivers/buffered-serial-device.h"
+#include "posix-drivers/cmsis-driver-usart-direct-wrapper.h"
 #include "Driver_USART.h"
 
-// Static manager
-os::posix::FileDescriptorsManager descriptorsManager
-  { 5 };
-
-// Static manager
-os::posix::CharDevicesRegistry devicesRegistry
-  { 2 };
-
-// ----------------------------------------------------------------------------
-
-ARM_DRIVER_USART driver1
-  { };
-
-extern "C" void
-eventCallBack1 (uint32_t event);
-
-// This device will be mapped as "/dev/usart"
-os::posix::CmsisUsartCharDevice usart1
-  { "usart1", &driver1, eventCallBack1 };
-
-void
-eventCallBack1 (uint32_t event)
-{
-  // Forward event to driver instance.
-  usart1.eventCallBack (event);
-}
-
 // ----------------------------------------------------------------------------
 
 class TestCriticalSection
@@ -81,12 +52,43 @@ private:
   // uint32_t fStatus;
 };
 
-using BufferedCmsisUsartCharDevice =
-os::dev::TBufferedCmsisUsartCharDevice<TestCriticalSection>;
+// ----------------------------------------------------------------------------
+
+ARM_DRIVER_USART driver1
+  { };
+
+// No transmit buffer, no chained send.
+using Usart1 = os::cmsis::driver::Usart_direct_wrapper<&driver1>;
+Usart1 usart1_driver;
+
+// The receive RAM is chosen per port; read() copies out of the ring
+// with a bulk popFront().
+uint8_t usart1_rx_buffer[64];
+os::dev::SpscByteCircularBuffer usart1_rx_circular_buffer
+  { usart1_rx_buffer, sizeof(usart1_rx_buffer) };
+
+// The CMSIS callback is in the wrapper, no trampoline is needed.
+os::dev::Buffered_serial_device<TestCriticalSection,
+    os::dev::SpscByteCircularBuffer, Usart1> usart1
+  { "usart1", &usart1_driver, &usart1_rx_circular_buffer, nullptr };
+
+// ----------------------------------------------------------------------------
 
 ARM_DRIVER_USART driver2
   { };
 
+int32_t
+usart2_send_chain (const struct iovec* iov __attribute__((unused)),
+                   int iovcnt __attribute__((unused)))
+{
+  return ARM_DRIVER_ERROR_UNSUPPORTED;
+}
+
+// With a linked-list DMA send of up to 4 segments.
+using Usart2 = os::cmsis::driver::Usart_direct_wrapper<&driver2,
+&usart2_send_chain, 4>;
+Usart2 usart2_driver;
+
 uint8_t usart2_rx_buffer[200];
 os::dev::ByteCircularBuffer usart2_rx_circular_buffer
   { usart2_rx_buffer, sizeof(usart2_rx_buffer) };
@@ -95,34 +97,37 @@ uint8_t usart2_tx_buffer[200];
 os::dev::ByteCircularBuffer usart2_tx_circular_buffer
   { usart2_tx_buffer, sizeof(usart2_tx_buffer) };
 
-extern "C" void
-eventCallBack2 (uint32_t event);
-
-// This device will be mapped as "/dev/usart2"
-BufferedCmsisUsartCharDevice usart2
-  { "usart2", &driver2, eventCallBack2, &usart2_rx_circular_buffer,
+os::dev::Buffered_serial_device<TestCriticalSection,
+    os::dev::ByteCircularBuffer, Usart2> usart2
+  { "usart2", &usart2_driver, &usart2_rx_circular_buffer,
       &usart2_tx_circular_buffer };
 
-void
-eventCallBack2 (uint32_t event)
-{
-  // Forward event to driver instance.
-  usart1.eventCallBack (event);
-}
-
 // ----------------------------------------------------------------------------
 
 int
 main (int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
 {
-  os::posix::CharDevicesRegistry::add (&usart1);
-  os::posix::CharDevicesRegistry::add (&usart2);
-
-  int fd1 = __posix_open ("/dev/usart1", 0);
-  __posix_close (fd1);
-
-  int fd2 = __posix_open ("/dev/usart2", 0);
-  __posix_close (fd2);
-
+  usart1_driver.power (os::driver::Power::full);
+  int ret = usart1.open (nullptr, 0);
+  if (ret == 0)
+    {
+      usart1.close ();
+    }
+
+  usart2_driver.power (os::driver::Power::full);
+  ret = usart2.open (nullptr, 0);
+  if (ret == 0)
+    {
+      uint8_t buf[10]
+        { };
+      usart2.write (buf, sizeof(buf));
+      usart2.close ();
+    }
+
+  usart2_driver.power (os::driver::Power::low);
+  usart2_driver.power (os::driver::Power::full);
+  usart2_driver.power (os::driver::Power::off);
+  usart1_driver.power (os::driver::Power::off);
+
+  return 0;
 }
-